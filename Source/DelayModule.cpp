@@ -15,6 +15,7 @@ void DelayModule::prepare(const juce::dsp::ProcessSpec& spec)
     
     delayLine.setMaximumDelayInSamples(maxDelaySamples);
     delayLine.prepare(spec);
+    mix.prepare(sampleRate, static_cast<int>(spec.maximumBlockSize));
     lastDelaySamples = -1.0f;
     updateDelayTime();
 }
@@ -24,6 +25,9 @@ void DelayModule::process(juce::dsp::AudioBlock<float>& block)
     // Update delay time only when params changed (avoids zipper/glitches from recalc every block)
     updateDelayTime();
     
+    // The mix moves per sample; the same values serve every channel.
+    const float* mixValues = mix.getNextValues(static_cast<int>(block.getNumSamples()));
+
     // Process each channel
     for (size_t channel = 0; channel < block.getNumChannels(); ++channel)
     {
@@ -35,7 +39,7 @@ void DelayModule::process(juce::dsp::AudioBlock<float>& block)
             // Standard delay order per JUCE: push current input, then pop to get delayed sample
             delayLine.pushSample(static_cast<int>(channel), input);
             float delayed = delayLine.popSample(static_cast<int>(channel), -1.0f);
-            channelData[sample] = input * (1.0f - mix) + delayed * mix;
+            channelData[sample] = input * (1.0f - mixValues[sample]) + delayed * mixValues[sample];
         }
     }
 }
@@ -53,7 +57,7 @@ void DelayModule::setDelayTime(float normalizedTime)
 
 void DelayModule::setMix(float mixValue)
 {
-    mix = juce::jlimit(0.0f, 1.0f, mixValue);
+    mix.setTarget(juce::jlimit(0.0f, 1.0f, mixValue));
 }
 
 void DelayModule::setHostTempo(double tempoBPM)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ParameterRamp.h"
 
 class DelayModule
 {
@@ -13,7 +14,7 @@ public:
     void reset();
     
     void setDelayTime(float normalizedTime); // 0.0 to 1.0
-    void setMix(float mix); // 0.0 to 1.0
+    void setMix(float mix); // 0.0 to 1.0, ramped per sample
     void setHostTempo(double tempoBPM); // Host tempo in BPM
     
     // Get current delay time display string (e.g., "1/4", "1/8T")
@@ -23,7 +24,7 @@ private:
     juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> delayLine;
     
     float delayTimeNormalized = 0.5f;
-    float mix = 0.0f;
+    ParameterRamp mix;
     double hostTempo = 120.0;
     double sampleRate = 44100.0;
     float lastDelaySamples = -1.0f;
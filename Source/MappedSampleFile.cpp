@@ -0,0 +1,125 @@
+#include "MappedSampleFile.h"
+
+#if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr int kPageSize = 4096;
+
+    struct WavLayout
+    {
+        juce::int64 dataStart = 0;
+        juce::int64 dataLength = 0;
+        int formatTag = 0;
+        int numChannels = 0;
+        int bitsPerSample = 0;
+        double sampleRate = 0.0;
+    };
+
+    /** Walks the RIFF chunks for 'fmt ' and 'data'. Returns false if this isn't a plain RIFF/WAVE file. */
+    bool readWavLayout(const char* bytes, juce::int64 size, WavLayout& layout)
+    {
+        if (size < 12 || std::memcmp(bytes, "RIFF", 4) != 0 || std::memcmp(bytes + 8, "WAVE", 4) != 0)
+            return false;
+
+        juce::int64 pos = 12;
+        while (pos + 8 <= size)
+        {
+            const char* chunk = bytes + pos;
+            const auto chunkSize = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt(chunk + 4));
+            const auto body = pos + 8;
+
+            if (std::memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && body + 16 <= size)
+            {
+                layout.formatTag = juce::ByteOrder::littleEndianShort(bytes + body);
+                layout.numChannels = juce::ByteOrder::littleEndianShort(bytes + body + 2);
+                layout.sampleRate = static_cast<double>(juce::ByteOrder::littleEndianInt(bytes + body + 4));
+                layout.bitsPerSample = juce::ByteOrder::littleEndianShort(bytes + body + 14);
+
+                // WAVE_FORMAT_EXTENSIBLE: the real format tag is the first 2 bytes of the sub-format GUID
+                if (layout.formatTag == 0xfffe && chunkSize >= 26 && body + 26 <= size)
+                    layout.formatTag = juce::ByteOrder::littleEndianShort(bytes + body + 24);
+            }
+            else if (std::memcmp(chunk, "data", 4) == 0)
+            {
+                layout.dataStart = body;
+                layout.dataLength = juce::jmin(chunkSize, size - body);
+                return layout.numChannels > 0;
+            }
+
+            pos = body + chunkSize + (chunkSize & 1); // chunks are word-aligned
+        }
+        return false;
+    }
+}
+
+MappedSampleFile::Ptr MappedSampleFile::open(const juce::File& fileToMap)
+{
+    auto map = std::make_unique<juce::MemoryMappedFile>(fileToMap, juce::MemoryMappedFile::readOnly, false);
+    if (map->getData() == nullptr)
+        return nullptr;
+
+    const auto* bytes = static_cast<const char*>(map->getData());
+    WavLayout layout;
+    if (!readWavLayout(bytes, static_cast<juce::int64>(map->getSize()), layout))
+        return nullptr;
+
+    SamplePcm pcm;
+    if (layout.formatTag == 1 && layout.bitsPerSample == 16)
+        pcm.encoding = SamplePcm::Encoding::int16;
+    else if (layout.formatTag == 1 && layout.bitsPerSample == 24)
+        pcm.encoding = SamplePcm::Encoding::int24;
+    else if (layout.formatTag == 3 && layout.bitsPerSample == 32)
+        pcm.encoding = SamplePcm::Encoding::float32;
+    else
+        return nullptr; // 8-bit, 32-bit int, compressed… — caller decodes these into RAM instead
+
+    pcm.data = bytes + layout.dataStart;
+    pcm.numChannels = layout.numChannels;
+    pcm.numFrames = static_cast<int>(layout.dataLength / pcm.getBytesPerFrame());
+    if (!pcm.isValid() || layout.sampleRate <= 0.0)
+        return nullptr;
+
+    Ptr mapped(new MappedSampleFile());
+    mapped->file = fileToMap;
+    mapped->map = std::move(map);
+    mapped->pcm = pcm;
+    mapped->sampleRate = layout.sampleRate;
+    return mapped;
+}
+
+void MappedSampleFile::warm(int startFrame, int numFrames) const noexcept
+{
+    warmPcm(pcm, startFrame, numFrames);
+}
+
+void MappedSampleFile::warmPcm(const SamplePcm& pcm, int startFrame, int numFrames) noexcept
+{
+    startFrame = juce::jlimit(0, pcm.numFrames, startFrame);
+    numFrames = juce::jlimit(0, pcm.numFrames - startFrame, numFrames);
+    if (numFrames == 0)
+        return;
+
+    const auto bytesPerFrame = static_cast<size_t>(pcm.getBytesPerFrame());
+    const char* begin = pcm.data + static_cast<size_t>(startFrame) * bytesPerFrame;
+    const char* end = begin + static_cast<size_t>(numFrames) * bytesPerFrame;
+
+#if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+    // Ask for read-ahead first so the touches below mostly hit pages already in flight.
+    const auto pageSize = static_cast<juce::pointer_sized_uint>(sysconf(_SC_PAGESIZE));
+    const auto alignedBegin = reinterpret_cast<juce::pointer_sized_uint>(begin) & ~(pageSize - 1);
+    madvise(reinterpret_cast<void*>(alignedBegin),
+            static_cast<size_t>(reinterpret_cast<juce::pointer_sized_uint>(end) - alignedBegin),
+            MADV_WILLNEED);
+#endif
+
+    // Fault every page in now, on this (non-audio) thread.
+    int sink = 0;
+    for (const char* p = begin; p < end; p += kPageSize)
+        sink += *reinterpret_cast<const volatile char*>(p);
+    sink += *reinterpret_cast<const volatile char*>(end - 1);
+    juce::ignoreUnused(sink);
+}
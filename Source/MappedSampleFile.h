@@ -0,0 +1,40 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SamplePcm.h"
+
+/** A PCM WAV file mapped read-only into memory. Voices render straight from the
+ *  mapped data chunk, so opening a bank costs no decoding and the OS page cache
+ *  shares the pages between every process that maps the same file.
+ *
+ *  Pages are faulted in lazily; warm() (called off the audio thread, see
+ *  PageWarmer) hints and touches the pages a voice is about to read.
+ */
+class MappedSampleFile : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<MappedSampleFile>;
+
+    /** Maps a little-endian PCM (16/24-bit int or 32-bit float) WAV; nullptr for anything else. */
+    static Ptr open(const juce::File& file);
+
+    const juce::File& getFile() const noexcept { return file; }
+    const SamplePcm& getPcm() const noexcept { return pcm; }
+    double getSampleRate() const noexcept { return sampleRate; }
+
+    /** Hints the kernel (madvise WILLNEED where available) and touches one byte per page. */
+    void warm(int startFrame, int numFrames) const noexcept;
+
+    /** warm() for any PCM view into a mapping (e.g. a SampleBank zone). */
+    static void warmPcm(const SamplePcm& pcm, int startFrame, int numFrames) noexcept;
+
+private:
+    MappedSampleFile() = default;
+
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    SamplePcm pcm;
+    double sampleRate = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MappedSampleFile)
+};
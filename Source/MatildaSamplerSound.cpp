@@ -1,23 +1,29 @@
 #include "MatildaSamplerSound.h"
 
-MatildaSamplerSound::MatildaSamplerSound(const juce::String& name,
-                                         juce::AudioFormatReader& source,
+MatildaSamplerSound::MatildaSamplerSound(const juce::String& soundName,
+                                         SampleData::Ptr sampleData,
                                          const juce::BigInteger& notes,
                                          int midiNoteForNormalPitch,
-                                         double attackTimeSecs,
-                                         double releaseTimeSecs,
-                                         double maxSampleLengthSeconds)
-    : juce::SamplerSound(name, source, notes, midiNoteForNormalPitch,
-                        attackTimeSecs, releaseTimeSecs, maxSampleLengthSeconds)
+                                         int streamSource,
+                                         int layer,
+                                         int roundRobinPosition)
+    : name(soundName),
+      data(std::move(sampleData)),
+      midiNotes(notes),
+      midiRootNote(midiNoteForNormalPitch),
+      streamSourceId(streamSource),
+      velocityLayer(layer),
+      roundRobin(roundRobinPosition)
 {
+    jassert(data != nullptr);
 }
 
 bool MatildaSamplerSound::appliesToNote(int midiNoteNumber)
 {
-    return juce::SamplerSound::appliesToNote(midiNoteNumber);
+    return midiNotes[midiNoteNumber];
 }
 
-bool MatildaSamplerSound::appliesToChannel(int midiChannel)
+bool MatildaSamplerSound::appliesToChannel(int /*midiChannel*/)
 {
-    return juce::SamplerSound::appliesToChannel(midiChannel);
+    return true;
 }
@@ -1,23 +1,65 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "SampleData.h"
 
-class MatildaSamplerSound : public juce::SamplerSound
+/** One sample: which notes it covers, its root note, its velocity layer and
+ *  round-robin position, and the (shared, immutable) SampleData to play.
+ *  Rendering lives in MatildaSamplerVoice.
+ *  In streaming mode the data holds only the head and streamSourceId names the
+ *  file SampleStreamer reads the rest from.
+ */
+class MatildaSamplerSound : public juce::SynthesiserSound
 {
 public:
     MatildaSamplerSound(const juce::String& name,
-                       juce::AudioFormatReader& source,
+                       SampleData::Ptr data,
                        const juce::BigInteger& notes,
                        int midiNoteForNormalPitch,
-                       double attackTimeSecs,
-                       double releaseTimeSecs,
-                       double maxSampleLengthSeconds);
+                       int streamSourceId = -1,
+                       int velocityLayer = 0,
+                       int roundRobin = 0);
     
     ~MatildaSamplerSound() override = default;
     
     bool appliesToNote(int midiNoteNumber) override;
     bool appliesToChannel(int midiChannel) override;
+
+    const juce::String& getName() const noexcept { return name; }
+    SampleData& getData() const noexcept { return *data; }
+
+    /** Resident PCM (compact int16/int24, mono when the file's channels match, or the mapped file). */
+    const SamplePcm& getPcm() const noexcept { return data->getPcm(); }
+    int getResidentLength() const noexcept { return data->getResidentLength(); }
+
+    /** Full playable length in frames (resident head + streamed remainder). */
+    int getLength() const noexcept { return data->getLength(); }
+
+    double getSourceSampleRate() const noexcept { return data->getSourceSampleRate(); }
+    int getMidiRootNote() const noexcept { return midiRootNote; }
+
+    /** Keys this sound was mapped to (its own note, a bank zone's range, or all keys for an unparsed name). */
+    const juce::BigInteger& getMidiNotes() const noexcept { return midiNotes; }
+
+    /** Velocity layer (1 = softest, 0 = the note's only layer) and round-robin position; see SoundSet. */
+    int getVelocityLayer() const noexcept { return velocityLayer; }
+    int getRoundRobin() const noexcept { return roundRobin; }
+
+    bool isStreamed() const noexcept { return streamSourceId >= 0 && getResidentLength() < getLength(); }
+    int getStreamSourceId() const noexcept { return streamSourceId; }
+
+    /** Memory-mapped sound (WAV or bank zone): getPcm() holds all getLength() frames. */
+    bool isMapped() const noexcept { return data->isMapped(); }
+    float getGain() const noexcept { return data->getGain(); }
     
 private:
+    juce::String name;
+    SampleData::Ptr data;
+    juce::BigInteger midiNotes;
+    int midiRootNote = 0;
+    int streamSourceId = -1;
+    int velocityLayer = 0;
+    int roundRobin = 0;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MatildaSamplerSound)
 };
@@ -1,12 +1,10 @@
 #include "MatildaSamplerVoice.h"
+#include <limits>
 
 MatildaSamplerVoice::MatildaSamplerVoice()
 {
-    adsrParams.attack = 0.1f;
-    adsrParams.decay = 0.3f;
-    adsrParams.sustain = 0.7f;
-    adsrParams.release = 0.5f;
-    adsr.setParameters(adsrParams);
+    envelope.setParameters(envelopeParams);
+    VoiceKernel::prepareTables();
 }
 
 bool MatildaSamplerVoice::canPlaySound(juce::SynthesiserSound* sound)
@@ -16,103 +14,374 @@ bool MatildaSamplerVoice::canPlaySound(juce::SynthesiserSound* sound)
 
 void MatildaSamplerVoice::startNote(int midiNoteNumber, float velocity,
                                      juce::SynthesiserSound* sound,
-                                     int currentPitchWheelPosition)
+                                     int /*currentPitchWheelPosition*/)
 {
     if (auto* samplerSound = dynamic_cast<MatildaSamplerSound*>(sound))
     {
-        currentVelocity = velocity;
+        noteGain = velocity * samplerSound->getGain() * nextMainGain;
         isNoteOn = true;
+        sourcePeak = 1.0f;
+
+        // Velocity crossfade partner (resident, unlooped, same root and rate; the synth checks).
+        blendSound = noteGain > 0.0f ? nextBlendSound : nullptr;
+        if (auto* partner = static_cast<MatildaSamplerSound*>(blendSound.get()))
+        {
+            blendScale = velocity * partner->getGain() * nextPartnerGain / noteGain;
+            blendOffset = partner->getData().getOnsetFrame() - samplerSound->getData().getOnsetFrame();
+        }
+        nextBlendSound = nullptr;
+        nextMainGain = 1.0f;
+        nextPartnerGain = 0.0f;
+
+        const double keyRatio = nextKeyPitchRatio > 0.0
+                                    ? nextKeyPitchRatio
+                                    : std::pow(2.0, (midiNoteNumber - samplerSound->getMidiRootNote()) / 12.0);
+        nextKeyPitchRatio = 0.0;
+        pitchRatio = keyRatio * samplerSound->getSourceSampleRate() / getSampleRate();
+        sourceSamplePosition = 0.0;
+
+        // Trimmed tail: fade to silence over the sound's last few milliseconds.
+        const auto& data = samplerSound->getData();
+        fadeOutEnd = data.getLength();
+        fadeOutStart = data.getFadeOutFrames() > 0 ? fadeOutEnd - data.getFadeOutFrames() : fadeOutEnd + 1;
+        fadeOutScale = data.getFadeOutFrames() > 0 ? 1.0f / static_cast<float>(data.getFadeOutFrames()) : 0.0f;
+
+        // Sustain loop: keep cycling it until the envelope has released (the loader never streams looped sounds).
+        const auto& loop = data.getLoop();
+        const bool looped = data.hasLoop() && !samplerSound->isStreamed();
+        loopEnd = looped ? loop.end : 0;
+        loopLength = looped ? loop.end - loop.start : 0;
+        loopCrossfadeStart = loopEnd - data.getLoopCrossfadeFrames();
+        loopCrossfadeScale = data.getLoopCrossfadeFrames() > 0 ? 1.0f / static_cast<float>(data.getLoopCrossfadeFrames()) : 0.0f;
+
+        // Streamed sound: the head is resident; claim a stream and ask the I/O thread for the rest (in file frames)
+        // right away. A stolen voice gives back the stream it had first.
+        streamWindowStart = samplerSound->getResidentLength();
+        streamWindowFrames = 0;
+        if (streamSlot != nullptr)
+        {
+            streamer->releaseSlot(*streamSlot);
+            streamSlot = nullptr;
+        }
+        if (samplerSound->isStreamed() && streamer != nullptr)
+            streamSlot = streamer->claimSlot();
+        if (streamSlot != nullptr)
+            streamSlot->start(samplerSound->getStreamSourceId(), data.getStartOffset() + samplerSound->getResidentLength());
+
+        // Mapped sound: have the warmer fault in the pages just past the onset before we reach them.
+        nextWarmFrame = 0;
+        requestWarmAhead(*samplerSound);
         
-        // Start the base sampler voice
-        juce::SamplerVoice::startNote(midiNoteNumber, velocity, sound, currentPitchWheelPosition);
-        
-        // Start ADSR envelope
-        adsr.noteOn();
+        // Start the envelope
+        envelope.noteOn();
     }
 }
 
-void MatildaSamplerVoice::stopNote(float velocity, bool allowTailOff)
+void MatildaSamplerVoice::stopNote(float /*velocity*/, bool allowTailOff)
 {
     if (allowTailOff && isNoteOn)
     {
-        adsr.noteOff();
+        envelope.noteOff();
     }
     else
     {
-        adsr.reset();
-        clearCurrentNote();
-        isNoteOn = false;
+        finishNote();
     }
-    
-    juce::SamplerVoice::stopNote(velocity, allowTailOff);
 }
 
-void MatildaSamplerVoice::pitchWheelMoved(int newPitchWheelValue)
+void MatildaSamplerVoice::fadeOutForSteal() noexcept
+{
+    if (!isNoteOn)
+        return;
+
+    envelope.fadeOut(stealFadeSeconds);
+    if (!envelope.isActive())
+        finishNote();
+}
+
+void MatildaSamplerVoice::pitchWheelMoved(int /*newPitchWheelValue*/)
 {
-    juce::SamplerVoice::pitchWheelMoved(newPitchWheelValue);
 }
 
-void MatildaSamplerVoice::controllerMoved(int controllerNumber, int newControllerValue)
+void MatildaSamplerVoice::controllerMoved(int /*controllerNumber*/, int /*newControllerValue*/)
 {
-    juce::SamplerVoice::controllerMoved(controllerNumber, newControllerValue);
 }
 
 void MatildaSamplerVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer,
                                          int startSample, int numSamples)
 {
-    if (auto* playingSound = dynamic_cast<MatildaSamplerSound*>(getCurrentlyPlayingSound().get()))
+    auto* playingSound = static_cast<MatildaSamplerSound*>(getCurrentlyPlayingSound().get());
+    if (playingSound == nullptr)
+        return;
+
+    const int length = playingSound->getLength();
+    const auto& pcm = playingSound->getPcm();
+
+    if (playingSound->isStreamed() && streamSlot != nullptr)
+    {
+        // Resident head first, then frames pulled from the ring into the slot's window.
+        const int residentLength = playingSound->getResidentLength();
+        renderFrames(outputBuffer, startSample, numSamples, length,
+                     [&](int first, int count, float* l, float* r)
+                     {
+                         for (int done = 0; done < count;)
+                         {
+                             const int index = first + done;
+                             if (index < residentLength || index >= length)
+                             {
+                                 const int run = index < residentLength ? juce::jmin(count - done, residentLength - index) : count - done;
+                                 pcm.readFrames(index, run, l + done, r + done);
+                                 done += run;
+                                 continue;
+                             }
+                             if (index >= streamWindowStart + streamWindowFrames)
+                             {
+                                 fillStreamWindow(first, length);
+                                 if (index >= streamWindowStart + streamWindowFrames)
+                                 {
+                                     streamSlot->reportUnderrun();
+                                     return done;
+                                 }
+                             }
+                             const auto& window = streamSlot->getWindow();
+                             const int run = juce::jmin(count - done, streamWindowStart + streamWindowFrames - index, length - index);
+                             std::memcpy(l + done, window.getReadPointer(0, index - streamWindowStart), static_cast<size_t>(run) * sizeof(float));
+                             std::memcpy(r + done, window.getReadPointer(1, index - streamWindowStart), static_cast<size_t>(run) * sizeof(float));
+                             done += run;
+                         }
+                         return count;
+                     });
+        return;
+    }
+
+    if (loopLength > 0)
+    {
+        // A span can run past the loop end: those frames come from the loop start on, and the last
+        // frames before the end fade into the ones before the start.
+        renderFrames(outputBuffer, startSample, numSamples, pcm.numFrames,
+                     [&](int first, int count, float* l, float* r)
+                     {
+                         for (int done = 0; done < count;)
+                         {
+                             int index = first + done;
+                             while (index >= loopEnd)
+                                 index -= loopLength;
+                             const int run = juce::jmin(count - done, (index < loopCrossfadeStart ? loopCrossfadeStart : loopEnd) - index);
+                             pcm.readFrames(index, run, l + done, r + done);
+                             if (index >= loopCrossfadeStart)
+                             {
+                                 for (int i = 0; i < run; ++i)
+                                 {
+                                     float lIn, rIn;
+                                     pcm.readFrame(index + i - loopLength, lIn, rIn);
+                                     const float out = static_cast<float>(loopEnd - (index + i)) * loopCrossfadeScale;
+                                     l[done + i] = l[done + i] * out + lIn * (1.0f - out);
+                                     r[done + i] = r[done + i] * out + rIn * (1.0f - out);
+                                 }
+                             }
+                             done += run;
+                         }
+                         return count;
+                     });
+        return;
+    }
+
+    // Resident or mapped PCM, plus the velocity crossfade partner (scaled relative to us) if there is one.
+    auto* partner = static_cast<MatildaSamplerSound*>(blendSound.get());
+    renderFrames(outputBuffer, startSample, numSamples, pcm.numFrames,
+                 [&](int first, int count, float* l, float* r)
+                 {
+                     pcm.readFrames(first, count, l, r);
+                     if (partner != nullptr)
+                     {
+                         auto* pl = partnerScratch.getWritePointer(0);
+                         auto* pr = partnerScratch.getWritePointer(1);
+                         partner->getPcm().readFrames(first + blendOffset, count, pl, pr);
+                         juce::FloatVectorOperations::addWithMultiply(l, pl, blendScale, count);
+                         juce::FloatVectorOperations::addWithMultiply(r, pr, blendScale, count);
+                     }
+                     return count;
+                 });
+}
+
+template <typename SpanReader>
+void MatildaSamplerVoice::renderFrames(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples,
+                                       int playableLength, SpanReader&& readSpan)
+{
+    float* outL = outputBuffer.getWritePointer(0, startSample);
+    float* outR = outputBuffer.getNumChannels() > 1 ? outputBuffer.getWritePointer(1, startSample) : nullptr;
+    float* srcL = sourceScratch.getWritePointer(0);
+    float* srcR = sourceScratch.getWritePointer(1);
+
+    // Sub-blocks: fetch the source span as float, compute the gains (envelope shared by both channels),
+    // then interpolate, apply gain and accumulate in one kernel pass.
+    const auto quality = interpolation;
+    const int history = VoiceKernel::getHistoryFrames(quality);
+    const int tapsAhead = VoiceKernel::getNumTaps(quality) / 2;
+    while (numSamples > 0)
     {
-        // Render the sampler output
-        juce::SamplerVoice::renderNextBlock(outputBuffer, startSample, numSamples);
-        
-        // Apply ADSR envelope
-        if (adsr.isActive())
+        const auto first = static_cast<int>(sourceSamplePosition);
+        const double phase = sourceSamplePosition - first;
+
+        // An unlooped voice ends after the frame that takes it past playableLength.
+        const int framesToEnd = loopLength > 0 ? std::numeric_limits<int>::max()
+                                               : static_cast<int>((playableLength - sourceSamplePosition) / pitchRatio) + 1;
+        int n = juce::jmin(numSamples, kernelBlockFrames, framesToEnd,
+                           static_cast<int>((scratchFrames - VoiceKernel::getNumTaps(quality) - 1 - phase) / pitchRatio) + 1);
+        const int span = VoiceKernel::sourceFramesNeeded(phase, pitchRatio, n, quality);
+
+        // The span starts history frames early, for the interpolator's taps behind the position.
+        const int available = readSpan(first - history, span, srcL, srcR);
+        const bool starved = available < span;
+        if (starved)
+        {
+            // Streamed audio not there yet: play what arrived, keep our position, the rest of the block stays silent.
+            std::fill(srcL + available, srcL + span, 0.0f);
+            std::fill(srcR + available, srcR + span, 0.0f);
+            const double reach = available - history - tapsAhead - 1 - phase;
+            n = juce::jmin(n, reach < 0.0 ? 0 : static_cast<int>(reach / pitchRatio) + 1);
+            if (n <= 0)
+                break;
+        }
+
+        // Level tracking, from the fetched span (partner included): cheap, and it covers every kind of sound.
+        const auto rangeL = juce::FloatVectorOperations::findMinAndMax(srcL, span);
+        const auto rangeR = juce::FloatVectorOperations::findMinAndMax(srcR, span);
+        const float spanPeak = juce::jmax(-rangeL.getStart(), rangeL.getEnd(), -rangeR.getStart(), rangeR.getEnd());
+        sourcePeak = juce::jmax(spanPeak, sourcePeak * std::pow(peakFallPerSample, static_cast<float>(n)));
+
+        envelope.render(kernelGains, n, noteGain * outputGain);
+        if (first - history + span > fadeOutStart)
         {
-            for (int channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+            for (int i = 0; i < n; ++i)
             {
-                auto* channelData = outputBuffer.getWritePointer(channel, startSample);
-                
-                for (int sample = 0; sample < numSamples; ++sample)
-                {
-                    float envelopeValue = adsr.getNextSample();
-                    channelData[sample] *= envelopeValue;
-                }
+                const double pos = sourceSamplePosition + i * pitchRatio;
+                if (static_cast<int>(pos) >= fadeOutStart)
+                    kernelGains[i] *= juce::jmax(0.0f, static_cast<float>(fadeOutEnd - pos) * fadeOutScale);
             }
         }
+
+        VoiceKernel::mix(quality, srcL + history, srcR + history, kernelGains, n, phase, pitchRatio, outL, outR);
+        outL += n;
+        if (outR != nullptr)
+            outR += n;
+        numSamples -= n;
+
+        sourceSamplePosition += n * pitchRatio;
+        if (loopLength > 0)
+        {
+            while (sourceSamplePosition >= loopEnd)
+                sourceSamplePosition -= loopLength;
+        }
+        else if (n == framesToEnd)
+        {
+            finishNote();
+            return;
+        }
+
+        if (starved)
+            break;
+    }
+
+    // Below the audibility floor it won't come back: the envelope only rises in its attack.
+    if (!envelope.isActive() || getCurrentLevel() < cullLevel)
+        finishNote();
+}
+
+void MatildaSamplerVoice::fillStreamWindow(int firstFrameNeeded, int soundLength) noexcept
+{
+    // Drop frames the voice has already moved past, then top up from the ring.
+    auto& streamWindow = streamSlot->getWindow();
+    const int drop = juce::jlimit(0, streamWindowFrames, firstFrameNeeded - streamWindowStart);
+    if (drop > 0)
+    {
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            auto* w = streamWindow.getWritePointer(ch);
+            std::memmove(w, w + drop, static_cast<size_t>(streamWindowFrames - drop) * sizeof(float));
+        }
+        streamWindowStart += drop;
+        streamWindowFrames -= drop;
+    }
+
+    const int wanted = juce::jmin(soundLength - (streamWindowStart + streamWindowFrames),
+                                  SampleStreamer::windowCapacity - streamWindowFrames);
+    if (wanted > 0)
+        streamWindowFrames += streamSlot->read(streamWindow.getWritePointer(0, streamWindowFrames),
+                                               streamWindow.getWritePointer(1, streamWindowFrames),
+                                               wanted);
+}
+
+void MatildaSamplerVoice::warmAhead() noexcept
+{
+    // Mapped sound: keep the warmer ahead of us so we never touch a cold page.
+    if (auto* playingSound = static_cast<MatildaSamplerSound*>(getCurrentlyPlayingSound().get()))
+        requestWarmAhead(*playingSound);
+}
+
+void MatildaSamplerVoice::requestWarmAhead(const MatildaSamplerSound& sound) noexcept
+{
+    if (pageWarmer == nullptr || !sound.isMapped())
+        return;
+
+    while (nextWarmFrame < sound.getLength() && sourceSamplePosition + warmAheadFrames >= nextWarmFrame)
+    {
+        pageWarmer->requestWarm(&sound.getData(), nextWarmFrame, warmAheadFrames);
+        nextWarmFrame += warmAheadFrames;
+    }
+}
+
+void MatildaSamplerVoice::finishNote()
+{
+    envelope.reset();
+    clearCurrentNote();
+    blendSound = nullptr;
+    isNoteOn = false;
+    if (streamSlot != nullptr)
+    {
+        streamer->releaseSlot(*streamSlot);
+        streamSlot = nullptr;
     }
 }
 
 void MatildaSamplerVoice::setAttack(float attackSeconds)
 {
-    adsrParams.attack = attackSeconds;
-    updateADSRParameters();
+    envelopeParams.attack = attackSeconds;
+    updateEnvelopeParameters();
 }
 
 void MatildaSamplerVoice::setDecay(float decaySeconds)
 {
-    adsrParams.decay = decaySeconds;
-    updateADSRParameters();
+    envelopeParams.decay = decaySeconds;
+    updateEnvelopeParameters();
 }
 
 void MatildaSamplerVoice::setSustain(float sustainLevel)
 {
-    adsrParams.sustain = juce::jlimit(0.0f, 1.0f, sustainLevel);
-    updateADSRParameters();
+    envelopeParams.sustain = juce::jlimit(0.0f, 1.0f, sustainLevel);
+    updateEnvelopeParameters();
 }
 
 void MatildaSamplerVoice::setRelease(float releaseSeconds)
 {
-    adsrParams.release = releaseSeconds;
-    updateADSRParameters();
+    envelopeParams.release = releaseSeconds;
+    updateEnvelopeParameters();
+}
+
+void MatildaSamplerVoice::setEnvelopeParameters(const VoiceEnvelope::Parameters& parameters)
+{
+    envelopeParams = parameters;
+    envelopeParams.sustain = juce::jlimit(0.0f, 1.0f, parameters.sustain);
+    updateEnvelopeParameters();
 }
 
 void MatildaSamplerVoice::setSampleRate(double sampleRate)
 {
-    adsr.setSampleRate(sampleRate);
-    updateADSRParameters();
+    envelope.setSampleRate(sampleRate);
+    peakFallPerSample = static_cast<float>(std::pow(10.0, -peakFallDb / (20.0 * sampleRate)));
 }
 
-void MatildaSamplerVoice::updateADSRParameters()
+void MatildaSamplerVoice::updateEnvelopeParameters()
 {
-    adsr.setParameters(adsrParams);
+    envelope.setParameters(envelopeParams);
 }
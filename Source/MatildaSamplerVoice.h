@@ -2,8 +2,12 @@
 
 #include <JuceHeader.h>
 #include "MatildaSamplerSound.h"
+#include "SampleStreamer.h"
+#include "PageWarmer.h"
+#include "VoiceEnvelope.h"
+#include "VoiceKernel.h"
 
-class MatildaSamplerVoice : public juce::SamplerVoice
+class MatildaSamplerVoice : public juce::SynthesiserVoice
 {
 public:
     MatildaSamplerVoice();
@@ -23,15 +27,131 @@ public:
     void setSustain(float sustainLevel);
     void setRelease(float releaseSeconds);
 
+    /** All of the envelope's settings at once (one recalculation). */
+    void setEnvelopeParameters(const VoiceEnvelope::Parameters& parameters);
+
     /** Must be called (e.g. from processor prepareToPlay) so envelope timing is correct. */
     void setSampleRate(double sampleRate);
 
+    /** Where this voice claims a ring for disk-streamed audio at note-on (see SampleStreamer). Without
+        one, or with every stream taken, streamed sounds play only their resident head. */
+    void setStreamer(SampleStreamer* streamerToUse) noexcept { streamer = streamerToUse; }
+
+    /** Transposition for the next startNote(), from the synth's key map; without one the voice
+        transposes from the sound's root note itself. */
+    void setNextKeyPitchRatio(double ratio) noexcept { nextKeyPitchRatio = ratio; }
+
+    /** Adjacent velocity layer to mix into the next startNote() (nullptr = none), with the equal-power
+        gains of the two layers. The partner plays in this voice's pass, aligned on its onset. */
+    void setNextLayerBlend(MatildaSamplerSound* partner, float mainGain, float partnerGain) noexcept
+    {
+        nextBlendSound = partner;
+        nextMainGain = mainGain;
+        nextPartnerGain = partnerGain;
+    }
+
+    /** Resampling quality for transposed or rate-converted playback; takes effect from the next sub-block. */
+    void setInterpolation(VoiceKernel::Interpolation quality) noexcept { interpolation = quality; }
+    VoiceKernel::Interpolation getInterpolation() const noexcept { return interpolation; }
+
+    /** Thread that pre-faults memory-mapped pages ahead of this voice (mapped sounds only). */
+    void setPageWarmer(PageWarmer* warmer) noexcept { pageWarmer = warmer; }
+
+    /** Length of the fade a stolen voice gets instead of a hard cut. */
+    static constexpr float stealFadeSeconds = 0.003f;
+
+    /** Fades the note out over stealFadeSeconds; note-offs during the fade are ignored. */
+    void fadeOutForSteal() noexcept;
+    bool isFadingOut() const noexcept { return envelope.isFadingOut(); }
+
+    /** In its release (or a steal fade): the key that started it has let go as far as the envelope is concerned. */
+    bool isReleasing() const noexcept { return envelope.isReleasing(); }
+
+    /** Projected output level of the note: the recent source peak × velocity gain × the envelope (1 while it is
+        still attacking, since it will get there). Decides culling and which voice to steal. */
+    float getCurrentLevel() const noexcept
+    {
+        return isVoiceActive() ? sourcePeak * noteGain * (envelope.isAttacking() ? 1.0f : envelope.getLevel()) : 0.0f;
+    }
+
+    /** A note whose getCurrentLevel() falls below this (linear, 0 = never) is ended. */
+    void setCullLevel(float level) noexcept { cullLevel = level; }
+
+    /** Scales everything the voice renders, through the kernel's gains, so it costs no pass of its own. The
+        processor's mix headroom; getCurrentLevel() doesn't include it. */
+    void setOutputGain(float gain) noexcept { outputGain = gain; }
+
+    /** Audio thread, before each renderNextBlock(): posts this voice's next page-warm requests. Kept out of
+        renderNextBlock(), which may run on a render worker, because the warmer's queue has a single producer. */
+    void warmAhead() noexcept;
+
 private:
-    juce::ADSR adsr;
-    juce::ADSR::Parameters adsrParams;
+    VoiceEnvelope envelope;
+    VoiceEnvelope::Parameters envelopeParams;
     
-    float currentVelocity = 0.0f;
+    float noteGain = 0.0f; // velocity × the sound's gain
+    float outputGain = 1.0f;
     bool isNoteOn = false;
-    
-    void updateADSRParameters();
+
+    // Peak of the source frames read lately, falling at peakFallDb per second between louder spans (starts
+    // at full scale, so a note isn't judged before it has played)
+    static constexpr float peakFallDb = 60.0f;
+    float sourcePeak = 0.0f;
+    float peakFallPerSample = 1.0f;
+    float cullLevel = 0.0f;
+
+    double sourceSamplePosition = 0.0;
+    double pitchRatio = 0.0;
+    double nextKeyPitchRatio = 0.0; // 0 = none
+    VoiceKernel::Interpolation interpolation = VoiceKernel::Interpolation::linear;
+
+    // Velocity crossfade: frame i of the playing sound is mixed with frame i + blendOffset of blendSound
+    juce::SynthesiserSound::Ptr blendSound;
+    MatildaSamplerSound* nextBlendSound = nullptr;
+    float nextMainGain = 1.0f;
+    float nextPartnerGain = 0.0f;
+    float blendScale = 0.0f; // partner gain relative to noteGain
+    int blendOffset = 0;
+
+    // Trimmed sounds: linear fade from fadeOutStart to silence at fadeOutEnd (frames)
+    int fadeOutStart = 0;
+    int fadeOutEnd = 0;
+    float fadeOutScale = 0.0f;
+
+    // Looped sounds: past loopEnd, play resumes loopLength frames earlier; frames from loopCrossfadeStart
+    // on are blended with those loopLength frames earlier, so the wrap is seamless (loopLength 0 = no loop)
+    int loopEnd = 0;
+    int loopLength = 0;
+    int loopCrossfadeStart = 0;
+    float loopCrossfadeScale = 0.0f;
+
+    // Streamed sounds: frames [streamWindowStart, streamWindowStart + streamWindowFrames) pulled from the ring
+    // into the claimed slot's window
+    SampleStreamer* streamer = nullptr;
+    SampleStreamer::Slot* streamSlot = nullptr; // claimed at note-on, released when the note finishes
+    int streamWindowStart = 0;
+    int streamWindowFrames = 0;
+
+    // Mapped sounds: frames before nextWarmFrame have been handed to the page warmer
+    static constexpr int warmAheadFrames = 32768;
+    PageWarmer* pageWarmer = nullptr;
+    int nextWarmFrame = 0;
+
+    // Sub-blocks of at most kernelBlockFrames outputs; the float source frames they read go through
+    // sourceScratch (and partnerScratch for a crossfade partner), allocated with the voice.
+    static constexpr int kernelBlockFrames = 128;
+    static constexpr int scratchFrames = 1024;
+    juce::AudioBuffer<float> sourceScratch { 2, scratchFrames };
+    juce::AudioBuffer<float> partnerScratch { 2, scratchFrames };
+    float kernelGains[kernelBlockFrames] {};
+
+    /** Renders through readSpan(first, count, left, right), which fills count float frames from source frame
+        first and returns how many it could (fewer only when streamed audio hasn't arrived). */
+    template <typename SpanReader>
+    void renderFrames(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples,
+                      int playableLength, SpanReader&& readSpan);
+    void fillStreamWindow(int firstFrameNeeded, int soundLength) noexcept;
+    void requestWarmAhead(const MatildaSamplerSound& sound) noexcept;
+    void finishNote();
+    void updateEnvelopeParameters();
 };
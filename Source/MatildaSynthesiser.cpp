@@ -0,0 +1,245 @@
+#include "MatildaSynthesiser.h"
+#include "MatildaSamplerVoice.h"
+
+namespace
+{
+    // A partner layer is only mixed in where both samples play frame for frame from resident memory.
+    bool canBlend(const MatildaSamplerSound& a, const MatildaSamplerSound& b) noexcept
+    {
+        auto resident = [](const MatildaSamplerSound& s) { return !s.isStreamed() && !s.isMapped() && !s.getData().hasLoop(); };
+        return a.getMidiRootNote() == b.getMidiRootNote() && a.getSourceSampleRate() == b.getSourceSampleRate()
+               && resident(a) && resident(b);
+    }
+}
+
+MatildaSamplerVoice* MatildaSynthesiser::addVoice(MatildaSamplerVoice* newVoice)
+{
+    const juce::ScopedLock sl(lock);
+    samplerVoices.push_back(newVoice);
+    juce::Synthesiser::addVoice(newVoice);
+    return newVoice;
+}
+
+void MatildaSynthesiser::clearVoices()
+{
+    const juce::ScopedLock sl(lock);
+    samplerVoices.clear();
+    juce::Synthesiser::clearVoices();
+}
+
+void MatildaSynthesiser::noteOn(int midiChannel, int midiNoteNumber, float velocity)
+{
+    const juce::ScopedLock sl(lock);
+
+    // One lookup in the published set's key map instead of asking every sound. Voices take their own
+    // reference to the sound they start, so the set is released when we return.
+    const auto* set = soundSets.acquire();
+    const juce::ScopeGuard releaseSet { [this] { soundSets.release(); } };
+    if (set == nullptr || !juce::isPositiveAndBelow(midiNoteNumber, 128))
+        return;
+
+    const auto& key = set->getKey(midiNoteNumber);
+    if (key.numLayers == 0)
+        return;
+
+    const int midiVelocity = juce::jlimit(0, 127, juce::roundToInt(velocity * 127.0f));
+    const int layerIndex = key.layerForVelocity[static_cast<size_t>(midiVelocity)];
+    const auto& layer = key.layers[static_cast<size_t>(layerIndex)];
+
+    auto& counter = nextRoundRobin[static_cast<size_t>(midiNoteNumber)][static_cast<size_t>(layerIndex)];
+    const int alternative = counter % layer.numZones;
+    counter = static_cast<juce::uint8>((alternative + 1) % layer.numZones);
+
+    const auto& zone = set->getZone(layer.firstZone + alternative);
+    if (zone.sound == nullptr || !zone.sound->appliesToChannel(midiChannel))
+        return;
+
+    // Crossfade towards the neighbouring layer on the side of this layer's centre the velocity falls:
+    // both at -3 dB on the boundary, the main layer alone at its centre.
+    MatildaSamplerSound* partner = nullptr;
+    float mainGain = 1.0f, partnerGain = 0.0f;
+    if (velocityCrossfade.load() && key.numLayers > 1)
+    {
+        const int partnerIndex = static_cast<float>(midiVelocity) < layer.centreVelocity ? layerIndex - 1 : layerIndex + 1;
+        if (juce::isPositiveAndBelow(partnerIndex, key.numLayers))
+        {
+            const auto& partnerLayer = key.layers[static_cast<size_t>(partnerIndex)];
+            auto* candidate = set->getZone(partnerLayer.firstZone + alternative % partnerLayer.numZones).sound;
+            if (candidate != nullptr && canBlend(*zone.sound, *candidate))
+            {
+                const float x = std::abs(static_cast<float>(midiVelocity) - partnerLayer.centreVelocity)
+                              / std::abs(layer.centreVelocity - partnerLayer.centreVelocity);
+                partner = candidate;
+                mainGain = std::sin(juce::jlimit(0.0f, 1.0f, x) * juce::MathConstants<float>::halfPi);
+                partnerGain = std::cos(juce::jlimit(0.0f, 1.0f, x) * juce::MathConstants<float>::halfPi);
+            }
+        }
+    }
+
+    // A note that's still ringing (sustain pedal) is retriggered, not doubled.
+    for (auto* voice : voices)
+        if (voice->getCurrentlyPlayingNote() == midiNoteNumber && voice->isPlayingChannel(midiChannel))
+            stopVoice(voice, 1.0f, true);
+
+    if (!makeRoomForNote(midiNoteNumber))
+        return;
+
+    // Every voice is a MatildaSamplerVoice (see addVoice()).
+    if (auto* voice = static_cast<MatildaSamplerVoice*>(findFreeVoice(zone.sound, midiChannel, midiNoteNumber, isNoteStealingEnabled())))
+    {
+        voice->setNextKeyPitchRatio(zone.pitchRatio);
+        voice->setNextLayerBlend(partner, mainGain, partnerGain);
+        startVoice(voice, zone.sound, midiChannel, midiNoteNumber, velocity);
+    }
+}
+
+void MatildaSynthesiser::noteOff(int midiChannel, int midiNoteNumber, float velocity, bool allowTailOff)
+{
+    const juce::ScopedLock sl(lock);
+
+    for (auto* voice : voices)
+    {
+        if (voice->getCurrentlyPlayingNote() != midiNoteNumber || !voice->isPlayingChannel(midiChannel))
+            continue;
+
+        voice->setKeyDown(false);
+        if (!(voice->isSustainPedalDown() || voice->isSostenutoPedalDown()))
+            stopVoice(voice, velocity, allowTailOff);
+    }
+}
+
+bool MatildaSynthesiser::makeRoomForNote(int midiNoteNumber) noexcept
+{
+    // The key's oldest voices go first, down to one less than its cap.
+    const int keyCap = maxVoicesPerKey.load();
+    for (;;)
+    {
+        int onKey = 0;
+        MatildaSamplerVoice* oldest = nullptr;
+        for (auto* samplerVoice : samplerVoices)
+        {
+            if (!samplerVoice->isVoiceActive() || samplerVoice->isFadingOut()
+                || samplerVoice->getCurrentlyPlayingNote() != midiNoteNumber)
+                continue;
+            ++onKey;
+            if (oldest == nullptr || samplerVoice->wasStartedBefore(*oldest))
+                oldest = samplerVoice;
+        }
+        if (onKey < keyCap || oldest == nullptr)
+            break;
+        oldest->fadeOutForSteal();
+    }
+
+    // Then the pool: fades don't count, so a steal leaves a free voice for the new note while it fades.
+    int sounding = 0;
+    for (auto* samplerVoice : samplerVoices)
+        if (samplerVoice->isVoiceActive() && !samplerVoice->isFadingOut())
+            ++sounding;
+
+    for (const int limit = getPolyphony(); sounding >= limit; --sounding)
+    {
+        if (!isNoteStealingEnabled())
+            return false;
+        auto* victim = chooseVoiceToSteal();
+        if (victim == nullptr)
+            break;
+        victim->fadeOutForSteal();
+    }
+    return true;
+}
+
+MatildaSamplerVoice* MatildaSynthesiser::chooseVoiceToSteal() const noexcept
+{
+    // Voices per key and the lowest held key, among sounding voices.
+    std::array<int, 128> onKey {};
+    int lowestHeld = 128;
+    for (auto* samplerVoice : samplerVoices)
+    {
+        if (!samplerVoice->isVoiceActive() || samplerVoice->isFadingOut())
+            continue;
+        const int note = samplerVoice->getCurrentlyPlayingNote();
+        if (!juce::isPositiveAndBelow(note, 128))
+            continue;
+        ++onKey[static_cast<size_t>(note)];
+        if (samplerVoice->isKeyDown() && !samplerVoice->isReleasing())
+            lowestHeld = juce::jmin(lowestHeld, note);
+    }
+
+    // Rank 0 is stolen first: released repeats, released notes, held repeats, held notes, the lowest held note.
+    MatildaSamplerVoice* best = nullptr;
+    int bestRank = 0;
+    float bestLevel = 0.0f;
+    for (auto* samplerVoice : samplerVoices)
+    {
+        if (!samplerVoice->isVoiceActive() || samplerVoice->isFadingOut())
+            continue;
+        const int note = samplerVoice->getCurrentlyPlayingNote();
+        const bool repeated = juce::isPositiveAndBelow(note, 128) && onKey[static_cast<size_t>(note)] > 1;
+        const bool held = samplerVoice->isKeyDown() && !samplerVoice->isReleasing();
+        const int rank = held ? (note == lowestHeld ? 4 : (repeated ? 2 : 3)) : (repeated ? 0 : 1);
+        const float level = samplerVoice->getCurrentLevel();
+        if (best == nullptr || rank < bestRank
+            || (rank == bestRank && (level < bestLevel || (level == bestLevel && samplerVoice->wasStartedBefore(*best)))))
+        {
+            best = samplerVoice;
+            bestRank = rank;
+            bestLevel = level;
+        }
+    }
+    return best;
+}
+
+juce::SynthesiserVoice* MatildaSynthesiser::findVoiceToSteal(juce::SynthesiserSound*, int, int) const
+{
+    // A fading voice is nearly silent already, so cutting the quietest of them is the smallest click.
+    MatildaSamplerVoice* quietestFade = nullptr;
+    for (auto* samplerVoice : samplerVoices)
+        if (samplerVoice->isVoiceActive() && samplerVoice->isFadingOut()
+            && (quietestFade == nullptr || samplerVoice->getCurrentLevel() < quietestFade->getCurrentLevel()))
+            quietestFade = samplerVoice;
+
+    if (quietestFade != nullptr)
+        return quietestFade;
+    if (auto* victim = chooseVoiceToSteal())
+        return victim;
+    return voices.isEmpty() ? nullptr : voices.getFirst();
+}
+
+void MatildaSynthesiser::prepareVoiceRendering(int maxBlockSize, int numChannels)
+{
+    const juce::ScopedLock sl(lock);
+    renderBlockSize = maxBlockSize;
+    renderChannels = numChannels;
+    activeVoices.reserve(static_cast<size_t>(voices.size()));
+    renderPool.prepare(numRenderThreads, maxBlockSize, numChannels, voices.size());
+}
+
+void MatildaSynthesiser::setNumRenderThreads(int numThreads)
+{
+    const juce::ScopedLock sl(lock);
+    numRenderThreads = juce::jlimit(0, VoiceRenderPool::maxWorkers, numThreads);
+    if (renderBlockSize > 0)
+        renderPool.prepare(numRenderThreads, renderBlockSize, renderChannels, voices.size());
+}
+
+void MatildaSynthesiser::renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+{
+    // Acknowledge the current set every block, so replaced sets are reclaimed even while no keys are pressed.
+    soundSets.acquire();
+    soundSets.release();
+
+    // Page-warm requests are posted from this thread only (the warmer's queue has one producer), before any
+    // voice may render on a worker.
+    activeVoices.clear();
+    for (auto* samplerVoice : samplerVoices)
+    {
+        if (!samplerVoice->isVoiceActive())
+            continue;
+        activeVoices.push_back(samplerVoice);
+        samplerVoice->warmAhead();
+    }
+
+    if (!renderPool.render(activeVoices, outputAudio, startSample, numSamples))
+        for (auto* voice : activeVoices)
+            voice->renderNextBlock(outputAudio, startSample, numSamples);
+}
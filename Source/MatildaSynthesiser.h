@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <limits>
+#include <vector>
+#include <JuceHeader.h>
+#include "SoundSetPublisher.h"
+#include "VoiceRenderPool.h"
+
+class MatildaSamplerVoice;
+
+/** juce::Synthesiser whose sounds come from a SoundSetPublisher instead of the
+ *  base class's locked sound list. Loaders publish new sets without touching
+ *  the synth's lock, so a reload never stalls rendering or cuts notes that are
+ *  already playing; the base class's addSound()/clearSounds() are unused.
+ *
+ *  A note-on looks its key up in the set's key map (SoundSet::getKey), picks
+ *  the velocity layer from the key's table and the next round-robin sample in
+ *  that layer, and starts one voice on it, transposed as the map says. With
+ *  velocity crossfades on, that voice also plays the adjacent layer's sample,
+ *  at equal-power gains.
+ *
+ *  Polyphony is a limit on sounding voices, not the number of voices: the
+ *  voices past it are headroom for steals, which fade out over a few
+ *  milliseconds while the new note starts on a free voice. The voice to steal
+ *  is chosen by how much it is missed: released notes before held ones,
+ *  repeated notes before single ones, then the quietest, then the oldest. The
+ *  lowest held note (usually the bass) is taken last. Each key also keeps at
+ *  most a few voices, so fast repeats don't pile up tails.
+ *
+ *  Note-offs, like note-ons, match voices by note and channel only, since a
+ *  key may play a neighbour's sound.
+ *
+ *  Active voices are rendered on a VoiceRenderPool when there are enough of
+ *  them, else on the audio thread as before.
+ */
+class MatildaSynthesiser : public juce::Synthesiser
+{
+public:
+    MatildaSynthesiser() = default;
+
+    SoundSetPublisher& getSoundSets() noexcept { return soundSets; }
+
+    /** Voices are added and removed through these (not the base class's), so getSamplerVoices() stays in step. */
+    MatildaSamplerVoice* addVoice(MatildaSamplerVoice* newVoice);
+    void clearVoices();
+
+    /** Every voice, typed: for pushing settings to the voices without a cast per voice. */
+    const std::vector<MatildaSamplerVoice*>& getSamplerVoices() const noexcept { return samplerVoices; }
+
+    /** Blend adjacent velocity layers (off by default; affects the next note-ons). */
+    void setVelocityCrossfade(bool shouldCrossfade) noexcept { velocityCrossfade.store(shouldCrossfade); }
+    bool isVelocityCrossfadeEnabled() const noexcept { return velocityCrossfade.load(); }
+
+    static constexpr int defaultMaxVoicesPerKey = 4;
+
+    /** Most voices sounding at once (clamped to the number of voices); further note-ons steal. */
+    void setPolyphony(int maxSoundingVoices) noexcept { polyphony.store(juce::jmax(1, maxSoundingVoices)); }
+    int getPolyphony() const noexcept { return juce::jmin(polyphony.load(), voices.size()); }
+
+    /** Most voices one key may hold, its tails included; a repeat past this fades out the key's oldest voice. */
+    void setMaxVoicesPerKey(int maxVoices) noexcept { maxVoicesPerKey.store(juce::jmax(1, maxVoices)); }
+    int getMaxVoicesPerKey() const noexcept { return maxVoicesPerKey.load(); }
+
+    /** Off the audio thread (prepareToPlay): sizes the render pool for blocks of up to maxBlockSize samples. */
+    void prepareVoiceRendering(int maxBlockSize, int numChannels);
+
+    /** Worker threads for voice rendering (0 = render on the audio thread only). Briefly locks out rendering. */
+    void setNumRenderThreads(int numThreads);
+    int getNumRenderThreads() const noexcept { return renderPool.getNumWorkers(); }
+    /** What setNumRenderThreads() asked for; more than getNumRenderThreads() until prepared, or without real-time priority. */
+    int getRequestedRenderThreads() const noexcept { return numRenderThreads; }
+
+    /** The host's audio workgroup, for the render threads to join. */
+    void setAudioWorkgroup(const juce::AudioWorkgroup& workgroup) { renderPool.setWorkgroup(workgroup); }
+
+    void noteOn(int midiChannel, int midiNoteNumber, float velocity) override;
+
+    /** Releases the note's voices by note and channel alone: a key played by a transposed neighbour's sound isn't
+        one that sound's appliesToNote() covers, which the base class would require. The pedals already match
+        voices by channel only. */
+    void noteOff(int midiChannel, int midiNoteNumber, float velocity, bool allowTailOff) override;
+
+protected:
+    using juce::Synthesiser::renderVoices;
+    void renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override;
+
+    /** Only reached when every voice is busy, fades included: a fading voice, else the best steal, is cut. */
+    juce::SynthesiserVoice* findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                             int midiNoteNumber) const override;
+
+private:
+    SoundSetPublisher soundSets;
+    std::atomic<bool> velocityCrossfade { false };
+    std::atomic<int> polyphony { std::numeric_limits<int>::max() };
+    std::atomic<int> maxVoicesPerKey { defaultMaxVoicesPerKey };
+
+    std::vector<MatildaSamplerVoice*> samplerVoices; // owned by the base class's voices array
+
+    VoiceRenderPool renderPool;
+    int numRenderThreads = 0; // off until opted into
+    int renderBlockSize = 0;
+    int renderChannels = 0;
+    std::vector<juce::SynthesiserVoice*> activeVoices; // audio thread; reserved for every voice
+
+    // Next round-robin position per key and layer (touched only under the synth's lock)
+    std::array<std::array<juce::uint8, SoundSet::maxVelocityLayers>, 128> nextRoundRobin {};
+
+    /** The sounding (not fading) voice whose loss is least audible; nullptr if none. */
+    MatildaSamplerVoice* chooseVoiceToSteal() const noexcept;
+
+    /** Fades out what the next note would take past the key's voice cap or the polyphony. False if the note
+        must not start (polyphony reached with note stealing off). */
+    bool makeRoomForNote(int midiNoteNumber) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MatildaSynthesiser)
+};
@@ -0,0 +1,61 @@
+#include "OutputStage.h"
+
+void OutputStage::prepare(double sampleRate, int maxBlockSize)
+{
+    gain.prepare(sampleRate, maxBlockSize);
+    releasePerSample = static_cast<float>(std::exp(-1.0 / (releaseSeconds * sampleRate)));
+    holdSamples = juce::roundToInt(holdSeconds * sampleRate);
+    limiterGain = limiterTarget = 1.0f;
+    heldPeak = windowPeak = 0.0f;
+    holdLeft = 0;
+}
+
+void OutputStage::process(juce::dsp::AudioBlock<float>& block) noexcept
+{
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    if (numSamples == 0)
+        return;
+
+    // The limiter moves linearly from where the last block left it to this block's target.
+    const float* gains = gain.getNextValues(numSamples);
+    const float limiterStart = limiterGain;
+    const float limiterStep = (limiterTarget - limiterGain) / static_cast<float>(numSamples);
+
+    float peak = 0.0f;
+    for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+    {
+        float* data = block.getChannelPointer(ch);
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float y = data[i] * gains[i];
+            peak = juce::jmax(peak, std::abs(y));
+            data[i] = softClip(y * (limiterStart + limiterStep * static_cast<float>(i + 1)));
+        }
+    }
+    limiterGain = limiterTarget;
+
+    // A louder peak restarts the hold; once it runs out, the held peak drops to the last window's loudest.
+    if (peak >= heldPeak)
+    {
+        heldPeak = peak;
+        windowPeak = 0.0f;
+        holdLeft = holdSamples;
+    }
+    else
+    {
+        windowPeak = juce::jmax(windowPeak, peak);
+        holdLeft -= numSamples;
+        if (holdLeft <= 0)
+        {
+            heldPeak = windowPeak;
+            windowPeak = 0.0f;
+            holdLeft = holdSamples;
+        }
+    }
+
+    // Next block: down to what the held peak needs straight away, back up with the release.
+    const float needed = heldPeak > ceiling ? ceiling / heldPeak : 1.0f;
+    limiterTarget = needed <= limiterGain
+                        ? needed
+                        : needed - (needed - limiterGain) * std::pow(releasePerSample, static_cast<float>(numSamples));
+}
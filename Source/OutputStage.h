@@ -0,0 +1,66 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ParameterRamp.h"
+
+/** The last stage before the host: master gain and a limiter in one pass
+ *  over each control sub-block, instead of a gain pass and hard clamps.
+ *
+ *  The limiter has no lookahead. Each sub-block's peak, after the master
+ *  gain, sets the reduction the next sub-block ramps to. A louder peak brings
+ *  it down at once. The peak is held for holdSeconds, longer than a bass
+ *  note's period, so the gain doesn't ripple between a waveform's peaks.
+ *  After that it falls to the loudest peak of the last hold window and the
+ *  gain releases towards it exponentially. While the limiter catches up with
+ *  a sudden peak, a soft clipper takes the excess. It is
+ *  linear up to the ceiling and then bends towards full scale, so the output
+ *  never passes 0 dBFS and a dense chord is turned down rather than squared
+ *  off. Every step is plain arithmetic the compiler vectorises.
+ */
+class OutputStage
+{
+public:
+    /** Peaks are limited to this (-1 dBFS); the soft clipper bends above it. */
+    static constexpr float ceiling = 0.891f;
+
+    /** How long a peak sets the reduction, and the time constant of the recovery after it. */
+    static constexpr double holdSeconds = 0.02;
+    static constexpr double releaseSeconds = 0.1;
+
+    explicit OutputStage(float initialGain = 1.0f) noexcept
+        : gain(initialGain, ParameterRamp::Shape::multiplicative)
+    {
+    }
+
+    /** Off the audio thread: blocks of up to maxBlockSize samples. Snaps the gain and resets the limiter. */
+    void prepare(double sampleRate, int maxBlockSize);
+
+    /** Linear master gain, reached over ParameterRamp::defaultRampSeconds in equal dB steps. */
+    void setGain(float linearGain) noexcept { gain.setTarget(linearGain); }
+
+    /** Gain × limiter × soft clip, in place (block.getNumSamples() <= the prepared maximum). */
+    void process(juce::dsp::AudioBlock<float>& block) noexcept;
+
+    /** Limiter gain the next block starts from (1 = no reduction). */
+    float getLimiterGain() const noexcept { return limiterGain; }
+
+    /** Linear up to ceiling, then towards (never past) full scale, with no kink at the ceiling. */
+    static float softClip(float x) noexcept
+    {
+        const float magnitude = std::abs(x);
+        const float over = juce::jmax(0.0f, magnitude - ceiling) * (1.0f / (1.0f - ceiling));
+        return std::copysign(juce::jmin(magnitude, ceiling) + (1.0f - ceiling) * over / (1.0f + over), x);
+    }
+
+private:
+    ParameterRamp gain;
+    float limiterGain = 1.0f;   // at the start of the next block
+    float limiterTarget = 1.0f; // at its end
+    float releasePerSample = 0.0f;
+    float heldPeak = 0.0f;   // the peak the reduction is for
+    float windowPeak = 0.0f; // loudest peak since heldPeak was last set or held
+    int holdSamples = 0;
+    int holdLeft = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OutputStage)
+};
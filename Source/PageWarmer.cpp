@@ -0,0 +1,67 @@
+#include "PageWarmer.h"
+
+PageWarmer::PageWarmer()
+    : juce::Thread("Matilda page warmer")
+{
+}
+
+PageWarmer::~PageWarmer()
+{
+    stop();
+}
+
+void PageWarmer::start()
+{
+    if (!isThreadRunning())
+        startThread();
+}
+
+void PageWarmer::stop()
+{
+    stopThread(2000);
+
+    // Drop what was still queued: each request holds its sample, which would otherwise stay mapped
+    // (and out of reach of SamplePool::purgeUnused()) until the warmer runs again.
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+    for (int i = 0; i < size1; ++i)
+        queue[static_cast<size_t>(start1 + i)].data = nullptr;
+    for (int i = 0; i < size2; ++i)
+        queue[static_cast<size_t>(start2 + i)].data = nullptr;
+    fifo.finishedRead(size1 + size2);
+}
+
+void PageWarmer::requestWarm(SampleData* data, int startFrame, int numFrames) noexcept
+{
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 0)
+        return;
+
+    // The consumer clears each slot after use, so this only ever adds a reference (never frees on the audio thread).
+    auto& request = queue[static_cast<size_t>(start1)];
+    request.data = data;
+    request.startFrame = startFrame;
+    request.numFrames = numFrames;
+    fifo.finishedWrite(1);
+}
+
+void PageWarmer::run()
+{
+    while (!threadShouldExit())
+    {
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        fifo.prepareToRead(1, start1, size1, start2, size2);
+        if (size1 == 0)
+        {
+            wait(2);
+            continue;
+        }
+
+        auto& request = queue[static_cast<size_t>(start1)];
+        if (request.data != nullptr)
+            request.data->warm(request.startFrame, request.numFrames);
+        request.data = nullptr;
+        fifo.finishedRead(1);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <JuceHeader.h>
+#include "SampleData.h"
+
+/** Background thread that pre-faults memory-mapped sample pages ahead of the
+ *  voices reading them, so a cold page never stalls the audio thread.
+ *
+ *  Voices post requests from the audio thread through a lock-free
+ *  single-producer/single-consumer queue; when the queue is full the request is
+ *  simply dropped (the voice asks again further ahead).
+ */
+class PageWarmer : private juce::Thread
+{
+public:
+    PageWarmer();
+    ~PageWarmer() override;
+
+    void start();
+    /** Stops the thread and drops the requests it hadn't got to, with their references to the samples. */
+    void stop();
+
+    /** Audio thread: warm numFrames of mapped data starting at startFrame. Never blocks or allocates. */
+    void requestWarm(SampleData* data, int startFrame, int numFrames) noexcept;
+
+private:
+    struct Request
+    {
+        SampleData::Ptr data;
+        int startFrame = 0;
+        int numFrames = 0;
+    };
+
+    static constexpr int queueSize = 256;
+
+    void run() override;
+
+    juce::AbstractFifo fifo { queueSize };
+    std::array<Request, queueSize> queue;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PageWarmer)
+};
@@ -0,0 +1,124 @@
+#include "ParameterRamp.h"
+
+void ParameterRamp::prepare(double sampleRate, int maxBlockSize, double rampSeconds)
+{
+    rampSamples = juce::jmax(0, juce::roundToInt(rampSeconds * sampleRate));
+    capacity = juce::jmax(1, maxBlockSize);
+    values.allocate(static_cast<size_t>(capacity), true);
+    snapTo(target);
+}
+
+void ParameterRamp::setTarget(float newTarget) noexcept
+{
+    if (newTarget == target)
+        return;
+
+    target = newTarget;
+    if (rampSamples == 0)
+    {
+        snapTo(newTarget);
+        return;
+    }
+
+    remaining = rampSamples;
+    multiplyThisRamp = shape == Shape::multiplicative && current > 0.0f && target > 0.0f;
+    if (multiplyThisRamp)
+    {
+        step = static_cast<float>(std::pow(static_cast<double>(target) / current, 1.0 / rampSamples));
+        float power = 1.0f;
+        for (auto& p : stepPowers)
+            p = (power *= step);
+    }
+    else
+    {
+        step = (target - current) / static_cast<float>(rampSamples);
+    }
+}
+
+void ParameterRamp::snapTo(float value) noexcept
+{
+    current = target = value;
+    remaining = 0;
+}
+
+const float* ParameterRamp::getNextValues(int numSamples) noexcept
+{
+    jassert(numSamples <= capacity);
+    numSamples = juce::jmin(numSamples, capacity);
+    float* out = values.get();
+
+    const int run = juce::jmin(numSamples, remaining);
+    if (run > 0)
+    {
+        // Each value from the start of the run, not the one before it.
+        const float start = current;
+        if (multiplyThisRamp)
+        {
+            float base = start;
+            int i = 0;
+            for (; i + powerRun <= run; i += powerRun)
+            {
+                for (int k = 0; k < powerRun; ++k)
+                    out[i + k] = base * stepPowers[k];
+                base *= stepPowers[powerRun - 1];
+            }
+            for (int k = 0; i < run; ++i, ++k)
+                out[i] = base * stepPowers[k];
+            current = out[run - 1];
+        }
+        else
+        {
+            for (int i = 0; i < run; ++i)
+                out[i] = start + static_cast<float>(i + 1) * step;
+            current = start + static_cast<float>(run) * step;
+        }
+
+        remaining -= run;
+        if (remaining == 0)
+        {
+            current = target;
+            out[run - 1] = target;
+        }
+    }
+
+    if (run < numSamples)
+        juce::FloatVectorOperations::fill(out + run, current, numSamples - run);
+    return out;
+}
+
+void ParameterRamp::skip(int numSamples) noexcept
+{
+    const int run = juce::jmin(numSamples, remaining);
+    if (run <= 0)
+        return;
+
+    remaining -= run;
+    if (remaining == 0)
+        current = target;
+    else if (multiplyThisRamp)
+        current *= std::pow(step, static_cast<float>(run));
+    else
+        current += static_cast<float>(run) * step;
+}
+
+void ParameterRamp::applyGain(juce::dsp::AudioBlock<float>& block) noexcept
+{
+    const auto numChannels = block.getNumChannels();
+    for (size_t done = 0; done < block.getNumSamples();)
+    {
+        const int n = juce::jmin(capacity, static_cast<int>(block.getNumSamples() - done));
+        if (!isSmoothing())
+        {
+            // Constant from here on: one scalar multiply over the rest of the block.
+            const int rest = static_cast<int>(block.getNumSamples() - done);
+            for (size_t ch = 0; ch < numChannels; ++ch)
+                juce::FloatVectorOperations::multiply(block.getChannelPointer(ch) + done, current, rest);
+            return;
+        }
+
+        const float* gains = getNextValues(n);
+        for (size_t ch = 0; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::multiply(block.getChannelPointer(ch) + done, gains, n);
+        done += static_cast<size_t>(n);
+    }
+}
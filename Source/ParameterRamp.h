@@ -0,0 +1,70 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/** A continuous parameter (a gain, a mix, a drive) that moves to each new
+ *  target over a fixed time instead of jumping, rendered a block at a time.
+ *
+ *  getNextValues() fills the ramp's own buffer with one value per sample.
+ *  Linear ramps compute each value from its index. Multiplicative ramps (equal
+ *  steps in dB) scale eight precomputed powers of the per-sample factor. So
+ *  neither has a dependency from one sample to the next that stops the loop
+ *  vectorising, and a module applies the values with plain array loops. Once
+ *  the target is reached, isSmoothing() is false and the module can use
+ *  getCurrentValue() as a constant.
+ */
+class ParameterRamp
+{
+public:
+    enum class Shape
+    {
+        linear,
+        multiplicative // equal ratios per sample; ramps to or from zero are linear
+    };
+
+    /** Ramp time the effects and the master gain use. */
+    static constexpr double defaultRampSeconds = 0.02;
+
+    explicit ParameterRamp(float initialValue = 0.0f, Shape shapeToUse = Shape::linear) noexcept
+        : current(initialValue), target(initialValue), shape(shapeToUse)
+    {
+    }
+
+    /** Off the audio thread: blocks of up to maxBlockSize samples, rampSeconds per change. Snaps to the target. */
+    void prepare(double sampleRate, int maxBlockSize, double rampSeconds = defaultRampSeconds);
+
+    /** Starts a ramp from the current value (restarting any ramp in progress). */
+    void setTarget(float newTarget) noexcept;
+
+    /** Jumps to value with no ramp. */
+    void snapTo(float value) noexcept;
+
+    bool isSmoothing() const noexcept { return remaining > 0; }
+    float getCurrentValue() const noexcept { return current; }
+    float getTargetValue() const noexcept { return target; }
+
+    /** The next numSamples values (numSamples <= the prepared maximum), valid until the next call. */
+    const float* getNextValues(int numSamples) noexcept;
+
+    /** Moves on numSamples without rendering them. */
+    void skip(int numSamples) noexcept;
+
+    /** Multiplies each channel of block by the next block.getNumSamples() values. */
+    void applyGain(juce::dsp::AudioBlock<float>& block) noexcept;
+
+private:
+    static constexpr int powerRun = 8;
+
+    float current;
+    float target;
+    Shape shape;
+    int rampSamples = 0;
+    int remaining = 0;
+    bool multiplyThisRamp = false;
+    float step = 0.0f;                // linear: added per sample; multiplicative: the per-sample factor
+    float stepPowers[powerRun] {};    // step^1 .. step^powerRun
+    juce::HeapBlock<float> values;
+    int capacity = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterRamp)
+};
@@ -0,0 +1,38 @@
+#include "ParameterSnapshot.h"
+#include "Parameters.h"
+
+ParameterSnapshot::ParameterSnapshot(juce::AudioProcessorValueTreeState& state)
+{
+    auto bind = [&state](const char* id, float Values::*field, juce::uint32 groups)
+    {
+        auto* source = state.getRawParameterValue(id);
+        jassert(source != nullptr); // every ID here must be in Parameters::createParameterLayout()
+        return Binding { source, field, groups };
+    };
+
+    bindings = { bind(Parameters::ATTACK, &Values::attack, envelope),
+                 bind(Parameters::DECAY, &Values::decay, envelope),
+                 bind(Parameters::SUSTAIN, &Values::sustain, envelope),
+                 bind(Parameters::RELEASE, &Values::release, envelope),
+                 bind(Parameters::REVERB, &Values::reverb, reverb),
+                 bind(Parameters::DELAY_TIME, &Values::delayTime, delay),
+                 bind(Parameters::MASTER_VOL, &Values::masterVol, master),
+                 bind(Parameters::XY_X, &Values::xyX, tape | reverb),
+                 bind(Parameters::XY_Y, &Values::xyY, tape | reverb) };
+}
+
+juce::uint32 ParameterSnapshot::update() noexcept
+{
+    juce::uint32 dirty = forceAll.exchange(false, std::memory_order_relaxed) ? allGroups : 0;
+    for (const auto& binding : bindings)
+    {
+        const float value = binding.source != nullptr ? binding.source->load(std::memory_order_relaxed) : 0.0f;
+        auto& current = values.*binding.field;
+        if (value != current)
+        {
+            current = value;
+            dirty |= binding.groups;
+        }
+    }
+    return dirty;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <JuceHeader.h>
+
+/** The plugin's parameters as plain floats for the audio thread, with a
+ *  dirty flag per group of parameters that drive the same module.
+ *
+ *  The parameter atomics are looked up by ID once, at construction. update()
+ *  then loads each one and compares it with the last block's value, so a block
+ *  where nothing moved costs nine loads and pushes nothing on to the voices or
+ *  the effects.
+ */
+class ParameterSnapshot
+{
+public:
+    /** Groups of parameters, as bits of update()'s result. */
+    enum Group : juce::uint32
+    {
+        envelope = 1 << 0, // attack, decay, sustain, release
+        tape = 1 << 1,     // XY pad
+        delay = 1 << 2,    // delay time
+        reverb = 1 << 3,   // reverb amount, XY pad (wash)
+        master = 1 << 4,   // master volume
+        allGroups = (1 << 5) - 1
+    };
+
+    struct Values
+    {
+        float attack = 0.0f;
+        float decay = 0.0f;
+        float sustain = 0.0f;
+        float release = 0.0f;
+        float reverb = 0.0f;
+        float delayTime = 0.0f;
+        float masterVol = 0.0f;
+        float xyX = 0.0f;
+        float xyY = 0.0f;
+    };
+
+    explicit ParameterSnapshot(juce::AudioProcessorValueTreeState& state);
+
+    /** Audio thread: reads every parameter and returns the groups that changed since the last call (all of
+        them on the first call, or after markAllDirty()). */
+    juce::uint32 update() noexcept;
+
+    /** Values as of the last update(). */
+    const Values& get() const noexcept { return values; }
+
+    /** Next update() reports every group, e.g. after the modules were prepared again. */
+    void markAllDirty() noexcept { forceAll.store(true, std::memory_order_relaxed); }
+
+private:
+    struct Binding
+    {
+        std::atomic<float>* source = nullptr;
+        float Values::*field = nullptr;
+        juce::uint32 groups = 0;
+    };
+
+    std::array<Binding, 9> bindings;
+    Values values;
+    std::atomic<bool> forceAll { true };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterSnapshot)
+};
@@ -249,6 +249,8 @@ MatildaPianoAudioProcessorEditor::MatildaPianoAudioProcessorEditor(MatildaPianoA
     keyboardComponent.setAvailableRange(12, 96);
     keyboardComponent.setLowestVisibleKey(12);
     keyboardComponent.setOctaveForMiddleC(4);
+    // Velocity follows where the key is struck: nearer the front edge is louder (it reaches the synth as played).
+    keyboardComponent.setVelocity(1.0f, true);
     // Keybed background: transparent so parent can draw keyboard.png; keys drawn by MatildaKeyboardComponent (Figma style).
     keyboardComponent.setColour(juce::MidiKeyboardComponent::whiteNoteColourId, juce::Colours::transparentBlack);
     keyboardComponent.setColour(juce::MidiKeyboardComponent::blackNoteColourId, juce::Colour(0xFF3D3D3D)); // Figma black keys
@@ -333,6 +335,20 @@ MatildaPianoAudioProcessorEditor::MatildaPianoAudioProcessorEditor(MatildaPianoA
         lbl->setFont(fontLabels);
 
     setSize(editorWidth, editorHeight);
+
+    // Samples load in the background; poll the status so the progress text stays current.
+    shownSampleLoadStatus = audioProcessor.getSampleLoadStatus();
+    startTimerHz(10);
+}
+
+void MatildaPianoAudioProcessorEditor::timerCallback()
+{
+    auto status = audioProcessor.getSampleLoadStatus();
+    if (status != shownSampleLoadStatus)
+    {
+        shownSampleLoadStatus = status;
+        repaint();
+    }
 }
 
 float MatildaPianoAudioProcessorEditor::getFigmaScale() const
@@ -345,6 +361,8 @@ float MatildaPianoAudioProcessorEditor::getFigmaScale() const
 
 MatildaPianoAudioProcessorEditor::~MatildaPianoAudioProcessorEditor()
 {
+    stopTimer();
+
     // Remove look and feel before destruction
     for (auto* slider : { &attackSlider, &decaySlider, &sustainSlider, &releaseSlider })
     {
@@ -437,7 +455,7 @@ void MatildaPianoAudioProcessorEditor::paint(juce::Graphics& g)
     g.drawText("GRAND PIANO", (centreX - 70.0f * scale), 32.0f * scale, 140.0f * scale, 22.0f * scale, juce::Justification::centred);
 
     // 6) Sample load status (11px)
-    auto status = audioProcessor.getSampleLoadStatus();
+    const auto& status = shownSampleLoadStatus;
     if (status.isNotEmpty())
     {
         g.setColour(juce::Colour(0xFFffaa00));
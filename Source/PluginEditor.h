@@ -7,7 +7,8 @@
 #include "MatildaKeyboardComponent.h"
 #include "DelayModule.h"
 
-class MatildaPianoAudioProcessorEditor : public juce::AudioProcessorEditor
+class MatildaPianoAudioProcessorEditor : public juce::AudioProcessorEditor,
+                                         private juce::Timer
 {
 public:
     MatildaPianoAudioProcessorEditor(MatildaPianoAudioProcessor&);
@@ -81,6 +82,10 @@ private:
     float getFigmaScale() const;
     
     void updateDelayTimeLabel();
+
+    // Sample load status/progress, polled from the processor (loading runs on a background thread)
+    void timerCallback() override;
+    juce::String shownSampleLoadStatus;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MatildaPianoAudioProcessorEditor)
 };
@@ -19,18 +19,32 @@ MatildaPianoAudioProcessor::MatildaPianoAudioProcessor()
 #endif
     , valueTreeState(*this, nullptr, "PARAMETERS", Parameters::createParameterLayout())
 {
-    // Add voices to synthesiser
-    for (int i = 0; i < numVoices; ++i)
+    // Add voices to synthesiser; in streaming mode each claims a disk-stream ring from the streamer at note-on
+    for (int i = 0; i < maxVoices; ++i)
     {
-        synth.addVoice(new MatildaSamplerVoice());
+        auto* voice = new MatildaSamplerVoice();
+        voice->setStreamer(&streamer);
+        voice->setPageWarmer(&pageWarmer);
+        voice->setOutputGain(1.0f / static_cast<float>(headroomVoices));
+        synth.addVoice(voice);
     }
+    synth.setPolyphony(defaultPolyphony);
+    keyboardState.addListener(&uiMidiQueue);
     
-    // Load samples (will be implemented to load from Samples/ directory)
+    // Samples decode in the background so the host isn't blocked while the plugin is created
     loadSamples();
 }
 
 MatildaPianoAudioProcessor::~MatildaPianoAudioProcessor()
 {
+    keyboardState.removeListener(&uiMidiQueue);
+
+    // Drop our references into the shared sample pool so data no other instance uses is freed now.
+    sampleLoader.stopLoading();
+    synth.clearVoices();
+    synth.getSoundSets().clear();
+    if (auto* pool = SamplePool::getInstanceWithoutCreating())
+        pool->purgeUnused();
 }
 
 const juce::String MatildaPianoAudioProcessor::getName() const
@@ -97,29 +111,36 @@ void MatildaPianoAudioProcessor::prepareToPlay(double sampleRate, int samplesPer
 {
     currentSampleRate = sampleRate;
     
+    // The effects only ever see control sub-blocks (see processBlock()).
     juce::dsp::ProcessSpec spec;
     spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = static_cast<juce::uint32>(samplesPerBlock);
+    spec.maximumBlockSize = static_cast<juce::uint32>(controlBlockSize);
     spec.numChannels = static_cast<juce::uint32>(getTotalNumOutputChannels());
     
     // Prepare synthesiser
     synth.setCurrentPlaybackSampleRate(sampleRate);
     // Set ADSR sample rate on our voices so envelope timing is correct (was causing sharp burst then silence)
-    for (int i = 0; i < synth.getNumVoices(); ++i)
-    {
-        if (auto* v = dynamic_cast<MatildaSamplerVoice*>(synth.getVoice(i)))
-            v->setSampleRate(sampleRate);
-    }
+    for (auto* voice : synth.getSamplerVoices())
+        voice->setSampleRate(sampleRate);
+    synth.prepareVoiceRendering(samplesPerBlock, getTotalNumOutputChannels());
 
     // Prepare DSP modules
     tapeModule.prepare(spec);
     delayModule.prepare(spec);
     delayModule.reset();
     reverbModule.prepare(spec);
-    masterGain.prepare(spec);
+    outputStage.prepare(sampleRate, controlBlockSize);
     
-    // Set initial gain
-    masterGain.setGainLinear(Parameters::MASTER_VOL_DEFAULT);
+    // Pre-resampling: a new host rate means converting the samples again (the current ones play until then).
+    if (samplePreResampling && sampleRate != loaderOptions.targetSampleRate)
+    {
+        loaderOptions.targetSampleRate = sampleRate;
+        loadSamples();
+    }
+
+    // The modules were prepared from scratch: push every parameter again on the first block.
+    parameterSnapshot.markAllDirty();
+    delayHostTempo = 0.0;
 }
 
 void MatildaPianoAudioProcessor::releaseResources()
@@ -130,6 +151,12 @@ void MatildaPianoAudioProcessor::releaseResources()
     // only cleared in loadSamples() when reloading.
 }
 
+void MatildaPianoAudioProcessor::audioWorkgroupContextChanged(const juce::AudioWorkgroup& workgroup)
+{
+    // Voice render threads join the host's workgroup, so they are scheduled alongside the audio thread.
+    synth.setAudioWorkgroup(workgroup);
+}
+
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool MatildaPianoAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
@@ -164,55 +191,52 @@ void MatildaPianoAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
     // Update parameters
     updateParameters();
 
-    // Inject on-screen / laptop keyboard state into MIDI (poll state so we don't rely on processNextMidiBuffer timing)
-    const int midiChannel = 1;
-    for (int note = 0; note < 128; ++note)
+    // Bounces get the offline resampling quality, live playback the realtime one.
+    const auto resampling = isNonRealtime() ? offlineResampling.load() : realtimeResampling.load();
+    if (resampling != voiceResampling)
     {
-        const bool nowOn = keyboardState.isNoteOn(midiChannel, note);
-        if (nowOn != keyWasDown[note])
-        {
-            keyWasDown[note] = nowOn;
-            if (nowOn)
-                midiMessages.addEvent(juce::MidiMessage::noteOn(midiChannel, note, (juce::uint8)100), 0);
-            else
-                midiMessages.addEvent(juce::MidiMessage::noteOff(midiChannel, note), 0);
-        }
+        voiceResampling = resampling;
+        for (auto* voice : synth.getSamplerVoices())
+            voice->setInterpolation(resampling);
     }
 
+    // On-screen / laptop keyboard notes, with their velocity, at the offsets that keep the timing they were played with
+    uiMidiQueue.popInto(midiMessages, buffer.getNumSamples(), currentSampleRate);
+
+    handleNotesAwaitingSamples(midiMessages);
+
     // Process MIDI and render synthesiser
     synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
 
-    // Polyphony gain: Synthesiser sums all voices; many notes → clip → burst then flat "blank" sound.
-    // Use 1/numVoices so 32 voices peak at 1.0 (no clamp needed). Single note = 1/32; master gain
-    // is scaled in updateParameters() so the 0–1 knob gives audible level (see MASTER_MAKEUP).
-    const float polyphonyGain = 1.0f / static_cast<float>(numVoices);
-    buffer.applyGain(polyphonyGain);
-    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-    {
-        float* data = buffer.getWritePointer(ch);
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
-            data[i] = juce::jlimit(-1.0f, 1.0f, data[i]);
-    }
+    // Polyphony gain: the voices render at 1/headroomVoices (setOutputGain()), so 32 full-scale voices sum to
+    // 1.0 with no pass of its own. Master gain has make-up so a single note is audible (see updateEffectParameters()),
+    // and the output stage limits whatever a dense chord adds on top.
 
-    juce::dsp::AudioBlock<float> block(buffer);
-    juce::dsp::ProcessContextReplacing<float> context(block);
+    // Effects run in control sub-blocks: parameters are read again at each split, so a change made during
+    // a long host block lands within controlBlockSize samples, and the ramps carry it per sample from there.
+    juce::dsp::AudioBlock<float> fullBlock(buffer);
+    const int numSamples = buffer.getNumSamples();
+    for (int start = 0; start < numSamples; start += controlBlockSize)
+    {
+        if (start > 0)
+        {
+            const auto dirty = parameterSnapshot.update();
+            deferredParameterGroups |= dirty & ParameterSnapshot::envelope; // the voices have rendered this block
+            updateEffectParameters(dirty);
+        }
 
+        auto block = fullBlock.getSubBlock(static_cast<size_t>(start),
+                                           static_cast<size_t>(juce::jmin(controlBlockSize, numSamples - start)));
 #if MATILDA_BYPASS_DSP_DEBUG
-    // Bypass Tape, Delay, Reverb — synth -> master only (for "no sound" debugging; set MATILDA_BYPASS_DSP_DEBUG to 0 to restore full chain)
-    masterGain.process(context);
+        // Bypass Tape, Delay, Reverb — synth -> output stage only (for "no sound" debugging; set MATILDA_BYPASS_DSP_DEBUG to 0 to restore full chain)
+        outputStage.process(block);
 #else
-    // Full DSP chain: Tape (XY) -> Delay -> Reverb -> Master Gain
-    tapeModule.process(block);
-    delayModule.process(block);
-    reverbModule.process(block);
-    masterGain.process(context);
+        // Full DSP chain: Tape (XY) -> Delay -> Reverb -> Master Gain + limiter (never > 0 dBFS to the host)
+        tapeModule.process(block);
+        delayModule.process(block);
+        reverbModule.process(block);
+        outputStage.process(block);
 #endif
-    // Final safety clamp so master make-up never sends > 1.0 to the host (avoids burst/blank when many keys held)
-    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-    {
-        float* data = buffer.getWritePointer(ch);
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
-            data[i] = juce::jlimit(-1.0f, 1.0f, data[i]);
     }
 }
 
@@ -229,6 +253,7 @@ juce::AudioProcessorEditor* MatildaPianoAudioProcessor::createEditor()
 void MatildaPianoAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
     auto state = valueTreeState.copyState();
+    state.appendChild(saveSampleOptions(), nullptr);
     std::unique_ptr<juce::XmlElement> xml(state.createXml());
     copyXmlToBinary(*xml, destData);
 }
@@ -241,307 +266,275 @@ void MatildaPianoAudioProcessor::setStateInformation(const void* data, int sizeI
     {
         if (xmlState->hasTagName(valueTreeState.state.getType()))
         {
-            valueTreeState.replaceState(juce::ValueTree::fromXml(*xmlState));
+            auto state = juce::ValueTree::fromXml(*xmlState);
+            const auto sampleOptions = state.getChildWithName(sampleOptionsType);
+            state.removeChild(sampleOptions, nullptr);
+            valueTreeState.replaceState(state);
+
+            // Sessions saved before these settings were stored keep the current ones
+            if (sampleOptions.isValid())
+                restoreSampleOptions(sampleOptions);
         }
     }
 }
 
-void MatildaPianoAudioProcessor::loadSamples()
+juce::ValueTree MatildaPianoAudioProcessor::saveSampleOptions() const
+{
+    juce::ValueTree options(sampleOptionsType);
+    options.setProperty("streaming", isSampleStreamingEnabled(), nullptr);
+    options.setProperty("streamingPreloadMs", isSampleStreamingEnabled() ? loaderOptions.streamingPreloadSeconds * 1000.0
+                                                                         : defaultStreamingPreloadMs, nullptr);
+    options.setProperty("memoryMapped", isSampleMemoryMappingEnabled(), nullptr);
+    options.setProperty("trimSilence", isSampleTrimmingEnabled(), nullptr);
+    options.setProperty("trimThresholdDb", loaderOptions.trimThresholdDb, nullptr);
+    options.setProperty("preResampling", isSamplePreResamplingEnabled(), nullptr);
+    options.setProperty("voiceRenderThreads", synth.getRequestedRenderThreads(), nullptr);
+    return options;
+}
+
+void MatildaPianoAudioProcessor::restoreSampleOptions(const juce::ValueTree& options)
 {
-    // Clear existing sounds
-    synth.clearSounds();
-    sampleLoadStatus_.clear();
-
-    // Search order:
-    // 1) keySamples — bundled (Contents/Resources/keySamples) or next to the .app
-    //    Naming: note + octave 0–7, e.g. c0.wav, c#5.wav (c0 = C1 = MIDI 24; c7 = C8 = MIDI 108). PRD: 7 octaves.
-    // 2) ~/Music/MatildaPiano/Samples
-    // 3) ~/Documents/MatildaPiano/Samples
-    //    Naming: note name (e.g. Piano_C4.wav) or MIDI number (e.g. Piano_60.wav)
-    juce::File samplesDir;
-    bool useKeySamplesNaming = false;
-
-    auto appFile = juce::File::getSpecialLocation(juce::File::currentApplicationFile);
-    juce::File keySamplesInBundle = appFile.getChildFile("Contents/Resources/keySamples");
-    juce::File keySamplesNextToApp = appFile.getParentDirectory().getChildFile("keySamples");
-    if (keySamplesInBundle.isDirectory())
-        samplesDir = keySamplesInBundle;
-    else if (keySamplesNextToApp.isDirectory())
-        samplesDir = keySamplesNextToApp;
-    if (samplesDir.exists())
-        useKeySamplesNaming = true;
-
-    if (!samplesDir.isDirectory())
+    // Only what differs is applied, and the setters' reloads collapse into one at the end.
     {
-        samplesDir = juce::File::getSpecialLocation(juce::File::userMusicDirectory)
-                         .getChildFile("MatildaPiano")
-                         .getChildFile("Samples");
-        if (!samplesDir.isDirectory())
-        {
-            samplesDir = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
-                             .getChildFile("MatildaPiano")
-                             .getChildFile("Samples");
-        }
+        const juce::ScopedValueSetter<bool> deferReload(deferSampleReload, true);
+
+        const bool streaming = options.getProperty("streaming", isSampleStreamingEnabled());
+        const double preloadMs = options.getProperty("streamingPreloadMs", defaultStreamingPreloadMs);
+        if (streaming != isSampleStreamingEnabled()
+            || (streaming && std::abs(preloadMs - loaderOptions.streamingPreloadSeconds * 1000.0) > 0.5))
+            setSampleStreaming(streaming, preloadMs);
+
+        const bool memoryMapped = options.getProperty("memoryMapped", isSampleMemoryMappingEnabled());
+        if (memoryMapped != isSampleMemoryMappingEnabled())
+            setSampleMemoryMapping(memoryMapped);
+
+        const bool trimSilence = options.getProperty("trimSilence", isSampleTrimmingEnabled());
+        const float thresholdDb = options.getProperty("trimThresholdDb", loaderOptions.trimThresholdDb);
+        if (trimSilence != isSampleTrimmingEnabled() || thresholdDb != loaderOptions.trimThresholdDb)
+            setSampleTrimming(trimSilence, thresholdDb);
+
+        const bool preResampling = options.getProperty("preResampling", isSamplePreResamplingEnabled());
+        if (preResampling != isSamplePreResamplingEnabled())
+            setSamplePreResampling(preResampling);
     }
 
-    if (!samplesDir.isDirectory())
+    if (sampleReloadPending)
+        loadSamples();
+
+    const int renderThreads = options.getProperty("voiceRenderThreads", synth.getRequestedRenderThreads());
+    if (renderThreads != synth.getRequestedRenderThreads())
+        setVoiceRenderThreads(renderThreads);
+}
+
+void MatildaPianoAudioProcessor::loadSamples()
+{
+    if (deferSampleReload)
     {
-        sampleLoadStatus_ = "No samples found — add keySamples folder or WAV/AIFF to ~/Music/MatildaPiano/Samples or ~/Documents/MatildaPiano/Samples";
+        sampleReloadPending = true;
         return;
     }
+    sampleReloadPending = false;
 
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
+    // Decoding runs on the loader thread. The first time, sounds appear one by one as they are ready;
+    // a reload swaps the whole new set in at once, without interrupting notes that are playing.
+    sampleLoader.startLoading(loaderOptions);
+}
 
-    // Parser for keySamples naming: lowercase note + optional # + octave 0–7 (e.g. c0, c#5).
-    // Octave 0 = C1 = MIDI 24; octave 7 = C8 = MIDI 108. PRD: 7 octaves (C1–C8).
-    auto keySamplesStemToMidi = [](const juce::String& stem) -> int
-    {
-        if (stem.isEmpty()) return -1;
-        juce::String s = stem.toLowerCase().trim();
-        int i = 0;
-        auto letter = s[0];
-        int base = -1;
-        switch (letter)
-        {
-            case 'c': base = 0; break;
-            case 'd': base = 2; break;
-            case 'e': base = 4; break;
-            case 'f': base = 5; break;
-            case 'g': base = 7; break;
-            case 'a': base = 9; break;
-            case 'b': base = 11; break;
-            default: return -1;
-        }
-        i = 1;
-        if (i < s.length() && s[i] == '#') { base += 1; i++; }
-        if (i >= s.length() || !juce::CharacterFunctions::isDigit(s[i])) return -1;
-        int octave = 0;
-        while (i < s.length() && juce::CharacterFunctions::isDigit(s[i]))
-        {
-            octave = octave * 10 + (s[i] - '0');
-            i++;
-        }
-        if (octave < 0 || octave > 7) return -1;
-        int midi = 24 + octave * 12 + base;
-        return (midi >= 0 && midi <= 127) ? midi : -1;
-    };
+void MatildaPianoAudioProcessor::setSampleStreaming(bool enabled, double preloadMs)
+{
+    loaderOptions.streamingPreloadSeconds = enabled ? juce::jmax(10.0, preloadMs) / 1000.0 : 0.0;
+    if (enabled)
+        streamer.start(getNumStreamsForPolyphony());
 
-    auto noteNameToMidi = [](juce::String noteName) -> int
+    // Streamed sounds stop working with the streamer: cut them now rather than keep them until the swap.
+    if (!enabled)
     {
-        noteName = noteName.toUpperCase().retainCharacters("ABCDEFG#B0123456789-");
-        if (noteName.isEmpty())
-            return -1;
-
-        const juce::String letters = "CDEFGAB";
-        auto letter = noteName[0];
-        int base = -1;
-        switch (letter)
-        {
-            case 'C': base = 0; break;
-            case 'D': base = 2; break;
-            case 'E': base = 4; break;
-            case 'F': base = 5; break;
-            case 'G': base = 7; break;
-            case 'A': base = 9; break;
-            case 'B': base = 11; break;
-            default: return -1;
-        }
+        synth.allNotesOff(0, false);
+        synth.getSoundSets().publish(nullptr);
+    }
+    loadSamples();
 
-        int idx = 1;
-        int accidental = 0;
-        if (idx < noteName.length() && (noteName[idx] == '#' || noteName[idx] == 'B'))
-        {
-            accidental = (noteName[idx] == '#') ? 1 : -1;
-            ++idx;
-        }
+    if (!enabled)
+        streamer.stop();
+}
 
-        auto octaveStr = noteName.substring(idx).trim();
-        if (octaveStr.isEmpty() || !octaveStr.containsOnly("0123456789-"))
-            return -1;
+void MatildaPianoAudioProcessor::setPolyphony(int numVoices)
+{
+    synth.setPolyphony(juce::jlimit(1, maxVoices, numVoices));
+    if (streamer.isRunning())
+        streamer.start(getNumStreamsForPolyphony());
+}
 
-        const int octave = octaveStr.getIntValue();
-        const int midi = (octave + 1) * 12 + base + accidental; // MIDI 60 = C4
-        return (midi >= 0 && midi <= 127) ? midi : -1;
-    };
+void MatildaPianoAudioProcessor::setSampleMemoryMapping(bool enabled)
+{
+    loaderOptions.memoryMapped = enabled;
+    if (enabled)
+        pageWarmer.start();
 
-    auto parseMidiNoteFromName = [&](const juce::String& fileStem) -> int
+    // Likewise mapped sounds without the warmer: they could fault on the audio thread.
+    if (!enabled)
     {
-        // 1) Look for note names like C4, F#3, Bb2 (we treat 'b' as 'B' in uppercase pass above)
-        for (int i = 0; i < fileStem.length() - 1; ++i)
-        {
-            auto c = juce::CharacterFunctions::toUpperCase(fileStem[i]);
-            if (c < 'A' || c > 'G')
-                continue;
-
-            // Build candidate: letter + optional #/b + octave (at least 1 digit, maybe -1)
-            juce::String cand;
-            cand << c;
-
-            int j = i + 1;
-            if (j < fileStem.length())
-            {
-                auto acc = fileStem[j];
-                if (acc == '#' || acc == 'b' || acc == 'B')
-                {
-                    cand << acc;
-                    ++j;
-                }
-            }
+        synth.allNotesOff(0, false);
+        synth.getSoundSets().publish(nullptr);
+    }
+    loadSamples();
 
-            if (j >= fileStem.length())
-                continue;
+    if (!enabled)
+        pageWarmer.stop();
+}
 
-            // Octave: optional '-' then digits
-            int k = j;
-            if (fileStem[k] == '-')
-                ++k;
+void MatildaPianoAudioProcessor::setSamplePreResampling(bool enabled)
+{
+    // Before the first prepareToPlay() there is no host rate yet; prepareToPlay() sets it and reloads.
+    samplePreResampling = enabled;
+    loaderOptions.targetSampleRate = enabled ? getSampleRate() : 0.0;
+    loadSamples();
+}
 
-            int digitStart = k;
-            while (k < fileStem.length() && juce::CharacterFunctions::isDigit(fileStem[k]))
-                ++k;
+void MatildaPianoAudioProcessor::setSampleTrimming(bool enabled, float thresholdDb)
+{
+    loaderOptions.trimSilence = enabled;
+    loaderOptions.trimThresholdDb = juce::jlimit(-120.0f, -20.0f, thresholdDb);
+    loadSamples();
+}
 
-            if (k == digitStart)
-                continue;
+juce::String MatildaPianoAudioProcessor::getSampleLoadStatus() const
+{
+    return sampleLoader.getStatus();
+}
 
-            cand << fileStem.substring(j, k);
-            if (auto midi = noteNameToMidi(cand); midi != -1)
-                return midi;
+void MatildaPianoAudioProcessor::handleNotesAwaitingSamples(juce::MidiBuffer& midiMessages)
+{
+    // Note-ons for keys whose own sample is still being decoded ask the loader for it next, even while a
+    // neighbour plays the key transposed. Keys nothing plays yet are remembered, so the note starts (late)
+    // when its sound arrives, if the key is still held.
+    for (const auto metadata : midiMessages)
+    {
+        const auto message = metadata.getMessage();
+        const int note = message.getNoteNumber();
+        if (message.isNoteOn())
+        {
+            if (!sampleLoader.isOwnSampleLoaded(note))
+                sampleLoader.requestNote(note);
+            if (!sampleLoader.isNoteLoaded(note))
+            {
+                if (awaitingVelocity[static_cast<size_t>(note)] == 0)
+                    ++numNotesAwaitingSamples;
+                awaitingVelocity[static_cast<size_t>(note)] = message.getVelocity();
+                awaitingChannel[static_cast<size_t>(note)] = message.getChannel();
+            }
         }
-
-        // 2) Look for a MIDI note number token 0..127
-        for (int i = 0; i < fileStem.length(); ++i)
+        else if (message.isNoteOff() && awaitingVelocity[static_cast<size_t>(note)] != 0)
         {
-            if (!juce::CharacterFunctions::isDigit(fileStem[i]))
-                continue;
-
-            int j = i;
-            while (j < fileStem.length() && juce::CharacterFunctions::isDigit(fileStem[j]))
-                ++j;
-
-            auto token = fileStem.substring(i, j);
-            const int midi = token.getIntValue();
-            if (midi >= 0 && midi <= 127)
-                return midi;
-
-            i = j;
+            awaitingVelocity[static_cast<size_t>(note)] = 0;
+            --numNotesAwaitingSamples;
         }
+    }
 
-        return -1;
-    };
-
-    juce::Array<juce::File> files;
-    samplesDir.findChildFiles(files, juce::File::findFiles, true, "*.wav;*.wave;*.aif;*.aiff");
-    if (files.isEmpty())
-    {
-        sampleLoadStatus_ = "No samples found — add WAV/AIFF to " + samplesDir.getFullPathName();
+    if (numNotesAwaitingSamples == 0)
         return;
-    }
 
-    for (const auto& f : files)
+    for (int note = 0; note < 128; ++note)
     {
-        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(f));
-        if (!reader)
-            continue;
-
-        auto fileStem = f.getFileNameWithoutExtension();
-        int midi = -1;
-        if (useKeySamplesNaming)
-            midi = keySamplesStemToMidi(fileStem);
-        if (midi == -1)
-            midi = parseMidiNoteFromName(fileStem);
-
-        juce::BigInteger notes;
-        if (midi != -1)
-            notes.setBit(midi);
-        else
-            notes.setRange(0, 128, true); // fallback
-
-        // Small attack (3 ms) to avoid clicks/glitches on note start (e.g. F3/G3 transients)
-        const double sampleAttackSecs = 0.003;
-        auto sound = std::make_unique<MatildaSamplerSound>(
-            f.getFileNameWithoutExtension(),
-            *reader,
-            notes,
-            midi != -1 ? midi : 60,
-            sampleAttackSecs,
-            0.1,
-            30.0
-        );
-
-        synth.addSound(sound.release());
+        auto& velocity = awaitingVelocity[static_cast<size_t>(note)];
+        if (velocity != 0 && sampleLoader.isNoteLoaded(note))
+        {
+            midiMessages.addEvent(juce::MidiMessage::noteOn(awaitingChannel[static_cast<size_t>(note)], note, velocity), 0);
+            velocity = 0;
+            --numNotesAwaitingSamples;
+        }
     }
-    // Clear status when at least one sound was loaded
-    sampleLoadStatus_.clear();
 }
 
 void MatildaPianoAudioProcessor::updateParameters()
 {
+    // Only what moved since the last update is pushed on, and only to the module it drives.
+    const auto dirty = parameterSnapshot.update() | deferredParameterGroups;
+    deferredParameterGroups = 0;
+    const auto& p = parameterSnapshot.get();
+
     // Update ADSR for all voices
-    float attack = valueTreeState.getRawParameterValue(Parameters::ATTACK)->load();
-    float decay = valueTreeState.getRawParameterValue(Parameters::DECAY)->load();
-    float sustain = valueTreeState.getRawParameterValue(Parameters::SUSTAIN)->load();
-    float release = valueTreeState.getRawParameterValue(Parameters::RELEASE)->load();
-    
-    for (int i = 0; i < synth.getNumVoices(); ++i)
+    const auto curve = envelopeCurve.load();
+    if ((dirty & ParameterSnapshot::envelope) != 0 || curve != voiceEnvelopeCurve)
     {
-        if (auto* voice = dynamic_cast<MatildaSamplerVoice*>(synth.getVoice(i)))
-        {
-            voice->setAttack(attack);
-            voice->setDecay(decay);
-            voice->setSustain(sustain);
-            voice->setRelease(release);
-        }
+        voiceEnvelopeCurve = curve;
+        const VoiceEnvelope::Parameters envelopeParams { p.attack, p.decay, p.sustain, p.release, curve };
+        for (auto* voice : synth.getSamplerVoices())
+            voice->setEnvelopeParameters(envelopeParams);
     }
-    
-    // Update tape module (XY pad)
-    float xyX = valueTreeState.getRawParameterValue(Parameters::XY_X)->load();
-    float xyY = valueTreeState.getRawParameterValue(Parameters::XY_Y)->load();
-    
-    tapeModule.setWowFlutterRate(xyX);
-    tapeModule.setSaturation(xyY);
-    tapeModule.setToneCutoff(1.0f - xyY * 0.5f); // Darker as Y increases
-    
-    // Update delay module — lowest knob position = Off (mix 0), then 1/64..1
-    float delayKnob = valueTreeState.getRawParameterValue(Parameters::DELAY_TIME)->load();
-    const float delayOffThreshold = 0.05f;
-    if (delayKnob <= delayOffThreshold)
-    {
-        delayModule.setMix(0.0f);
-        delayModule.setDelayTime(0.0f);
-    }
-    else
+
+    const float cullLevel = voiceCullLevel.load();
+    if (cullLevel != voiceCullLevelApplied)
     {
-        float t = (delayKnob - delayOffThreshold) / (1.0f - delayOffThreshold);
-        delayModule.setDelayTime(t);
-        // Higher mix so delay is clearly audible (0.4–0.8 range when on)
-        delayModule.setMix(juce::jlimit(0.4f, 0.8f, 0.4f + t * 0.4f));
+        voiceCullLevelApplied = cullLevel;
+        for (auto* voice : synth.getSamplerVoices())
+            voice->setCullLevel(cullLevel);
     }
-    
-    // Try to get host tempo if available
+
+    updateEffectParameters(dirty);
+
+    // Try to get host tempo if available (the delay recalculates its time only when it changes)
     if (auto* playHead = getPlayHead())
     {
         if (auto positionInfo = playHead->getPosition())
         {
             if (auto bpm = positionInfo->getBpm())
             {
-                if (*bpm > 0.0)
+                if (*bpm > 0.0 && *bpm != delayHostTempo)
+                {
+                    delayHostTempo = *bpm;
                     delayModule.setHostTempo(*bpm);
+                }
             }
         }
     }
+}
+
+void MatildaPianoAudioProcessor::updateEffectParameters(juce::uint32 dirty)
+{
+    const auto& p = parameterSnapshot.get();
+
+    // Update tape module (XY pad)
+    if ((dirty & ParameterSnapshot::tape) != 0)
+    {
+        tapeModule.setWowFlutterRate(p.xyX);
+        tapeModule.setSaturation(p.xyY);
+        tapeModule.setToneCutoff(1.0f - p.xyY * 0.5f); // Darker as Y increases
+    }
+    
+    // Update delay module — lowest knob position = Off (mix 0), then 1/64..1
+    if ((dirty & ParameterSnapshot::delay) != 0)
+    {
+        const float delayOffThreshold = 0.05f;
+        if (p.delayTime <= delayOffThreshold)
+        {
+            delayModule.setMix(0.0f);
+            delayModule.setDelayTime(0.0f);
+        }
+        else
+        {
+            float t = (p.delayTime - delayOffThreshold) / (1.0f - delayOffThreshold);
+            delayModule.setDelayTime(t);
+            // Higher mix so delay is clearly audible (0.4–0.8 range when on)
+            delayModule.setMix(juce::jlimit(0.4f, 0.8f, 0.4f + t * 0.4f));
+        }
+    }
     
     // Update reverb module. Base reverb from knob; XY pad adds "wash" (watery, washed-out vibe)
-    float baseReverb = valueTreeState.getRawParameterValue(Parameters::REVERB)->load();
-    float xyWash = xyY * 0.5f + xyX * 0.3f;  // Y = main wash, X = secondary
-    float reverbMix = juce::jlimit(0.0f, 1.0f, baseReverb + xyWash);
-    reverbModule.setMix(reverbMix);
+    if ((dirty & ParameterSnapshot::reverb) != 0)
+    {
+        float xyWash = p.xyY * 0.5f + p.xyX * 0.3f;  // Y = main wash, X = secondary
+        float reverbMix = juce::jlimit(0.0f, 1.0f, p.reverb + xyWash);
+        reverbModule.setMix(reverbMix);
+    }
     
-    // Update master gain. Knob stays 0–1; we apply make-up so that after 1/numVoices polyphony gain
+    // Update master gain. Knob stays 0–1; we apply make-up so that after 1/headroomVoices polyphony gain
     // a single note is audible (e.g. 0.8 → ~12.8 linear so 1 note ≈ 0.4).
-    const float masterMakeUp = 16.0f;
-    float masterVol = valueTreeState.getRawParameterValue(Parameters::MASTER_VOL)->load();
-    masterGain.setGainLinear(masterVol * masterMakeUp);
+    if ((dirty & ParameterSnapshot::master) != 0)
+    {
+        const float masterMakeUp = 16.0f;
+        outputStage.setGain(p.masterVol * masterMakeUp);
+    }
 }
 
 // This creates new instances of the plugin.
@@ -1,13 +1,19 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <JuceHeader.h>
 #include "Parameters.h"
+#include "OutputStage.h"
+#include "ParameterSnapshot.h"
 #include "MatildaSamplerVoice.h"
 #include "MatildaSamplerSound.h"
+#include "MatildaSynthesiser.h"
 #include "TapeModule.h"
 #include "DelayModule.h"
 #include "ReverbModule.h"
+#include "SampleLoader.h"
+#include "UiMidiQueue.h"
 
 class MatildaPianoAudioProcessor : public juce::AudioProcessor
 {
@@ -17,6 +23,7 @@ public:
 
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void audioWorkgroupContextChanged(const juce::AudioWorkgroup& workgroup) override;
 
 #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
@@ -45,35 +52,159 @@ public:
     
     juce::AudioProcessorValueTreeState& getValueTreeState() { return valueTreeState; }
     
-    // Sample loading
+    // Sample loading — starts (or restarts) the background loader; returns immediately
     void loadSamples();
     juce::Synthesiser& getSynth() { return synth; }
 
-    /** Shared keyboard state for the on-screen MidiKeyboardComponent; processor injects it into MIDI in processBlock. */
+    /** Shared keyboard state for the on-screen MidiKeyboardComponent; its key presses reach processBlock() through the UI MIDI queue. */
     juce::MidiKeyboardState& getKeyboardState() { return keyboardState; }
     const juce::MidiKeyboardState& getKeyboardState() const { return keyboardState; }
 
-    /** Status message for UI (e.g. "No samples found"). Updated in loadSamples(); safe to read from message thread. */
-    juce::String getSampleLoadStatus() const { return sampleLoadStatus_; }
+    /** For any other UI source of notes: push from the message thread only (the queue has a single producer). */
+    UiMidiQueue& getUiMidiQueue() noexcept { return uiMidiQueue; }
+
+    /** Status message for UI (e.g. "Loading samples... 40%", "No samples found"). Empty once loaded; safe to read from message thread. */
+    juce::String getSampleLoadStatus() const;
+
+    /** Streaming mode: keep only the first preloadMs of each sample in RAM and stream the rest
+        from disk (saves memory in large sessions). Reloads the samples. */
+    void setSampleStreaming(bool enabled, double preloadMs = defaultStreamingPreloadMs);
+    bool isSampleStreamingEnabled() const noexcept { return loaderOptions.streamingPreloadSeconds > 0.0; }
+
+    /** Memory-mapped mode: voices render straight from the mapped WAV files (near-instant load,
+        bank shared with other processes through the OS page cache). Reloads the samples. */
+    void setSampleMemoryMapping(bool enabled);
+    bool isSampleMemoryMappingEnabled() const noexcept { return loaderOptions.memoryMapped; }
+
+    /** Silence trimming: cut leading silence and tails below thresholdDb at load (on by default). Reloads the
+        samples; the current ones keep playing until the new set is ready. */
+    void setSampleTrimming(bool enabled, float thresholdDb = SampleData::defaultTrimThresholdDb);
+    bool isSampleTrimmingEnabled() const noexcept { return loaderOptions.trimSilence; }
+
+    /** Pre-resampling: convert the samples to the host rate in the background whenever prepareToPlay() sees a new
+        rate, so untransposed keys play without interpolation. Each rate's conversion is cached on disk. Off by
+        default; resident loads only (not streaming or memory-mapped). Reloads the samples. */
+    void setSamplePreResampling(bool enabled);
+    bool isSamplePreResamplingEnabled() const noexcept { return samplePreResampling; }
+
+    /** Velocity crossfades: each note also plays the adjacent velocity layer at equal-power gains
+        (resident, unlooped samples only). Off by default; takes effect from the next note. */
+    void setVelocityCrossfade(bool enabled) noexcept { synth.setVelocityCrossfade(enabled); }
+    bool isVelocityCrossfadeEnabled() const noexcept { return synth.isVelocityCrossfadeEnabled(); }
+
+    /** Resampling quality for transposed keys and rate conversion: realtime while playing live, offline while
+        the host renders non-realtime (bounce/export). Defaults: linear live, 16-tap sinc offline. */
+    void setResamplingQuality(VoiceKernel::Interpolation realtime, VoiceKernel::Interpolation offline) noexcept
+    {
+        realtimeResampling.store(realtime);
+        offlineResampling.store(offline);
+    }
+    VoiceKernel::Interpolation getResamplingQuality(bool offline) const noexcept
+    {
+        return offline ? offlineResampling.load() : realtimeResampling.load();
+    }
+
+    /** Shape of the voices' decay and release: linear, or exponential like a string's natural decay. */
+    void setEnvelopeCurve(VoiceEnvelope::Curve curve) noexcept { envelopeCurve.store(curve); }
+    VoiceEnvelope::Curve getEnvelopeCurve() const noexcept { return envelopeCurve.load(); }
+
+    /** Worker threads that render voices alongside the audio thread (0 = audio thread only, the default). Only threads
+        that get real-time priority are started. Not for the audio thread. Saved with the session, like the sample
+        streaming, memory-mapping, trimming and pre-resampling modes. */
+    void setVoiceRenderThreads(int numThreads) { synth.setNumRenderThreads(numThreads); }
+    int getVoiceRenderThreads() const noexcept { return synth.getNumRenderThreads(); }
+
+    /** Most voices sounding at once (1..maxVoices, default 64); past it, note-ons steal the least audible voice
+        with a short fade. While streaming, raising it gives the streamer more rings, so not for the audio thread. */
+    void setPolyphony(int numVoices);
+    int getPolyphony() const noexcept { return synth.getPolyphony(); }
+
+    /** Voice culling: a note is ended once its projected level falls below floorDb (relative to a full-scale
+        note; on by default at -80 dB). Takes effect from the next block. */
+    void setVoiceCulling(bool enabled, float floorDb = defaultVoiceCullFloorDb) noexcept
+    {
+        voiceCullLevel.store(enabled ? juce::Decibels::decibelsToGain(floorDb) : 0.0f);
+    }
+    bool isVoiceCullingEnabled() const noexcept { return voiceCullLevel.load() > 0.0f; }
+    static constexpr float defaultVoiceCullFloorDb = -80.0f;
+
+    /** Most voices one key keeps ringing when it is repeated (default 4). */
+    void setMaxVoicesPerKey(int numVoices) noexcept { synth.setMaxVoicesPerKey(numVoices); }
+    int getMaxVoicesPerKey() const noexcept { return synth.getMaxVoicesPerKey(); }
+
+    /** Times a streaming voice found its disk ring empty (audible dropout). */
+    int getStreamUnderrunCount() const noexcept { return streamer.getNumUnderruns(); }
+
+    static constexpr double defaultStreamingPreloadMs = 250.0;
+
+    /** Fraction of the sample library decoded so far, 0..1. */
+    float getSampleLoadProgress() const noexcept { return sampleLoader.getProgress(); }
+    bool isLoadingSamples() const noexcept { return sampleLoader.isLoading(); }
 
 private:
     juce::AudioProcessorValueTreeState valueTreeState;
+    ParameterSnapshot parameterSnapshot { valueTreeState };
     juce::MidiKeyboardState keyboardState;
-    juce::Synthesiser synth;
-    static constexpr int numVoices = 32;
+    UiMidiQueue uiMidiQueue; // listens to keyboardState
+    MatildaSynthesiser synth;
+
+    // Every voice is allocated up front; polyphony limits how many sound at once (the rest absorb steal fades).
+    static constexpr int maxVoices = 256;
+    static constexpr int defaultPolyphony = 64;
+    // Voices render at 1/headroomVoices, so this many full-scale voices peak at 1.0, whatever the polyphony.
+    static constexpr int headroomVoices = 32;
     
     TapeModule tapeModule;
     DelayModule delayModule;
     ReverbModule reverbModule;
     
-    juce::dsp::Gain<float> masterGain;
+    // Master gain (make-up included, ramped per sample) and the limiter, after the effects
+    OutputStage outputStage { Parameters::MASTER_VOL_DEFAULT };
+
+    // Longest stretch the effects process between parameter reads
+    static constexpr int controlBlockSize = 64;
     
     double currentSampleRate = 44100.0;
 
-    juce::String sampleLoadStatus_;
-    std::array<bool, 128> keyWasDown = {};
+    std::atomic<VoiceKernel::Interpolation> realtimeResampling { VoiceKernel::Interpolation::linear };
+    std::atomic<VoiceKernel::Interpolation> offlineResampling { VoiceKernel::Interpolation::sinc16 };
+    VoiceKernel::Interpolation voiceResampling = VoiceKernel::Interpolation::linear; // what the voices have; audio thread only
+    std::atomic<VoiceEnvelope::Curve> envelopeCurve { VoiceEnvelope::Curve::linear };
+    std::atomic<float> voiceCullLevel { juce::Decibels::decibelsToGain(defaultVoiceCullFloorDb) };
+
+    // What updateParameters() last pushed to the voices and the delay (audio thread only)
+    VoiceEnvelope::Curve voiceEnvelopeCurve = VoiceEnvelope::Curve::linear;
+    float voiceCullLevelApplied = -1.0f;
+    double delayHostTempo = 0.0;
+    juce::uint32 deferredParameterGroups = 0; // changed mid-block, for the voices at the next block
+
+    // Streams the voices can claim, beyond the polyphony: room for the fades of stolen voices.
+    static constexpr int stealFadeStreams = 16;
+    int getNumStreamsForPolyphony() const noexcept { return juce::jmin(maxVoices, getPolyphony() + stealFadeStreams); }
+
+    // Declared after synth: the streamer feeds its voices and the loader publishes into it; both stop first on destruction.
+    SampleStreamer streamer { maxVoices };
+    PageWarmer pageWarmer;
+    SampleLoader sampleLoader { synth.getSoundSets(), streamer };
+    SampleLoader::Options loaderOptions;
+    bool samplePreResampling = false;
+
+    // The sample-mode settings above are saved with the session, in a child of the parameter state the host
+    // never sees. Restoring them reloads the samples once, however many changed.
+    static inline const juce::Identifier sampleOptionsType { "SAMPLE_OPTIONS" };
+    juce::ValueTree saveSampleOptions() const;
+    void restoreSampleOptions(const juce::ValueTree& options);
+    bool deferSampleReload = false;
+    bool sampleReloadPending = false;
+
+    // Held notes whose sample wasn't loaded yet at note-on (velocity 0 = none); audio thread only.
+    std::array<juce::uint8, 128> awaitingVelocity = {};
+    std::array<int, 128> awaitingChannel = {};
+    int numNotesAwaitingSamples = 0;
 
     void updateParameters();
+    void updateEffectParameters(juce::uint32 dirtyGroups);
+    void handleNotesAwaitingSamples(juce::MidiBuffer& midiMessages);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MatildaPianoAudioProcessor)
 };
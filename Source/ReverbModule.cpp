@@ -9,6 +9,7 @@ void ReverbModule::prepare(const juce::dsp::ProcessSpec& spec)
 {
     reverb.prepare(spec);
     updateReverbParameters();
+    mix.prepare(spec.sampleRate, static_cast<int>(spec.maximumBlockSize));
 
     wetBuffer.setSize(static_cast<int>(spec.numChannels),
                       static_cast<int>(spec.maximumBlockSize),
@@ -33,14 +34,15 @@ void ReverbModule::process(juce::dsp::AudioBlock<float>& block)
     auto wetContext = juce::dsp::ProcessContextReplacing<float>(wetBlock);
     reverb.process(wetContext);
 
-    // Mix wetBuffer back into the original block.
+    // Mix wetBuffer back into the original block, the mix ramped per sample.
+    const float* mixValues = mix.getNextValues(numSamples);
     for (int ch = 0; ch < numChannels; ++ch)
     {
         auto* dryData = block.getChannelPointer(static_cast<size_t>(ch));
         const auto* wetData = wetBuffer.getReadPointer(ch);
 
         for (int i = 0; i < numSamples; ++i)
-            dryData[i] = dryData[i] * (1.0f - mix) + wetData[i] * mix;
+            dryData[i] = dryData[i] * (1.0f - mixValues[i]) + wetData[i] * mixValues[i];
     }
 }
 
@@ -51,7 +53,7 @@ void ReverbModule::reset()
 
 void ReverbModule::setMix(float mixValue)
 {
-    mix = juce::jlimit(0.0f, 1.0f, mixValue);
+    mix.setTarget(juce::jlimit(0.0f, 1.0f, mixValue));
 }
 
 void ReverbModule::updateReverbParameters()
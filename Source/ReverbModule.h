@@ -1,6 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ParameterRamp.h"
 
 class ReverbModule
 {
@@ -12,13 +13,13 @@ public:
     void process(juce::dsp::AudioBlock<float>& block);
     void reset();
     
-    void setMix(float mix); // 0.0 to 1.0
+    void setMix(float mix); // 0.0 to 1.0, ramped per sample
     
 private:
     juce::dsp::Reverb reverb;
     juce::dsp::Reverb::Parameters reverbParams;
     
-    float mix = 0.0f;
+    ParameterRamp mix;
     juce::AudioBuffer<float> wetBuffer;
     
     void updateReverbParameters();
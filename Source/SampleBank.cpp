@@ -0,0 +1,239 @@
+#include "SampleBank.h"
+#include <limits>
+
+namespace
+{
+    constexpr char kMagic[4] = { 'M', 'P', 'B', 'K' };
+    constexpr juce::uint32 kVersion = 1;
+    constexpr int kHeaderSize = 32;
+    constexpr int kEntrySize = 64;
+    constexpr int kNameSize = 24;
+
+    // Index entry (64 bytes):
+    //   0 rootNote u8, 1 lowNote u8, 2 highNote u8, 3 encoding u8 (0 int16, 1 int24, 2 float32)
+    //   4 numChannels u16, 6 velocityLayer u8, 7 roundRobin u8 (0 in older banks = unlayered)
+    //   8 sampleRate u32, 12 numFrames u32
+    //  16 loopStart i32, 20 loopEnd i32, 24 gain f32, 28 flacBytes u32 (0 = raw PCM)
+    //  32 dataOffset u64, 40 name (UTF-8, zero-padded, 24 bytes)
+
+    float readFloat(const char* p) noexcept
+    {
+        const auto bits = juce::ByteOrder::littleEndianInt(p);
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    bool decodeEncoding(int code, SamplePcm::Encoding& encoding) noexcept
+    {
+        switch (code)
+        {
+            case 0: encoding = SamplePcm::Encoding::int16; return true;
+            case 1: encoding = SamplePcm::Encoding::int24; return true;
+            case 2: encoding = SamplePcm::Encoding::float32; return true;
+            default: return false;
+        }
+    }
+
+    int encodingCode(SamplePcm::Encoding encoding) noexcept
+    {
+        return encoding == SamplePcm::Encoding::int16 ? 0 : (encoding == SamplePcm::Encoding::int24 ? 1 : 2);
+    }
+
+    juce::int64 alignUp(juce::int64 offset) noexcept
+    {
+        return (offset + SampleBank::pcmAlignment - 1) / SampleBank::pcmAlignment * SampleBank::pcmAlignment;
+    }
+
+    // The zone's integer PCM as a FLAC stream, fed as left-justified ints so nothing is requantised.
+    juce::MemoryBlock encodeFlac(const SampleBank::Zone& zone)
+    {
+        const auto& pcm = zone.pcm;
+        juce::MemoryBlock block;
+        juce::FlacAudioFormat flac;
+        auto stream = std::make_unique<juce::MemoryOutputStream>(block, false);
+        std::unique_ptr<juce::AudioFormatWriter> writer(flac.createWriterFor(stream.get(), zone.sampleRate,
+                                                                             static_cast<unsigned int>(pcm.numChannels),
+                                                                             pcm.encoding == SamplePcm::Encoding::int16 ? 16 : 24,
+                                                                             {}, 5));
+        if (writer == nullptr)
+            return {};
+        stream.release();
+
+        constexpr int chunk = 4096;
+        juce::HeapBlock<int> samples(2 * chunk);
+        const int* channels[3] = { samples.get(), pcm.numChannels > 1 ? samples.get() + chunk : nullptr, nullptr };
+        const int bytesPerSample = SamplePcm::bytesPerSample(pcm.encoding);
+        for (int start = 0; start < pcm.numFrames; start += chunk)
+        {
+            const int n = juce::jmin(chunk, pcm.numFrames - start);
+            for (int ch = 0; ch < pcm.numChannels; ++ch)
+            {
+                auto* dest = samples.get() + ch * chunk;
+                const char* src = pcm.data + static_cast<size_t>(start) * static_cast<size_t>(pcm.getBytesPerFrame())
+                                  + ch * bytesPerSample;
+                for (int i = 0; i < n; ++i, src += pcm.getBytesPerFrame())
+                    dest[i] = pcm.encoding == SamplePcm::Encoding::int16
+                                  ? static_cast<juce::int16>(juce::ByteOrder::littleEndianShort(src)) * 65536
+                                  : juce::ByteOrder::littleEndian24Bit(src) * 256;
+            }
+            if (!writer->write(channels, n))
+                return {};
+        }
+
+        writer.reset(); // flushes the last frame and the stream info into block
+        return block;
+    }
+}
+
+SampleBank::Ptr SampleBank::open(const juce::File& bankFile)
+{
+    if (!bankFile.existsAsFile())
+        return nullptr;
+
+    auto map = std::make_unique<juce::MemoryMappedFile>(bankFile, juce::MemoryMappedFile::readOnly, false);
+    const auto* bytes = static_cast<const char*>(map->getData());
+    const auto size = static_cast<juce::int64>(map->getSize());
+    if (bytes == nullptr || size < kHeaderSize || std::memcmp(bytes, kMagic, sizeof(kMagic)) != 0)
+        return nullptr;
+
+    const auto version = juce::ByteOrder::littleEndianInt(bytes + 4);
+    const auto numZones = static_cast<int>(juce::ByteOrder::littleEndianInt(bytes + 8));
+    const auto entrySize = static_cast<int>(juce::ByteOrder::littleEndianInt(bytes + 12));
+    if (version != kVersion || entrySize != kEntrySize || numZones < 0
+        || kHeaderSize + static_cast<juce::int64>(numZones) * kEntrySize > size)
+        return nullptr;
+
+    Ptr bank(new SampleBank());
+    for (int i = 0; i < numZones; ++i)
+    {
+        const char* entry = bytes + kHeaderSize + i * kEntrySize;
+
+        Zone zone;
+        zone.rootNote = static_cast<juce::uint8>(entry[0]);
+        zone.lowNote = static_cast<juce::uint8>(entry[1]);
+        zone.highNote = static_cast<juce::uint8>(entry[2]);
+        zone.pcm.numChannels = juce::ByteOrder::littleEndianShort(entry + 4);
+        zone.velocityLayer = static_cast<juce::uint8>(entry[6]);
+        zone.roundRobin = static_cast<juce::uint8>(entry[7]);
+        zone.sampleRate = static_cast<double>(juce::ByteOrder::littleEndianInt(entry + 8));
+        const auto numFrames = juce::ByteOrder::littleEndianInt(entry + 12);
+        zone.pcm.numFrames = static_cast<int>(juce::jmin(numFrames, static_cast<juce::uint32>(std::numeric_limits<int>::max())));
+        zone.loopStart = static_cast<int>(juce::ByteOrder::littleEndianInt(entry + 16));
+        zone.loopEnd = static_cast<int>(juce::ByteOrder::littleEndianInt(entry + 20));
+        zone.gain = readFloat(entry + 24);
+        zone.compressedSize = juce::ByteOrder::littleEndianInt(entry + 28);
+        zone.name = juce::String::fromUTF8(entry + 40, static_cast<int>(strnlen(entry + 40, kNameSize)));
+
+        const auto dataOffset = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(entry + 32));
+        if (!decodeEncoding(static_cast<juce::uint8>(entry[3]), zone.pcm.encoding)
+            || zone.rootNote > 127 || zone.lowNote > zone.highNote || zone.highNote > 127
+            || zone.pcm.numChannels < 1 || zone.pcm.numChannels > 2 || zone.sampleRate <= 0.0 || dataOffset < 0
+            || numFrames == 0 || numFrames > static_cast<juce::uint32>(std::numeric_limits<int>::max()))
+            return nullptr;
+
+        // Loop points lie within the zone (-1 = none). Banks also come from the writable resample cache.
+        const bool hasLoop = zone.loopStart >= 0 || zone.loopEnd >= 0;
+        if (hasLoop && (zone.loopStart < 0 || zone.loopEnd < zone.loopStart || zone.loopEnd > zone.pcm.numFrames))
+            return nullptr;
+
+        // Compared as offset > size - bytes so a huge entry can't overflow the sum.
+        const auto dataBytes = zone.isCompressed() ? static_cast<juce::int64>(zone.compressedSize)
+                                                   : static_cast<juce::int64>(zone.pcm.numFrames) * zone.pcm.getBytesPerFrame();
+        if (dataBytes > size || dataOffset > size - dataBytes)
+            return nullptr;
+
+        if (zone.isCompressed())
+            zone.compressedData = bytes + dataOffset;
+        else
+            zone.pcm.data = bytes + dataOffset;
+        bank->zones.add(zone);
+    }
+
+    bank->file = bankFile;
+    bank->map = std::move(map);
+    return bank;
+}
+
+juce::String SampleBank::write(const juce::File& dest, const juce::Array<Zone>& zonesToWrite, Compression compression)
+{
+    // Encode first (if asked), then assign every zone a page-aligned offset after the index.
+    juce::Array<juce::MemoryBlock> flacStreams;
+    juce::Array<juce::int64> offsets;
+    auto offset = alignUp(kHeaderSize + static_cast<juce::int64>(zonesToWrite.size()) * kEntrySize);
+    for (const auto& zone : zonesToWrite)
+    {
+        if (!zone.pcm.isValid() || zone.pcm.numChannels > 2)
+            return "Zone \"" + zone.name + "\" has no usable PCM";
+
+        juce::MemoryBlock flacStream;
+        if (compression == Compression::flac && zone.pcm.encoding != SamplePcm::Encoding::float32)
+        {
+            flacStream = encodeFlac(zone);
+            if (flacStream.isEmpty())
+                return "Can't FLAC-encode zone \"" + zone.name + "\"";
+        }
+
+        const auto dataBytes = !flacStream.isEmpty() ? static_cast<juce::int64>(flacStream.getSize())
+                                                     : static_cast<juce::int64>(zone.pcm.numFrames) * zone.pcm.getBytesPerFrame();
+        flacStreams.add(std::move(flacStream));
+        offsets.add(offset);
+        offset = alignUp(offset + dataBytes);
+    }
+
+    juce::TemporaryFile temp(dest);
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (out.failedToOpen())
+            return "Can't write " + temp.getFile().getFullPathName();
+
+        out.write(kMagic, sizeof(kMagic));
+        out.writeInt(static_cast<int>(kVersion));
+        out.writeInt(zonesToWrite.size());
+        out.writeInt(kEntrySize);
+        for (int i = 0; i < 4; ++i)
+            out.writeInt(0);
+
+        for (int i = 0; i < zonesToWrite.size(); ++i)
+        {
+            const auto& zone = zonesToWrite.getReference(i);
+            out.writeByte(static_cast<char>(zone.rootNote));
+            out.writeByte(static_cast<char>(zone.lowNote));
+            out.writeByte(static_cast<char>(zone.highNote));
+            out.writeByte(static_cast<char>(encodingCode(zone.pcm.encoding)));
+            out.writeShort(static_cast<short>(zone.pcm.numChannels));
+            out.writeByte(static_cast<char>(juce::jlimit(0, 255, zone.velocityLayer)));
+            out.writeByte(static_cast<char>(juce::jlimit(0, 255, zone.roundRobin)));
+            out.writeInt(juce::roundToInt(zone.sampleRate));
+            out.writeInt(zone.pcm.numFrames);
+            out.writeInt(zone.loopStart);
+            out.writeInt(zone.loopEnd);
+            out.writeFloat(zone.gain);
+            out.writeInt(static_cast<int>(flacStreams.getReference(i).getSize()));
+            out.writeInt64(offsets[i]);
+
+            char name[kNameSize] = {};
+            zone.name.copyToUTF8(name, kNameSize); // truncates, always zero-terminated
+            out.write(name, kNameSize);
+        }
+
+        for (int i = 0; i < zonesToWrite.size(); ++i)
+        {
+            const auto& pcm = zonesToWrite.getReference(i).pcm;
+            const auto& flacStream = flacStreams.getReference(i);
+            out.writeRepeatedByte(0, static_cast<size_t>(offsets[i] - out.getPosition()));
+            if (!flacStream.isEmpty())
+                out.write(flacStream.getData(), flacStream.getSize());
+            else
+                out.write(pcm.data, static_cast<size_t>(pcm.numFrames) * static_cast<size_t>(pcm.getBytesPerFrame()));
+        }
+
+        out.flush();
+        if (out.getStatus().failed())
+            return "Write failed: " + out.getStatus().getErrorMessage();
+    }
+
+    if (!temp.overwriteTargetFileWithTemporary())
+        return "Can't replace " + dest.getFullPathName();
+    return {};
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SamplePcm.h"
+
+/** A prebuilt single-file sample bank (.mbank): a header index of zones (note
+ *  mapping, format, loop points, gain) followed by each zone's PCM, already
+ *  decoded and page-aligned. The file is memory-mapped, so opening it reads
+ *  only the index and the zones' PCM is played in place.
+ *
+ *  A bank can instead store integer zones losslessly as FLAC (about half the
+ *  size on disk); those are decompressed into RAM by the loader thread and play
+ *  back bit-identical to the uncompressed bank.
+ *
+ *  Built from a sample folder by the MatildaBankBuilder tool (CMake target
+ *  MatildaPianoBank); SampleLoader prefers a bank over loose files.
+ *
+ *  Layered instruments have one zone per velocity layer and round-robin
+ *  alternative.
+ *
+ *  Layout (all little-endian):
+ *    header  32 bytes: "MPBK", version, numZones, entrySize, reserved
+ *    index   numZones × 64 bytes, see SampleBank.cpp
+ *    PCM     per zone, interleaved, starting on a pcmAlignment boundary
+ */
+class SampleBank : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<SampleBank>;
+
+    /** Looked for inside the samples folder. */
+    static constexpr const char* defaultFileName = "MatildaPiano.mbank";
+
+    /** Every zone's PCM starts on a page boundary. */
+    static constexpr int pcmAlignment = 4096;
+
+    enum class Compression
+    {
+        none,
+        flac // integer zones only; float zones are always stored raw
+    };
+
+    struct Zone
+    {
+        juce::String name;
+        int rootNote = 60;
+        int lowNote = 60;
+        int highNote = 60;
+        int velocityLayer = 0; // as MatildaSamplerSound; zones with the same notes and layer are round-robin alternatives
+        int roundRobin = 0;
+        double sampleRate = 44100.0;
+        int loopStart = -1; // frames; -1 = no loop
+        int loopEnd = -1;
+        float gain = 1.0f;
+
+        /** Raw zones: the PCM in the bank. Compressed zones: pcm.data is null and
+            the rest describes the decoded audio; the FLAC stream is compressedData. */
+        SamplePcm pcm;
+        const char* compressedData = nullptr;
+        size_t compressedSize = 0;
+
+        bool isCompressed() const noexcept { return compressedSize > 0; }
+    };
+
+    /** Maps and validates a bank; nullptr if the file is missing, truncated or not a bank. */
+    static Ptr open(const juce::File& file);
+
+    /** Writes zones (raw pcm copied as-is, or FLAC-encoded) to dest. Returns an error message, empty on success. */
+    static juce::String write(const juce::File& dest, const juce::Array<Zone>& zones,
+                              Compression compression = Compression::none);
+
+    const juce::File& getFile() const noexcept { return file; }
+    int getNumZones() const noexcept { return zones.size(); }
+    const Zone& getZone(int index) const noexcept { return zones.getReference(index); }
+
+private:
+    SampleBank() = default;
+
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    juce::Array<Zone> zones;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleBank)
+};
@@ -0,0 +1,346 @@
+#include "SampleData.h"
+#include "VoiceKernel.h"
+#include <vector>
+
+namespace
+{
+    // AudioFormatReader's integer output: left-justified 32-bit ints, or the raw bits of floats for float files.
+    float sampleToFloat(int v, bool isFloat) noexcept
+    {
+        if (!isFloat)
+            return static_cast<float>(v) * (1.0f / 2147483648.0f);
+        float f;
+        std::memcpy(&f, &v, sizeof(f));
+        return f;
+    }
+
+    int floatToSample(float f) noexcept
+    {
+        int v;
+        std::memcpy(&v, &f, sizeof(v));
+        return v;
+    }
+}
+
+SampleData::Ptr SampleData::decode(juce::AudioFormatReader& source, double maxSampleLengthSeconds, double residentSeconds,
+                                   float trimThreshold, Loop loop, AudibleRange known)
+{
+    Ptr data(new SampleData());
+    data->sourceSampleRate = source.sampleRate;
+
+    if (source.sampleRate <= 0 || source.lengthInSamples <= 0 || source.numChannels == 0)
+        return data;
+
+    data->length = juce::jmin(static_cast<int>(source.lengthInSamples),
+                              static_cast<int>(maxSampleLengthSeconds * source.sampleRate));
+
+    int residentLength = data->length;
+    if (residentSeconds > 0.0)
+        residentLength = juce::jlimit(1, data->length, static_cast<int>(residentSeconds * source.sampleRate));
+
+    // Read integers (exact for 16/24-bit sources, so a round trip through a bank or FLAC is bit-identical),
+    // then pack. The 32-bit planes only live for the duration of the load.
+    const int numChannels = juce::jmin(2, static_cast<int>(source.numChannels));
+    const bool isFloat = source.usesFloatingPointData;
+    juce::HeapBlock<int> decoded(static_cast<size_t>(residentLength) * 2, true);
+    int* const planes[2] = { decoded.get(), decoded.get() + residentLength };
+    source.read(planes, numChannels, 0, residentLength, true);
+
+    bool foldToMono = numChannels > 1;
+    for (int i = 0; foldToMono && i < residentLength; ++i)
+        foldToMono = std::abs(sampleToFloat(planes[0][i], isFloat) - sampleToFloat(planes[1][i], isFloat)) <= monoFoldTolerance;
+
+    auto& pcm = data->pcm;
+    pcm.encoding = encodingFor(source);
+    pcm.numChannels = foldToMono ? 1 : numChannels;
+    pcm.numFrames = residentLength;
+    data->storage.allocate(static_cast<size_t>(residentLength) * static_cast<size_t>(pcm.getBytesPerFrame()), false);
+    pcm.data = data->storage.get();
+
+    const int bytesPerSample = SamplePcm::bytesPerSample(pcm.encoding);
+    char* out = data->storage.get();
+    for (int i = 0; i < residentLength; ++i)
+    {
+        for (int ch = 0; ch < pcm.numChannels; ++ch)
+        {
+            int v = planes[ch][i];
+            if (foldToMono)
+                v = isFloat ? floatToSample(0.5f * (sampleToFloat(planes[0][i], true) + sampleToFloat(planes[1][i], true)))
+                            : static_cast<int>((static_cast<juce::int64>(planes[0][i]) + planes[1][i]) / 2);
+
+            switch (pcm.encoding)
+            {
+                case SamplePcm::Encoding::int16:
+                {
+                    const auto le = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint16>(v >> 16));
+                    std::memcpy(out, &le, sizeof(le));
+                    break;
+                }
+                case SamplePcm::Encoding::int24:
+                    juce::ByteOrder::littleEndian24BitToChars(v >> 8, out);
+                    break;
+                case SamplePcm::Encoding::float32:
+                default:
+                {
+                    const float f = sampleToFloat(v, isFloat);
+                    std::memcpy(out, &f, sizeof(f));
+                    break;
+                }
+            }
+            out += bytesPerSample;
+        }
+    }
+
+    if (residentLength == data->length)
+        data->setLoop(loop);
+    if (trimThreshold > 0.0f)
+        data->trimSilence(trimThreshold, residentLength == data->length, known);
+    return data;
+}
+
+SampleData::Ptr SampleData::fromMappedFile(MappedSampleFile::Ptr mapped, double maxSampleLengthSeconds, float trimThreshold,
+                                            Loop loop, AudibleRange known)
+{
+    Ptr data(new SampleData());
+    if (mapped != nullptr)
+    {
+        data->sourceSampleRate = mapped->getSampleRate();
+        data->pcm = mapped->getPcm();
+        data->pcm.numFrames = juce::jmin(data->pcm.numFrames,
+                                         static_cast<int>(maxSampleLengthSeconds * data->sourceSampleRate));
+        data->length = data->pcm.numFrames;
+        data->mappedFile = std::move(mapped);
+        data->setLoop(loop);
+        if (trimThreshold > 0.0f)
+            data->trimSilence(trimThreshold, true, known);
+    }
+    return data;
+}
+
+SampleData::Ptr SampleData::fromBank(SampleBank::Ptr bank, int zoneIndex, double maxSampleLengthSeconds, float trimThreshold)
+{
+    if (bank == nullptr || !juce::isPositiveAndBelow(zoneIndex, bank->getNumZones()))
+        return new SampleData();
+
+    const auto& zone = bank->getZone(zoneIndex);
+    if (zone.isCompressed())
+    {
+        // FLAC zone: decompress into compact RAM (we're on the loader thread); integers in, integers out.
+        juce::FlacAudioFormat flac;
+        std::unique_ptr<juce::AudioFormatReader> reader(flac.createReaderFor(
+            new juce::MemoryInputStream(zone.compressedData, zone.compressedSize, false), true));
+        if (reader == nullptr)
+            return new SampleData();
+
+        auto data = decode(*reader, maxSampleLengthSeconds, 0.0, trimThreshold, { zone.loopStart, zone.loopEnd });
+        data->gain = zone.gain;
+        return data;
+    }
+
+    Ptr data(new SampleData());
+    data->sourceSampleRate = zone.sampleRate;
+    data->gain = zone.gain;
+    data->pcm = zone.pcm;
+    data->pcm.numFrames = juce::jmin(data->pcm.numFrames,
+                                     static_cast<int>(maxSampleLengthSeconds * data->sourceSampleRate));
+    data->length = data->pcm.numFrames;
+    data->bank = std::move(bank);
+    data->setLoop({ zone.loopStart, zone.loopEnd });
+    if (trimThreshold > 0.0f)
+        data->trimSilence(trimThreshold, true, {});
+    return data;
+}
+
+SampleData::Ptr SampleData::resample(const SampleData& source, double targetRate)
+{
+    const auto& src = source.pcm;
+    if (targetRate <= 0.0 || source.sourceSampleRate <= 0.0 || source.sourceSampleRate == targetRate
+        || !src.isValid() || src.numFrames < source.length)
+        return nullptr;
+
+    const double ratio = source.sourceSampleRate / targetRate; // source frames per output frame
+    Ptr data(new SampleData());
+    data->sourceSampleRate = targetRate;
+    data->gain = source.gain;
+    data->length = static_cast<int>((source.length - 1) / ratio) + 1;
+    data->onsetFrame = juce::roundToInt(source.onsetFrame / ratio);
+    data->fadeOutFrames = juce::jmin(data->length, juce::roundToInt(source.fadeOutFrames / ratio));
+    if (source.loop.isValid())
+    {
+        data->loop = { juce::roundToInt(source.loop.start / ratio), data->length };
+        if (!data->loop.isValid())
+            data->loop = {};
+    }
+
+    auto& pcm = data->pcm;
+    pcm.encoding = src.encoding;
+    pcm.numChannels = src.numChannels;
+    pcm.numFrames = data->length;
+    data->storage.allocate(static_cast<size_t>(pcm.numFrames) * static_cast<size_t>(pcm.getBytesPerFrame()), false);
+    pcm.data = data->storage.get();
+
+    // Short chunks, like the voice's sub-blocks, so the kernel's float positions stay exact to well below a
+    // frame; each chunk restarts from the double position. Frames outside the source read as silence.
+    constexpr auto quality = VoiceKernel::Interpolation::sinc16;
+    constexpr int chunk = 256;
+    const int history = VoiceKernel::getHistoryFrames(quality);
+    const int maxSpan = VoiceKernel::sourceFramesNeeded(0.999, ratio, chunk, quality);
+    juce::AudioBuffer<float> in(2, maxSpan), out(2, chunk);
+    std::vector<float> ones(static_cast<size_t>(chunk), 1.0f);
+
+    const int bytesPerSample = SamplePcm::bytesPerSample(pcm.encoding);
+    char* dest = data->storage.get();
+    for (int done = 0; done < pcm.numFrames; done += chunk)
+    {
+        const int n = juce::jmin(chunk, pcm.numFrames - done);
+        const double position = done * ratio;
+        const auto first = static_cast<int>(position);
+        const double phase = position - first;
+        const int span = VoiceKernel::sourceFramesNeeded(phase, ratio, n, quality);
+        src.readFrames(first - history, span, in.getWritePointer(0), in.getWritePointer(1));
+        out.clear();
+        VoiceKernel::mix(quality, in.getReadPointer(0) + history, in.getReadPointer(1) + history, ones.data(), n,
+                         phase, ratio, out.getWritePointer(0), out.getWritePointer(1));
+
+        for (int i = 0; i < n; ++i)
+        {
+            for (int ch = 0; ch < pcm.numChannels; ++ch)
+            {
+                const float v = out.getSample(ch, i);
+                switch (pcm.encoding)
+                {
+                    case SamplePcm::Encoding::int16:
+                    {
+                        const auto s = static_cast<juce::int16>(juce::jlimit(-32768, 32767, juce::roundToInt(v * 32768.0f)));
+                        const auto le = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint16>(s));
+                        std::memcpy(dest, &le, sizeof(le));
+                        break;
+                    }
+                    case SamplePcm::Encoding::int24:
+                        juce::ByteOrder::littleEndian24BitToChars(juce::jlimit(-8388608, 8388607, juce::roundToInt(v * 8388608.0f)), dest);
+                        break;
+                    case SamplePcm::Encoding::float32:
+                    default:
+                        std::memcpy(dest, &v, sizeof(v));
+                        break;
+                }
+                dest += bytesPerSample;
+            }
+        }
+    }
+
+    return data;
+}
+
+void SampleData::trimSilence(float threshold, bool wholeSample, AudibleRange known)
+{
+    auto isAudible = [this, threshold](int frame)
+    {
+        float l = 0.0f, r = 0.0f;
+        pcm.readFrame(frame, l, r);
+        return std::abs(l) > threshold || std::abs(r) > threshold;
+    };
+
+    // Scan in from both ends, so only the silence itself is read (this matters for mapped files). A known
+    // range from an earlier load of the file skips even that.
+    int first = known.first;
+    if (!juce::isPositiveAndBelow(first, pcm.numFrames))
+    {
+        first = 0;
+        while (first < pcm.numFrames && !isAudible(first))
+            ++first;
+    }
+    if (first == pcm.numFrames)
+        return; // nothing audible (or nothing audible yet, for a streaming head): leave it alone
+    audible.first = first;
+
+    int start = juce::jmax(0, first - static_cast<int>(trimPreRollSeconds * sourceSampleRate));
+    int end = pcm.numFrames;
+    const int fade = static_cast<int>(tailFadeSeconds * sourceSampleRate);
+    if (loop.isValid())
+    {
+        // Looped: keep the loop and the audio its start crossfades from; setLoop() has already cut the tail.
+        start = juce::jmin(start, juce::jmax(0, loop.start - static_cast<int>(loopCrossfadeSeconds * sourceSampleRate)));
+    }
+    else if (wholeSample)
+    {
+        int last = known.last;
+        if (last < first || last >= pcm.numFrames)
+        {
+            last = pcm.numFrames - 1;
+            while (last > first && !isAudible(last))
+                --last;
+        }
+        audible.last = last;
+        end = juce::jmin(pcm.numFrames, last + 1 + fade);
+    }
+
+    const auto bytesPerFrame = static_cast<size_t>(pcm.getBytesPerFrame());
+    const int numFrames = end - start;
+    if (storage != nullptr)
+    {
+        // Decoded: keep just the span, so the trimmed frames cost no RAM.
+        std::memmove(storage.get(), storage.get() + static_cast<size_t>(start) * bytesPerFrame,
+                     static_cast<size_t>(numFrames) * bytesPerFrame);
+        storage.realloc(static_cast<size_t>(numFrames) * bytesPerFrame);
+        pcm.data = storage.get();
+    }
+    else
+    {
+        pcm.data += static_cast<size_t>(start) * bytesPerFrame;
+    }
+
+    pcm.numFrames = numFrames;
+    startOffset = start;
+    onsetFrame = first - start;
+    length = wholeSample ? numFrames : length - start;
+    if (loop.isValid())
+    {
+        loop.start -= start;
+        loop.end -= start;
+    }
+
+    // The tail now ends at (or fades just past) the threshold; fading it is inaudible but removes any step.
+    if (wholeSample && !loop.isValid())
+        fadeOutFrames = juce::jmin(fade, numFrames - onsetFrame);
+}
+
+void SampleData::setLoop(Loop newLoop)
+{
+    if (!newLoop.isValid() || newLoop.end > pcm.numFrames)
+        return;
+
+    loop = newLoop;
+    if (storage != nullptr)
+        storage.realloc(static_cast<size_t>(loop.end) * static_cast<size_t>(pcm.getBytesPerFrame()));
+    pcm.data = storage != nullptr ? storage.get() : pcm.data;
+    pcm.numFrames = length = loop.end;
+}
+
+int SampleData::getLoopCrossfadeFrames() const noexcept
+{
+    if (!loop.isValid())
+        return 0;
+    return juce::jmin(static_cast<int>(loopCrossfadeSeconds * sourceSampleRate), loop.start, loop.end - loop.start);
+}
+
+void SampleData::warm(int startFrame, int numFrames) const noexcept
+{
+    if (isMapped())
+        MappedSampleFile::warmPcm(pcm, startFrame, numFrames);
+}
+
+size_t SampleData::getMemoryUsage() const noexcept
+{
+    if (isMapped())
+        return 0;
+    return static_cast<size_t>(pcm.numFrames) * static_cast<size_t>(pcm.getBytesPerFrame());
+}
+
+SamplePcm::Encoding SampleData::encodingFor(const juce::AudioFormatReader& source) noexcept
+{
+    // Keep the source's resolution: a 16-bit file is stored as 16-bit, nothing is lost or padded.
+    if (source.usesFloatingPointData || source.bitsPerSample > 24)
+        return SamplePcm::Encoding::float32;
+    return source.bitsPerSample > 16 ? SamplePcm::Encoding::int24 : SamplePcm::Encoding::int16;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "MappedSampleFile.h"
+#include "SampleBank.h"
+#include "SamplePcm.h"
+
+/** The audio of one sample file, built once and never modified afterwards:
+ *  either decoded PCM (the whole sample, or just the head in streaming mode) or
+ *  a view of a memory-mapped file or bank zone. Reference-counted so every sound and every
+ *  plugin instance that uses the same file can share it (see SamplePool).
+ *
+ *  Decoded PCM is kept in the source's own width (16/24-bit integer, float only
+ *  for float files) and stereo files whose channels match are folded to mono;
+ *  the voice converts to float as it renders.
+ *
+ *  With a trim threshold, leading silence (all but a short pre-roll) and the
+ *  tail below the threshold are cut at load; the voice fades out over the last
+ *  getFadeOutFrames() so the cut never clicks.
+ *
+ *  A sample with a sustain loop ends at the loop end: the voice wraps back to
+ *  the loop start, crossfading into it over getLoopCrossfadeFrames().
+ */
+class SampleData : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<SampleData>;
+
+    /** Sustain loop, [start, end) in frames; start < 0 = none. */
+    struct Loop
+    {
+        int start = -1;
+        int end = -1;
+
+        bool isValid() const noexcept { return start >= 0 && end > start; }
+    };
+
+    /** What trimming found at one threshold: the first and last frames above it, in source frames (-1 = not
+        known). Passed back in for the same file and threshold, it spares the scan through the silence. */
+    struct AudibleRange
+    {
+        int first = -1;
+        int last = -1; // only found for a whole, unlooped sample
+    };
+
+    /** Longest sample played (loader and bank builder); any extra is not decoded. */
+    static constexpr double maxSampleLengthSeconds = 30.0;
+
+    /** Largest |L - R| (full scale = 1) for a stereo file to be stored as mono; ~3 LSB at 16 bit. */
+    static constexpr float monoFoldTolerance = 1.0e-4f;
+
+    /** Default silence trim threshold (SampleLoader::Options::trimThresholdDb). */
+    static constexpr float defaultTrimThresholdDb = -60.0f;
+
+    /** Kept before the first audible frame so soft attacks aren't clipped. */
+    static constexpr double trimPreRollSeconds = 0.002;
+
+    /** Fade-out length at a truncated tail. */
+    static constexpr double tailFadeSeconds = 0.01;
+
+    /** Longest crossfade into a loop's start (shorter if the loop or the audio before it is shorter). */
+    static constexpr double loopCrossfadeSeconds = 0.02;
+
+    /** Decodes up to maxSampleLengthSeconds; residentSeconds > 0 keeps only that much (streaming head).
+        trimThreshold > 0 (linear) trims silence; a streaming head only loses leading silence.
+        loop is in source frames and is dropped for a streaming head or if it runs past the decoded length.
+        known is a previous getAudibleRange() for this file at trimThreshold; frames it doesn't cover are scanned. */
+    static Ptr decode(juce::AudioFormatReader& source, double maxSampleLengthSeconds, double residentSeconds = 0.0,
+                      float trimThreshold = 0.0f, Loop loop = {}, AudibleRange known = {});
+
+    /** Wraps a mapped file; nothing is decoded (trimming just narrows the view). */
+    static Ptr fromMappedFile(MappedSampleFile::Ptr mappedFile, double maxSampleLengthSeconds, float trimThreshold = 0.0f,
+                              Loop loop = {}, AudibleRange known = {});
+
+    /** Wraps one zone of a mapped bank (nothing decoded or copied), or decompresses a FLAC zone into RAM.
+        The zone's loop points come from the bank index. */
+    static Ptr fromBank(SampleBank::Ptr bank, int zoneIndex, double maxSampleLengthSeconds, float trimThreshold = 0.0f);
+
+    /** A resident copy of fully resident or mapped source at targetRate, through the voices' 16-tap sinc, in the
+        source's encoding. Trim, fade and loop points are scaled to match. nullptr if source is already at
+        targetRate or is a streaming head. */
+    static Ptr resample(const SampleData& source, double targetRate);
+
+    /** Resident frames (decoded head/whole sample, or the mapped data chunk). Out-of-range frames read as silence. */
+    const SamplePcm& getPcm() const noexcept { return pcm; }
+    int getResidentLength() const noexcept { return pcm.numFrames; }
+
+    /** Full playable length in frames (for a streaming head, includes the part left on disk). */
+    int getLength() const noexcept { return length; }
+    double getSourceSampleRate() const noexcept { return sourceSampleRate; }
+
+    /** Source frames cut from the front by trimming (the file position of frame 0). */
+    int getStartOffset() const noexcept { return startOffset; }
+
+    /** First frame above the trim threshold, in playable frames (0 when not trimmed). */
+    int getOnsetFrame() const noexcept { return onsetFrame; }
+
+    /** Where trimming found audio, in source frames (both -1 when not trimmed), for the scan index to keep. */
+    AudibleRange getAudibleRange() const noexcept { return audible; }
+
+    /** The voice fades the last this-many frames of getLength() to silence (0 = no fade). */
+    int getFadeOutFrames() const noexcept { return fadeOutFrames; }
+
+    /** Sustain loop in playable frames (invalid when the sample plays straight through). */
+    const Loop& getLoop() const noexcept { return loop; }
+    bool hasLoop() const noexcept { return loop.isValid(); }
+
+    /** Frames before the loop end that are crossfaded with the frames before the loop start. */
+    int getLoopCrossfadeFrames() const noexcept;
+
+    /** Linear gain to play at (from the bank index; 1 for plain files). */
+    float getGain() const noexcept { return gain; }
+
+    /** True when getPcm() views a mapping (file or bank), whose pages may still be on disk. */
+    bool isMapped() const noexcept { return mappedFile != nullptr || bank != nullptr; }
+
+    /** Mapped data: faults in these frames (call off the audio thread, see PageWarmer). */
+    void warm(int startFrame, int numFrames) const noexcept;
+
+    /** Heap bytes held by this object (mapped pages are not counted). */
+    size_t getMemoryUsage() const noexcept;
+
+private:
+    SampleData() = default;
+
+    static SamplePcm::Encoding encodingFor(const juce::AudioFormatReader& source) noexcept;
+
+    /** Adopts a loop that fits the resident PCM and drops everything after its end (never played). */
+    void setLoop(Loop newLoop);
+
+    /** Cuts leading silence and, if wholeSample, the tail below threshold (see class comment). */
+    void trimSilence(float threshold, bool wholeSample, AudibleRange known);
+
+    juce::HeapBlock<char> storage;
+    SamplePcm pcm;
+    double sourceSampleRate = 0.0;
+    int length = 0;
+    int startOffset = 0;
+    int onsetFrame = 0;
+    AudibleRange audible;
+    int fadeOutFrames = 0;
+    Loop loop;
+    float gain = 1.0f;
+    MappedSampleFile::Ptr mappedFile;
+    SampleBank::Ptr bank;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleData)
+};
@@ -0,0 +1,235 @@
+#include "SampleIndex.h"
+#include "SampleNaming.h"
+#include "SampleLoops.h"
+#include <algorithm>
+#include <map>
+
+namespace
+{
+    constexpr int kIndexVersion = 4;
+}
+
+SampleIndex::SampleIndex(const juce::File& cacheFileToUse)
+    : cacheFile(cacheFileToUse)
+{
+}
+
+juce::File SampleIndex::getDefaultCacheFile(const juce::File& samplesDir)
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("MatildaPiano")
+        .getChildFile("ScanIndex")
+        .getChildFile(juce::String::toHexString(samplesDir.getFullPathName().hashCode64()) + ".xml");
+}
+
+void SampleIndex::load(const juce::File& samplesDir, bool useKeySamplesNaming)
+{
+    entries.clear();
+    directories.clear();
+
+    auto xml = juce::parseXML(cacheFile);
+    if (xml == nullptr || !xml->hasTagName("SampleIndex")
+        || xml->getIntAttribute("version") != kIndexVersion
+        || xml->getStringAttribute("dir") != samplesDir.getFullPathName()
+        || xml->getBoolAttribute("keySamplesNaming") != useKeySamplesNaming)
+        return;
+
+    for (auto* d : xml->getChildWithTagNameIterator("Dir"))
+        directories.push_back({ d->getStringAttribute("path"), d->getStringAttribute("mtime").getLargeIntValue() });
+
+    for (auto* f : xml->getChildWithTagNameIterator("File"))
+    {
+        Entry e;
+        e.file = samplesDir.getChildFile(f->getStringAttribute("path"));
+        e.size = f->getStringAttribute("size").getLargeIntValue();
+        e.modificationTime = f->getStringAttribute("mtime").getLargeIntValue();
+        e.midiNote = f->getIntAttribute("note", -1);
+        e.velocityLayer = f->getIntAttribute("layer");
+        e.roundRobin = f->getIntAttribute("rr");
+        e.valid = f->getBoolAttribute("valid");
+        e.sampleRate = f->getDoubleAttribute("rate");
+        e.numChannels = f->getIntAttribute("channels");
+        e.bitsPerSample = f->getIntAttribute("bits");
+        e.lengthInSamples = f->getStringAttribute("length").getLargeIntValue();
+        e.loop = { f->getIntAttribute("loopStart", -1), f->getIntAttribute("loopEnd", -1) };
+        e.analysed = f->hasAttribute("trimThreshold");
+        if (e.analysed)
+        {
+            e.analysis.trimThreshold = static_cast<float>(f->getDoubleAttribute("trimThreshold"));
+            e.analysis.audible = { f->getIntAttribute("audibleFirst", -1), f->getIntAttribute("audibleLast", -1) };
+        }
+        entries.push_back(e);
+    }
+}
+
+void SampleIndex::scan(const juce::File& samplesDir, bool useKeySamplesNaming, juce::AudioFormatManager& formats)
+{
+    const juce::ScopedLock sl(lock);
+    rootDir = samplesDir;
+    keySamplesNaming = useKeySamplesNaming;
+    numProbed = 0;
+    dirty = false;
+    load(samplesDir, useKeySamplesNaming);
+
+    // Adding, removing or renaming a file touches its directory's mtime, so unchanged directories mean
+    // an unchanged listing. Edits to a file's contents are caught per file below.
+    listingFromCache = !directories.empty();
+    for (const auto& d : directories)
+    {
+        const auto dir = d.relativePath.isEmpty() ? samplesDir : samplesDir.getChildFile(d.relativePath);
+        if (!dir.isDirectory() || dir.getLastModificationTime().toMilliseconds() != d.modificationTime)
+        {
+            listingFromCache = false;
+            break;
+        }
+    }
+
+    juce::Array<juce::File> files;
+    if (listingFromCache)
+    {
+        for (const auto& e : entries)
+            files.add(e.file);
+    }
+    else
+    {
+        samplesDir.findChildFiles(files, juce::File::findFiles, true, audioFileWildcard);
+
+        juce::Array<juce::File> subdirs;
+        samplesDir.findChildFiles(subdirs, juce::File::findDirectories, true);
+        directories.clear();
+        directories.push_back({ {}, samplesDir.getLastModificationTime().toMilliseconds() });
+        for (const auto& d : subdirs)
+            directories.push_back({ d.getRelativePathFrom(samplesDir), d.getLastModificationTime().toMilliseconds() });
+        dirty = true;
+    }
+    files.sort();
+
+    std::map<juce::String, Entry> cached;
+    for (auto& e : entries)
+        cached[e.file.getFullPathName()] = std::move(e);
+
+    entries.clear();
+    entries.reserve(static_cast<size_t>(files.size()));
+    for (const auto& f : files)
+    {
+        const auto size = f.getSize();
+        const auto modificationTime = f.getLastModificationTime().toMilliseconds();
+
+        auto it = cached.find(f.getFullPathName());
+        if (it != cached.end() && it->second.size == size && it->second.modificationTime == modificationTime)
+        {
+            entries.push_back(std::move(it->second));
+            continue;
+        }
+
+        // New or changed file: resolve its note and read its header.
+        Entry e;
+        e.file = f;
+        e.size = size;
+        e.modificationTime = modificationTime;
+        e.midiNote = SampleNaming::midiNoteForFile(f, useKeySamplesNaming);
+        const auto layering = SampleNaming::layeringForFile(f);
+        e.velocityLayer = layering.velocityLayer;
+        e.roundRobin = layering.roundRobin;
+        if (std::unique_ptr<juce::AudioFormatReader> reader { formats.createReaderFor(f) })
+        {
+            e.valid = true;
+            e.sampleRate = reader->sampleRate;
+            e.numChannels = static_cast<int>(reader->numChannels);
+            e.bitsPerSample = static_cast<int>(reader->bitsPerSample);
+            e.lengthInSamples = reader->lengthInSamples;
+            e.loop = SampleLoops::fromMetadata(reader->metadataValues);
+        }
+        entries.push_back(e);
+        ++numProbed;
+        dirty = true;
+    }
+
+    if (entries.size() != cached.size())
+        dirty = true; // files went away
+}
+
+int SampleIndex::findEntry(const juce::File& file) const noexcept
+{
+    for (size_t i = 0; i < entries.size(); ++i)
+        if (entries[i].file == file)
+            return static_cast<int>(i);
+    return -1;
+}
+
+void SampleIndex::setAnalysis(const juce::File& file, const Analysis& analysis)
+{
+    const juce::ScopedLock sl(lock);
+    const int i = findEntry(file);
+    if (i < 0)
+        return;
+    auto& e = entries[static_cast<size_t>(i)];
+    e.analysis = analysis;
+    e.analysed = true;
+    dirty = true;
+}
+
+SampleData::AudibleRange SampleIndex::getAudibleRange(const juce::File& file, float trimThreshold) const
+{
+    const juce::ScopedLock sl(lock);
+    const int i = findEntry(file);
+    if (i < 0)
+        return {};
+    const auto& e = entries[static_cast<size_t>(i)];
+    // The threshold went through the XML as text, so allow for its last bit.
+    const bool sameThreshold = std::abs(e.analysis.trimThreshold - trimThreshold) <= 1.0e-6f * trimThreshold;
+    return e.analysed && sameThreshold ? e.analysis.audible : SampleData::AudibleRange {};
+}
+
+bool SampleIndex::save()
+{
+    const juce::ScopedLock sl(lock);
+    if (!dirty)
+        return true;
+
+    juce::XmlElement xml("SampleIndex");
+    xml.setAttribute("version", kIndexVersion);
+    xml.setAttribute("dir", rootDir.getFullPathName());
+    xml.setAttribute("keySamplesNaming", keySamplesNaming);
+
+    for (const auto& d : directories)
+    {
+        auto* child = xml.createNewChildElement("Dir");
+        child->setAttribute("path", d.relativePath);
+        child->setAttribute("mtime", juce::String(d.modificationTime));
+    }
+
+    for (const auto& e : entries)
+    {
+        auto* child = xml.createNewChildElement("File");
+        child->setAttribute("path", e.file.getRelativePathFrom(rootDir));
+        child->setAttribute("size", juce::String(e.size));
+        child->setAttribute("mtime", juce::String(e.modificationTime));
+        child->setAttribute("note", e.midiNote);
+        if (e.velocityLayer != 0)
+            child->setAttribute("layer", e.velocityLayer);
+        if (e.roundRobin != 0)
+            child->setAttribute("rr", e.roundRobin);
+        child->setAttribute("valid", e.valid);
+        child->setAttribute("rate", e.sampleRate);
+        child->setAttribute("channels", e.numChannels);
+        child->setAttribute("bits", e.bitsPerSample);
+        child->setAttribute("length", juce::String(e.lengthInSamples));
+        if (e.loop.isValid())
+        {
+            child->setAttribute("loopStart", e.loop.start);
+            child->setAttribute("loopEnd", e.loop.end);
+        }
+        if (e.analysed)
+        {
+            child->setAttribute("trimThreshold", e.analysis.trimThreshold);
+            child->setAttribute("audibleFirst", e.analysis.audible.first);
+            child->setAttribute("audibleLast", e.analysis.audible.last);
+        }
+    }
+
+    if (!cacheFile.getParentDirectory().createDirectory().wasOk() || !xml.writeTo(cacheFile))
+        return false;
+    dirty = false;
+    return true;
+}
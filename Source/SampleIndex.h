@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <JuceHeader.h>
+#include "SampleData.h"
+
+/** On-disk cache of a sample folder scan: which files exist, the note each one
+ *  maps to, its format and embedded loop points, and (once a load has trimmed
+ *  it) where its audio starts and ends at the trim threshold in use, so later
+ *  loads trim it without scanning its silence again.
+ *
+ *  If no directory in the library has a new modification time, the recursive
+ *  listing is skipped. A file whose size and modification time are unchanged
+ *  is not parsed or probed again. Only new or changed files cost a reader.
+ *  The cache is one XML file per library under the user's application data
+ *  folder.
+ */
+class SampleIndex
+{
+public:
+    static constexpr const char* audioFileWildcard = "*.wav;*.wave;*.aif;*.aiff;*.flac";
+
+    /** The trim a load found for a file, and the threshold (linear) it was found at. */
+    struct Analysis
+    {
+        float trimThreshold = 0.0f;
+        SampleData::AudibleRange audible;
+    };
+
+    struct Entry
+    {
+        juce::File file;
+        juce::int64 size = 0;
+        juce::int64 modificationTime = 0;
+        int midiNote = -1;
+        int velocityLayer = 0; // SampleNaming::Layering
+        int roundRobin = 0;
+
+        // Format, from probing the file with a reader; valid == false if no reader could open it.
+        bool valid = false;
+        double sampleRate = 0.0;
+        int numChannels = 0;
+        int bitsPerSample = 0;
+        juce::int64 lengthInSamples = 0;
+        SampleData::Loop loop; // embedded smpl/INST sustain loop (a sidecar is checked at load)
+
+        bool analysed = false;
+        Analysis analysis;
+    };
+
+    explicit SampleIndex(const juce::File& cacheFile);
+
+    /** Where the index for a library lives: one file per folder path. */
+    static juce::File getDefaultCacheFile(const juce::File& samplesDir);
+
+    /** Loads the cache and brings it up to date with samplesDir; new or changed files are probed with formats. */
+    void scan(const juce::File& samplesDir, bool useKeySamplesNaming, juce::AudioFormatManager& formats);
+
+    /** Entries from the last scan(), in a stable (path) order. */
+    const std::vector<Entry>& getEntries() const noexcept { return entries; }
+
+    /** Files that had to be probed in the last scan() (0 for an unchanged library). */
+    int getNumProbed() const noexcept { return numProbed; }
+
+    /** True if the last scan() reused the cached listing instead of walking the folder. */
+    bool usedCachedListing() const noexcept { return listingFromCache; }
+
+    /** Stores the trim a load found for a file (thread-safe; ignored for files not in the index). */
+    void setAnalysis(const juce::File& file, const Analysis& analysis);
+
+    /** The cached range for file at trimThreshold; unknown (-1) if it was found at another threshold, or never. */
+    SampleData::AudibleRange getAudibleRange(const juce::File& file, float trimThreshold) const;
+
+    /** Writes the cache if anything changed since it was loaded. */
+    bool save();
+
+private:
+    struct Directory
+    {
+        juce::String relativePath;
+        juce::int64 modificationTime = 0;
+    };
+
+    void load(const juce::File& samplesDir, bool useKeySamplesNaming);
+    int findEntry(const juce::File& file) const noexcept;
+
+    juce::File cacheFile;
+    juce::File rootDir;
+    bool keySamplesNaming = false;
+
+    std::vector<Entry> entries;
+    std::vector<Directory> directories;
+    int numProbed = 0;
+    bool listingFromCache = false;
+
+    juce::CriticalSection lock; // guards the analysis fields and dirty once scan() has returned
+    bool dirty = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleIndex)
+};
@@ -0,0 +1,551 @@
+#include "SampleLoader.h"
+#include "SampleLoops.h"
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+namespace
+{
+    // Notes closest to this are decoded first, so the most-played register is playable soonest.
+    constexpr int kPriorityCentreNote = 60;
+}
+
+SampleLoader::SampleLoader(SoundSetPublisher& soundSetsToFill, SampleStreamer& streamerForLongSamples)
+    : juce::Thread("Matilda sample loader"),
+      soundSets(soundSetsToFill),
+      streamer(streamerForLongSamples)
+{
+    formatManager.registerBasicFormats();
+}
+
+SampleLoader::~SampleLoader()
+{
+    stopLoading();
+    stopTimer();
+}
+
+void SampleLoader::startLoading(const Options& newOptions)
+{
+    stopLoading();
+    options = newOptions;
+
+    // A reload keeps the current sounds playable (and their notes marked loaded) until the swap.
+    const auto published = soundSets.getPublished();
+    publishIncrementally = published == nullptr || published->isEmpty();
+    SamplePool::getInstance()->purgeUnused();
+    for (int note = 0; note < 128; ++note)
+    {
+        if (publishIncrementally)
+        {
+            loaded[static_cast<size_t>(note)].store(false);
+            ownSampleLoaded[static_cast<size_t>(note)].store(false);
+        }
+        requested[static_cast<size_t>(note)].store(false);
+    }
+    numProcessed.store(0);
+    numFiles.store(0);
+    loading.store(true);
+    setStatus("Loading samples...");
+
+    startThread();
+}
+
+void SampleLoader::stopLoading()
+{
+    // Decoding one file takes well under a second; run() checks threadShouldExit() between files and
+    // then waits for the few decode jobs still in flight.
+    stopThread(4000);
+    loading.store(false);
+}
+
+void SampleLoader::requestNote(int midiNote) noexcept
+{
+    if (juce::isPositiveAndBelow(midiNote, 128))
+        requested[static_cast<size_t>(midiNote)].store(true, std::memory_order_relaxed);
+}
+
+bool SampleLoader::isNoteLoaded(int midiNote) const noexcept
+{
+    return juce::isPositiveAndBelow(midiNote, 128)
+        && loaded[static_cast<size_t>(midiNote)].load(std::memory_order_acquire);
+}
+
+bool SampleLoader::isOwnSampleLoaded(int midiNote) const noexcept
+{
+    return juce::isPositiveAndBelow(midiNote, 128)
+        && ownSampleLoaded[static_cast<size_t>(midiNote)].load(std::memory_order_acquire);
+}
+
+float SampleLoader::getProgress() const noexcept
+{
+    const int total = numFiles.load();
+    if (!loading.load() || total <= 0)
+        return loading.load() ? 0.0f : 1.0f;
+    return juce::jlimit(0.0f, 1.0f, static_cast<float>(numProcessed.load()) / static_cast<float>(total));
+}
+
+juce::String SampleLoader::getStatus() const
+{
+    const juce::ScopedLock sl(statusLock);
+    return status;
+}
+
+int SampleLoader::midiNoteForFile(const juce::File& file, bool useKeySamplesNaming)
+{
+    return SampleNaming::midiNoteForFile(file, useKeySamplesNaming);
+}
+
+int SampleLoader::getNumDecodeThreads()
+{
+    // Leave one core for the audio thread; decoding is CPU-bound, so hyperthreads add little.
+    return juce::jmax(1, juce::SystemStats::getNumPhysicalCpus() - 1);
+}
+
+juce::String SampleLoader::getTrimVariant() const
+{
+    // Part of every pool key: instances trimming differently must not share data.
+    return options.trimSilence ? "|trim:" + juce::String(options.trimThresholdDb, 1) : juce::String();
+}
+
+bool SampleLoader::isConvertingToTargetRate() const noexcept
+{
+    // Streaming heads and mapped files stay at their own rate: converting them would mean holding them in RAM.
+    return options.targetSampleRate > 0.0 && !options.memoryMapped && options.streamingPreloadSeconds <= 0.0;
+}
+
+juce::int64 SampleLoader::getSourceSignature(const std::vector<PendingFile>& pending) const
+{
+    // Everything the converted audio depends on: each source's identity and mapping, and how it was cut.
+    juce::MemoryOutputStream key;
+    key << "1" << getTrimVariant() << juce::String(maxSampleLengthSeconds);
+    for (const auto& p : pending)
+        key << "|" << p.file.getFullPathName() << ":" << p.size << ":" << p.modificationTime << ":" << p.bankZone
+            << ":" << p.midiNote << ":" << p.notes.toString(16) << ":" << p.loop.start << "-" << p.loop.end
+            << ":" << p.velocityLayer << ":" << p.roundRobin;
+    return key.toString().hashCode64();
+}
+
+juce::File SampleLoader::getResampleCacheDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("MatildaPiano")
+        .getChildFile("Resampled");
+}
+
+juce::String SampleLoader::getResampleCachePrefix(const juce::File& samplesDir, double sampleRate)
+{
+    // One cache per library and rate; the suffix (source signature) changes whenever the library does.
+    return juce::String::toHexString(samplesDir.getFullPathName().hashCode64()) + "-" + juce::String(juce::roundToInt(sampleRate)) + "-";
+}
+
+void SampleLoader::addBankZones(const SampleBank::Ptr& bankToAdd, std::vector<PendingFile>& pending)
+{
+    const auto size = bankToAdd->getFile().getSize();
+    const auto modificationTime = bankToAdd->getFile().getLastModificationTime().toMilliseconds();
+    for (int i = 0; i < bankToAdd->getNumZones(); ++i)
+    {
+        const auto& zone = bankToAdd->getZone(i);
+        PendingFile p { bankToAdd->getFile(), zone.rootNote, {}, i, {}, zone.velocityLayer, zone.roundRobin,
+                        size, modificationTime };
+        p.notes.setRange(zone.lowNote, zone.highNote - zone.lowNote + 1, true);
+        pending.push_back(p);
+    }
+}
+
+juce::File SampleLoader::findSamplesDirectory(bool& useKeySamplesNaming)
+{
+    // Search order:
+    // 1) keySamples — bundled (Contents/Resources/keySamples) or next to the .app
+    //    Naming: note + octave 0–7, e.g. c0.wav, c#5.wav (c0 = C1 = MIDI 24; c7 = C8 = MIDI 108). PRD: 7 octaves.
+    // 2) ~/Music/MatildaPiano/Samples
+    // 3) ~/Documents/MatildaPiano/Samples
+    //    Naming: note name (e.g. Piano_C4.wav) or MIDI number (e.g. Piano_60.wav)
+    juce::File samplesDir;
+    useKeySamplesNaming = false;
+
+    auto appFile = juce::File::getSpecialLocation(juce::File::currentApplicationFile);
+    juce::File keySamplesInBundle = appFile.getChildFile("Contents/Resources/keySamples");
+    juce::File keySamplesNextToApp = appFile.getParentDirectory().getChildFile("keySamples");
+    if (keySamplesInBundle.isDirectory())
+        samplesDir = keySamplesInBundle;
+    else if (keySamplesNextToApp.isDirectory())
+        samplesDir = keySamplesNextToApp;
+    if (samplesDir.exists())
+        useKeySamplesNaming = true;
+
+    if (!samplesDir.isDirectory())
+    {
+        samplesDir = juce::File::getSpecialLocation(juce::File::userMusicDirectory)
+                         .getChildFile("MatildaPiano")
+                         .getChildFile("Samples");
+        if (!samplesDir.isDirectory())
+        {
+            samplesDir = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                             .getChildFile("MatildaPiano")
+                             .getChildFile("Samples");
+        }
+    }
+
+    return samplesDir;
+}
+
+void SampleLoader::run()
+{
+    bool useKeySamplesNaming = options.keySamplesNaming;
+    const auto samplesDir = options.samplesDirectory != juce::File() ? options.samplesDirectory
+                                                                     : findSamplesDirectory(useKeySamplesNaming);
+
+    if (!samplesDir.isDirectory())
+    {
+        publish(nullptr);
+        setStatus("No samples found — add keySamples folder or WAV/AIFF/FLAC to ~/Music/MatildaPiano/Samples or ~/Documents/MatildaPiano/Samples");
+        loading.store(false);
+        reclaimReplacedSounds();
+        return;
+    }
+
+    // Middle register first; files whose note can't be parsed map to every key, so load them last
+    // (they would otherwise shadow the real samples while loading).
+    std::vector<PendingFile> pending;
+    bank = SampleBank::open(samplesDir.getChildFile(SampleBank::defaultFileName));
+    if (bank != nullptr)
+    {
+        addBankZones(bank, pending);
+    }
+    else
+    {
+        // Unchanged libraries come straight from the scan index: no directory walk, no name parsing, no probing.
+        index = std::make_unique<SampleIndex>(SampleIndex::getDefaultCacheFile(samplesDir));
+        index->scan(samplesDir, useKeySamplesNaming, formatManager);
+        for (const auto& entry : index->getEntries())
+        {
+            if (!entry.valid)
+                continue;
+            PendingFile p { entry.file, entry.midiNote, {}, -1, SampleLoops::find(entry.file, entry.loop),
+                            entry.velocityLayer, entry.roundRobin, entry.size, entry.modificationTime };
+            if (p.midiNote != -1)
+                p.notes.setBit(p.midiNote);
+            else
+                p.notes.setRange(0, 128, true); // fallback
+            pending.push_back(p);
+        }
+
+        if (pending.empty())
+        {
+            index->save();
+            index.reset();
+            publish(nullptr);
+            setStatus("No samples found — add WAV/AIFF/FLAC to " + samplesDir.getFullPathName());
+            loading.store(false);
+            reclaimReplacedSounds();
+            return;
+        }
+    }
+
+    // Pre-resampling: if these sources were already converted to the target rate, map that bank instead.
+    juce::File resampleCache;
+    if (isConvertingToTargetRate())
+    {
+        resampleCache = getResampleCacheDirectory().getChildFile(getResampleCachePrefix(samplesDir, options.targetSampleRate)
+                                                                 + juce::String::toHexString(getSourceSignature(pending)) + ".mbank");
+        if (auto cached = SampleBank::open(resampleCache))
+        {
+            bank = cached;
+            pending.clear();
+            addBankZones(bank, pending);
+            resampleCache = juce::File(); // nothing to write back
+        }
+    }
+    std::vector<juce::SynthesiserSound::Ptr> convertedSounds;
+    convertedAny.store(false);
+
+    auto distanceFromCentre = [](const PendingFile& p)
+    {
+        return p.midiNote == -1 ? 1000 : std::abs(p.midiNote - kPriorityCentreNote);
+    };
+    std::stable_sort(pending.begin(), pending.end(), [&](const PendingFile& a, const PendingFile& b)
+    {
+        return distanceFromCentre(a) < distanceFromCentre(b);
+    });
+
+    numFiles.store(static_cast<int>(pending.size()));
+    updateProgressStatus();
+
+    // Decode on the worker pool, a few files ahead per worker, and publish strictly in dispatch order
+    // (priority order, requested notes first) so the synth's sound list is the same on every load.
+    SoundSet::Ptr replacement = publishIncrementally ? nullptr : new SoundSet();
+    std::deque<std::shared_ptr<DecodeJob>> inFlight;
+    const auto maxInFlight = static_cast<size_t>(options.decodeThreads > 0 ? juce::jmin(options.decodeThreads, decodePool.getNumThreads())
+                                                                          : decodePool.getNumThreads() * 2);
+    while ((!pending.empty() || !inFlight.empty()) && !threadShouldExit())
+    {
+        while (!pending.empty() && inFlight.size() < maxInFlight)
+        {
+            const auto index = pickNextFile(pending);
+            auto job = std::make_shared<DecodeJob>();
+            job->file = pending[index];
+            pending.erase(pending.begin() + static_cast<std::ptrdiff_t>(index));
+
+            decodePool.addJob([this, job]
+            {
+                job->sound = job->file.bankZone >= 0 ? createBankSound(job->file) : createSound(job->file);
+                job->done.store(true, std::memory_order_release);
+                notify();
+            });
+            inFlight.push_back(std::move(job));
+        }
+
+        const auto& next = inFlight.front();
+        if (!next->done.load(std::memory_order_acquire))
+        {
+            wait(5); // woken by notify() when any job finishes
+            continue;
+        }
+
+        if (next->sound != nullptr && resampleCache != juce::File())
+            convertedSounds.push_back(next->sound);
+
+        if (next->sound != nullptr && replacement != nullptr)
+        {
+            replacement->add(next->sound);
+        }
+        else if (next->sound != nullptr)
+        {
+            // Each sound is its own generation: a copy of the current set plus this one.
+            publish(new SoundSet(soundSets.getPublished().get(), next->sound));
+        }
+        inFlight.pop_front();
+
+        ++numProcessed;
+        updateProgressStatus();
+    }
+
+    // Jobs reference this loader (and the bank): let any still running finish before we return.
+    decodePool.removeAllJobs(false, -1);
+
+    bank = nullptr;
+    if (index != nullptr)
+    {
+        index->save();
+        index.reset();
+    }
+    if (!threadShouldExit())
+    {
+        if (replacement != nullptr)
+            publish(replacement);
+        if (resampleCache != juce::File() && convertedAny.load())
+            writeResampleCache(resampleCache, convertedSounds);
+        setStatus({});
+    }
+    loading.store(false);
+    reclaimReplacedSounds();
+}
+
+void SampleLoader::publish(SoundSet::Ptr set)
+{
+    soundSets.publish(set);
+    for (int note = 0; note < 128; ++note)
+    {
+        // A neighbour covering the key makes it playable; only its own sample settles a request for it.
+        const bool own = set != nullptr && set->hasOwnSample(note);
+        loaded[static_cast<size_t>(note)].store(set != nullptr && set->coversNote(note), std::memory_order_release);
+        ownSampleLoaded[static_cast<size_t>(note)].store(own, std::memory_order_release);
+        if (own)
+            requested[static_cast<size_t>(note)].store(false, std::memory_order_relaxed);
+    }
+}
+
+void SampleLoader::reclaimReplacedSounds()
+{
+    // Replaced sets go once the audio thread has moved past them, their sounds once the last voice playing
+    // them has finished; then the pool can let go of their data. Whatever is still playing is left to the
+    // message thread's timer rather than polled for here.
+    soundSets.collectGarbage();
+    if (soundSets.getNumRetired() > 0)
+        startTimer(reclaimIntervalMs);
+    else if (!threadShouldExit())
+        SamplePool::getInstance()->purgeUnused();
+}
+
+void SampleLoader::timerCallback()
+{
+    soundSets.collectGarbage();
+    if (soundSets.getNumRetired() > 0)
+        return;
+    stopTimer();
+    SamplePool::getInstance()->purgeUnused();
+}
+
+juce::SynthesiserSound::Ptr SampleLoader::createBankSound(const PendingFile& pending)
+{
+    const auto& zone = bank->getZone(pending.bankZone);
+    auto data = SamplePool::getInstance()->getOrCreate(pending.file, "zone:" + juce::String(pending.bankZone) + getTrimVariant(), [&]
+    {
+        return SampleData::fromBank(bank, pending.bankZone, maxSampleLengthSeconds, options.getTrimThreshold());
+    });
+    if (data == nullptr || data->getLength() == 0)
+        return nullptr;
+
+    // The zone is contiguous in the bank: fault it in with one sequential read (just the onset when the
+    // user asked for mapped/streaming mode to keep RAM down).
+    const bool keepResident = !options.memoryMapped && options.streamingPreloadSeconds <= 0.0;
+    data->warm(0, keepResident ? data->getLength()
+                               : static_cast<int>(data->getSourceSampleRate() * mappedWarmHeadSeconds));
+    if (keepResident)
+        data = toTargetRate(pending.file, "zone:" + juce::String(pending.bankZone) + getTrimVariant(), data);
+    return new MatildaSamplerSound(zone.name, data, pending.notes, zone.rootNote, -1,
+                                   pending.velocityLayer, pending.roundRobin);
+}
+
+juce::SynthesiserSound::Ptr SampleLoader::createSound(const PendingFile& pending)
+{
+    const auto& notes = pending.notes;
+    const auto name = pending.file.getFileNameWithoutExtension();
+    const int rootNote = pending.midiNote != -1 ? pending.midiNote : 60;
+    auto& pool = *SamplePool::getInstance();
+    const auto& loop = pending.loop;
+    const auto loopVariant = loop.isValid() ? "|loop:" + juce::String(loop.start) + "-" + juce::String(loop.end)
+                                            : juce::String();
+
+    // Where trimming found this file's audio last time, so it isn't scanned for again.
+    const float trimThreshold = options.getTrimThreshold();
+    const auto known = index != nullptr && trimThreshold > 0.0f ? index->getAudibleRange(pending.file, trimThreshold)
+                                                               : SampleData::AudibleRange {};
+
+    // Memory-mapped: nothing to decode; pre-fault the onset so the first note-on doesn't hit cold pages.
+    if (options.memoryMapped)
+    {
+        auto data = pool.getOrCreate(pending.file, "mapped" + loopVariant + getTrimVariant(), [&]() -> SampleData::Ptr
+        {
+            auto mapped = MappedSampleFile::open(pending.file);
+            if (mapped == nullptr)
+                return nullptr;
+            mapped->warm(0, static_cast<int>(mapped->getSampleRate() * mappedWarmHeadSeconds));
+            return SampleData::fromMappedFile(mapped, maxSampleLengthSeconds, trimThreshold, loop, known);
+        });
+
+        if (data != nullptr)
+        {
+            rememberAudibleRange(pending.file, *data, known);
+            return new MatildaSamplerSound(name, data, notes, rootNote, -1, pending.velocityLayer, pending.roundRobin);
+        }
+        // Not a plain PCM WAV (AIFF, 8-bit, …): fall through and decode into RAM.
+    }
+
+    // Another instance may already have decoded this file the same way; then this costs nothing.
+    // A looped sample wraps back into frames a stream has already gone past, so it is never streamed.
+    const bool streaming = options.streamingPreloadSeconds > 0.0 && !loop.isValid();
+    const auto variant = (streaming ? "head:" + juce::String(options.streamingPreloadSeconds, 3) : juce::String("full"))
+                         + loopVariant + getTrimVariant();
+    auto data = pool.getOrCreate(pending.file, variant, [&]() -> SampleData::Ptr
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader { formatManager.createReaderFor(pending.file) };
+        if (reader == nullptr)
+            return nullptr;
+        return SampleData::decode(*reader, maxSampleLengthSeconds, streaming ? options.streamingPreloadSeconds : 0.0,
+                                  trimThreshold, loop, known);
+    });
+
+    if (data == nullptr || data->getLength() == 0)
+        return nullptr;
+
+    rememberAudibleRange(pending.file, *data, known);
+
+    if (!streaming)
+        data = toTargetRate(pending.file, variant, data);
+
+    // Streaming: only the head stays resident; the voice pulls the rest through the streamer.
+    const int streamSourceId = streaming ? streamer.registerSource(pending.file, data->getStartOffset() + data->getLength()) : -1;
+    return new MatildaSamplerSound(name, data, notes, rootNote, streamSourceId, pending.velocityLayer, pending.roundRobin);
+}
+
+void SampleLoader::rememberAudibleRange(const juce::File& file, const SampleData& data, SampleData::AudibleRange known)
+{
+    // A streaming head or a looped sample only finds the start; keep a tail an earlier whole load found.
+    auto found = data.getAudibleRange();
+    if (index == nullptr || found.first < 0)
+        return;
+    if (found.last < 0 && found.first == known.first)
+        found.last = known.last;
+    if (found.first != known.first || found.last != known.last)
+        index->setAnalysis(file, { options.getTrimThreshold(), found });
+}
+
+SampleData::Ptr SampleLoader::toTargetRate(const juce::File& file, const juce::String& variant, SampleData::Ptr data)
+{
+    if (!isConvertingToTargetRate() || data->getSourceSampleRate() == options.targetSampleRate)
+        return data;
+
+    // Pooled like the source, so other instances at this rate share the converted copy.
+    auto converted = SamplePool::getInstance()->getOrCreate(file, variant + "|rate:" + juce::String(options.targetSampleRate), [&]
+    {
+        return SampleData::resample(*data, options.targetSampleRate);
+    });
+    if (converted == nullptr)
+        return data;
+    convertedAny.store(true);
+    return converted;
+}
+
+void SampleLoader::writeResampleCache(const juce::File& cacheFile, const std::vector<juce::SynthesiserSound::Ptr>& sounds) const
+{
+    juce::Array<SampleBank::Zone> zones;
+    for (const auto& s : sounds)
+    {
+        const auto& sound = *static_cast<MatildaSamplerSound*>(s.get());
+        const auto& data = sound.getData();
+        if (data.getSourceSampleRate() != options.targetSampleRate || data.getResidentLength() < data.getLength())
+            return; // a sound that couldn't be converted: better no cache than a partial one
+
+        SampleBank::Zone zone;
+        zone.name = sound.getName();
+        zone.rootNote = sound.getMidiRootNote();
+        zone.lowNote = sound.getMidiNotes().findNextSetBit(0);
+        zone.highNote = sound.getMidiNotes().getHighestBit();
+        zone.velocityLayer = sound.getVelocityLayer();
+        zone.roundRobin = sound.getRoundRobin();
+        zone.sampleRate = data.getSourceSampleRate();
+        zone.loopStart = data.getLoop().start;
+        zone.loopEnd = data.getLoop().end;
+        zone.gain = data.getGain();
+        zone.pcm = data.getPcm();
+        zones.add(zone);
+    }
+
+    if (zones.isEmpty() || !cacheFile.getParentDirectory().createDirectory().wasOk())
+        return;
+
+    // Older conversions of this library at this rate are stale now.
+    const auto prefix = cacheFile.getFileName().upToLastOccurrenceOf("-", true, false);
+    for (const auto& old : cacheFile.getParentDirectory().findChildFiles(juce::File::findFiles, false, prefix + "*.mbank"))
+        if (old != cacheFile)
+            old.deleteFile();
+
+    SampleBank::write(cacheFile, zones);
+}
+
+size_t SampleLoader::pickNextFile(const std::vector<PendingFile>& pending) const noexcept
+{
+    // A note the audio thread is waiting on beats the static priority order.
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        const int note = pending[i].midiNote;
+        if (note != -1 && requested[static_cast<size_t>(note)].load(std::memory_order_relaxed))
+            return i;
+    }
+    return 0;
+}
+
+void SampleLoader::setStatus(const juce::String& newStatus)
+{
+    const juce::ScopedLock sl(statusLock);
+    status = newStatus;
+}
+
+void SampleLoader::updateProgressStatus()
+{
+    const int total = numFiles.load();
+    const int done = numProcessed.load();
+    setStatus("Loading samples... " + juce::String(juce::roundToInt(getProgress() * 100.0f)) + "% ("
+              + juce::String(done) + "/" + juce::String(total) + ")");
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <JuceHeader.h>
+#include "MatildaSamplerSound.h"
+#include "SampleStreamer.h"
+#include "SamplePool.h"
+#include "SampleBank.h"
+#include "SampleIndex.h"
+#include "SoundSetPublisher.h"
+
+/** Decodes the sample library on a background thread and publishes the
+ *  MatildaSamplerSounds to the synth through a SoundSetPublisher, so
+ *  constructing the processor (or recalling a session) never blocks the host.
+ *
+ *  With nothing playable yet, each sound is published as soon as it is ready.
+ *  A reload over a published set instead builds the whole new set first and
+ *  swaps it in at once: the old sounds keep playing until then, and voices
+ *  still ringing on them finish normally.
+ *
+ *  A prebuilt bank (SampleBank::defaultFileName in the samples folder) is used
+ *  in preference to the loose files: no scan, no decoding, one mapped file.
+ *  Loose files are listed through a persistent SampleIndex. Looped files are
+ *  always loaded whole (never streamed), since the voice jumps back in them.
+ *
+ *  With a target sample rate (pre-resampling), resident sounds are converted to
+ *  it once at load, so untransposed keys play at unity without interpolation.
+ *  The converted library is then written as a bank to a per-rate disk cache,
+ *  and the next load at that rate with the same sources maps it instead.
+ *
+ *  Decoded audio comes from the process-wide SamplePool, so a second plugin
+ *  instance reuses the first one's data instead of decoding again.
+ *
+ *  Files are decoded on a bounded worker pool (one thread per physical core,
+ *  less one) and published to the synth in dispatch order, so the result
+ *  doesn't depend on which worker finishes first.
+ *
+ *  Files are decoded middle register first; notes the audio thread asks for via
+ *  requestNote() jump the queue. Progress and status are safe to read from the
+ *  message thread; requestNote() / isNoteLoaded() are safe on the audio thread.
+ */
+class SampleLoader : private juce::Thread,
+                     private juce::Timer
+{
+public:
+    /** How sounds are built; read once per load. */
+    struct Options
+    {
+        /** > 0: streaming mode — keep only this much of each sample in RAM and stream the rest from disk. */
+        double streamingPreloadSeconds = 0.0;
+
+        /** Render straight from memory-mapped WAV files (takes precedence over streaming). */
+        bool memoryMapped = false;
+
+        /** Cut leading silence and tails below trimThresholdDb at load (see SampleData). */
+        bool trimSilence = true;
+        float trimThresholdDb = SampleData::defaultTrimThresholdDb;
+
+        /** > 0: pre-resampling — resident sounds are converted to this rate (not in streaming or mapped mode). */
+        double targetSampleRate = 0.0;
+
+        /** Library to load, named as keySamplesNaming says; empty = the usual places (see findSamplesDirectory()). */
+        juce::File samplesDirectory;
+        bool keySamplesNaming = false;
+
+        /** > 0: at most this many files decoding at once (1 = one at a time); 0 = a few per decode thread. */
+        int decodeThreads = 0;
+
+        /** Linear threshold to pass to SampleData, 0 when trimming is off. */
+        float getTrimThreshold() const noexcept
+        {
+            return trimSilence ? juce::Decibels::decibelsToGain(trimThresholdDb) : 0.0f;
+        }
+    };
+
+    /** Samples are loaded with SampleData::maxSampleLengthSeconds = 30; any extra is not played. */
+    static constexpr double maxSampleLengthSeconds = SampleData::maxSampleLengthSeconds;
+
+    /** Memory-mapped / streaming mode: how much of each file is faulted in at load so onsets are warm. */
+    static constexpr double mappedWarmHeadSeconds = 0.5;
+
+    SampleLoader(SoundSetPublisher& soundSetsToFill, SampleStreamer& streamerForLongSamples);
+    ~SampleLoader() override;
+
+    /** (Re)starts loading; the published sounds stay until the new set replaces them. Call from the message thread. */
+    void startLoading(const Options& newOptions);
+
+    /** Stops a load in progress. Sounds already published stay; a half-built replacement set is dropped. */
+    void stopLoading();
+
+    /** Marks a note as wanted so its sample is decoded next (lock-free). */
+    void requestNote(int midiNote) noexcept;
+
+    /** True once the published sounds play this note, with its own sample or a transposed neighbour (lock-free). */
+    bool isNoteLoaded(int midiNote) const noexcept;
+
+    /** True once the note's own sample is published; until then it may be playing a neighbour (lock-free). */
+    bool isOwnSampleLoaded(int midiNote) const noexcept;
+
+    bool isLoading() const noexcept { return loading.load(); }
+
+    /** Fraction of files processed in the current load, 0..1 (1 when idle). */
+    float getProgress() const noexcept;
+
+    /** Empty once loading finished; otherwise progress text or an error for the UI. */
+    juce::String getStatus() const;
+
+    /** MIDI note for a sample file, or -1 when the name can't be parsed (see docs/architecture.md). */
+    static int midiNoteForFile(const juce::File& file, bool useKeySamplesNaming);
+
+private:
+    struct PendingFile
+    {
+        juce::File file;
+        int midiNote = -1;
+        juce::BigInteger notes;
+        int bankZone = -1; // >= 0: zone of the bank, file is the bank
+        SampleData::Loop loop; // loose files: sidecar or embedded sustain loop, in file frames
+        int velocityLayer = 0;
+        int roundRobin = 0;
+        juce::int64 size = 0;             // of file, for the resample cache's signature
+        juce::int64 modificationTime = 0;
+    };
+
+    struct DecodeJob
+    {
+        PendingFile file;
+        juce::SynthesiserSound::Ptr sound;
+        std::atomic<bool> done { false };
+    };
+
+    static int getNumDecodeThreads();
+    juce::String getTrimVariant() const;
+    bool isConvertingToTargetRate() const noexcept;
+    juce::int64 getSourceSignature(const std::vector<PendingFile>& pending) const;
+    static juce::File getResampleCacheDirectory();
+    static juce::String getResampleCachePrefix(const juce::File& samplesDir, double sampleRate);
+    static void addBankZones(const SampleBank::Ptr& bankToAdd, std::vector<PendingFile>& pending);
+
+    void run() override;
+    juce::SynthesiserSound::Ptr createSound(const PendingFile& pending);
+    juce::SynthesiserSound::Ptr createBankSound(const PendingFile& pending);
+    SampleData::Ptr toTargetRate(const juce::File& file, const juce::String& variant, SampleData::Ptr data);
+    /** Stores where trimming found the file's audio in the scan index, if it differs from what was known. */
+    void rememberAudibleRange(const juce::File& file, const SampleData& data, SampleData::AudibleRange known);
+    void writeResampleCache(const juce::File& cacheFile, const std::vector<juce::SynthesiserSound::Ptr>& sounds) const;
+    size_t pickNextFile(const std::vector<PendingFile>& pending) const noexcept;
+    void publish(SoundSet::Ptr set);
+    void reclaimReplacedSounds();
+    void timerCallback() override;
+
+    // Message thread: how often sounds still held by voices after a swap are checked for
+    static constexpr int reclaimIntervalMs = 200;
+    void setStatus(const juce::String& newStatus);
+    void updateProgressStatus();
+
+    static juce::File findSamplesDirectory(bool& useKeySamplesNaming);
+
+    SoundSetPublisher& soundSets;
+    SampleStreamer& streamer;
+    juce::AudioFormatManager formatManager;
+    Options options;
+    bool publishIncrementally = true; // nothing was playable when this load started
+    SampleBank::Ptr bank; // set by run() before any decode job starts
+    std::unique_ptr<SampleIndex> index; // loose files only; likewise
+    juce::ThreadPool decodePool { getNumDecodeThreads() };
+
+    std::array<std::atomic<bool>, 128> requested {};
+    std::array<std::atomic<bool>, 128> loaded {};
+    std::array<std::atomic<bool>, 128> ownSampleLoaded {};
+    std::atomic<bool> convertedAny { false }; // this load resampled at least one sound
+    std::atomic<int> numProcessed { 0 };
+    std::atomic<int> numFiles { 0 };
+    std::atomic<bool> loading { false };
+
+    juce::CriticalSection statusLock;
+    juce::String status;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleLoader)
+};
@@ -0,0 +1,64 @@
+#include "SampleLoops.h"
+
+namespace
+{
+    int getInt(const juce::StringPairArray& metadata, const juce::String& key, int defaultValue = -1)
+    {
+        const auto value = metadata.getValue(key, {});
+        return value.isEmpty() ? defaultValue : value.getIntValue();
+    }
+
+    // AIFF loops name their ends by MARK identifier; find the marker's frame position.
+    int markerPosition(const juce::StringPairArray& metadata, int identifier)
+    {
+        const int numCues = getInt(metadata, "NumCuePoints", 0);
+        for (int i = 0; i < numCues; ++i)
+            if (getInt(metadata, "Cue" + juce::String(i) + "Identifier") == identifier)
+                return getInt(metadata, "Cue" + juce::String(i) + "Offset");
+        return -1;
+    }
+}
+
+SampleData::Loop SampleLoops::fromMetadata(const juce::StringPairArray& metadata)
+{
+    if (metadata.containsKey("Loop0StartIdentifier"))
+    {
+        // AIFF INST sustain loop: play mode 0 = off, 1 = forward, 2 = forward/backward (played forward here).
+        if (getInt(metadata, "Loop0Type", 0) == 0)
+            return {};
+        return { markerPosition(metadata, getInt(metadata, "Loop0StartIdentifier")),
+                 markerPosition(metadata, getInt(metadata, "Loop0EndIdentifier")) };
+    }
+
+    // WAV smpl: the end is the last frame played, inclusive. Type 0 = forward; ping-pong and reverse are skipped.
+    if (getInt(metadata, "NumSampleLoops", 0) <= 0 || getInt(metadata, "Loop0Type", 0) != 0)
+        return {};
+    const int start = getInt(metadata, "Loop0Start");
+    const int end = getInt(metadata, "Loop0End");
+    return { start, end >= 0 ? end + 1 : -1 };
+}
+
+juce::File SampleLoops::getSidecarFile(const juce::File& sampleFile)
+{
+    return sampleFile.getSiblingFile(sampleFile.getFileName() + ".loop");
+}
+
+SampleData::Loop SampleLoops::fromSidecar(const juce::File& sampleFile)
+{
+    const auto sidecar = SampleLoops::getSidecarFile(sampleFile);
+    if (!sidecar.existsAsFile())
+        return {};
+
+    juce::StringArray tokens;
+    tokens.addTokens(sidecar.loadFileAsString(), " \t\r\n", {});
+    tokens.removeEmptyStrings();
+    if (tokens.size() < 2 || !tokens[0].containsOnly("0123456789") || !tokens[1].containsOnly("0123456789"))
+        return {};
+    return { tokens[0].getIntValue(), tokens[1].getIntValue() };
+}
+
+SampleData::Loop SampleLoops::find(const juce::File& sampleFile, const SampleData::Loop& embedded)
+{
+    const auto sidecar = fromSidecar(sampleFile);
+    return sidecar.isValid() ? sidecar : embedded;
+}
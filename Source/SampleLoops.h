@@ -0,0 +1,26 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleData.h"
+
+/** Sustain loop points for sample files: the WAV `smpl` chunk or the AIFF
+ *  `INST` sustain loop (with its `MARK` markers) as exposed in a reader's
+ *  metadata, or a sidecar text file next to the sample, which takes precedence.
+ *  Shared by the scan index, the loader and the bank builder.
+ *
+ *  Sidecar: `<sample file name>.loop`, containing the loop start and end in
+ *  frames of the file (end exclusive), e.g. `44100 88200`.
+ */
+namespace SampleLoops
+{
+    /** The first forward sustain loop in a reader's metadataValues; invalid if there is none. */
+    SampleData::Loop fromMetadata(const juce::StringPairArray& metadata);
+
+    /** The loop in the sample's sidecar file; invalid if there is none or it doesn't parse. */
+    SampleData::Loop fromSidecar(const juce::File& sampleFile);
+
+    /** The sidecar loop if the file has one, else the embedded loop. */
+    SampleData::Loop find(const juce::File& sampleFile, const SampleData::Loop& embedded);
+
+    juce::File getSidecarFile(const juce::File& sampleFile);
+}
@@ -0,0 +1,189 @@
+#include "SampleNaming.h"
+
+namespace
+{
+    // Parser for keySamples naming: lowercase note + optional # + octave 0–7 (e.g. c0, c#5).
+    // Octave 0 = C1 = MIDI 24; octave 7 = C8 = MIDI 108. PRD: 7 octaves (C1–C8).
+    int keySamplesStemToMidi(const juce::String& stem)
+    {
+        if (stem.isEmpty()) return -1;
+        juce::String s = stem.toLowerCase().trim();
+        int i = 0;
+        auto letter = s[0];
+        int base = -1;
+        switch (letter)
+        {
+            case 'c': base = 0; break;
+            case 'd': base = 2; break;
+            case 'e': base = 4; break;
+            case 'f': base = 5; break;
+            case 'g': base = 7; break;
+            case 'a': base = 9; break;
+            case 'b': base = 11; break;
+            default: return -1;
+        }
+        i = 1;
+        if (i < s.length() && s[i] == '#') { base += 1; i++; }
+        if (i >= s.length() || !juce::CharacterFunctions::isDigit(s[i])) return -1;
+        int octave = 0;
+        while (i < s.length() && juce::CharacterFunctions::isDigit(s[i]))
+        {
+            octave = octave * 10 + (s[i] - '0');
+            i++;
+        }
+        if (octave < 0 || octave > 7) return -1;
+        int midi = 24 + octave * 12 + base;
+        return (midi >= 0 && midi <= 127) ? midi : -1;
+    }
+
+    int noteNameToMidi(juce::String noteName)
+    {
+        noteName = noteName.toUpperCase().retainCharacters("ABCDEFG#B0123456789-");
+        if (noteName.isEmpty())
+            return -1;
+
+        auto letter = noteName[0];
+        int base = -1;
+        switch (letter)
+        {
+            case 'C': base = 0; break;
+            case 'D': base = 2; break;
+            case 'E': base = 4; break;
+            case 'F': base = 5; break;
+            case 'G': base = 7; break;
+            case 'A': base = 9; break;
+            case 'B': base = 11; break;
+            default: return -1;
+        }
+
+        int idx = 1;
+        int accidental = 0;
+        if (idx < noteName.length() && (noteName[idx] == '#' || noteName[idx] == 'B'))
+        {
+            accidental = (noteName[idx] == '#') ? 1 : -1;
+            ++idx;
+        }
+
+        auto octaveStr = noteName.substring(idx).trim();
+        if (octaveStr.isEmpty() || !octaveStr.containsOnly("0123456789-"))
+            return -1;
+
+        const int octave = octaveStr.getIntValue();
+        const int midi = (octave + 1) * 12 + base + accidental; // MIDI 60 = C4
+        return (midi >= 0 && midi <= 127) ? midi : -1;
+    }
+
+    int parseMidiNoteFromName(const juce::String& fileStem)
+    {
+        // 1) Look for note names like C4, F#3, Bb2 (we treat 'b' as 'B' in uppercase pass above)
+        for (int i = 0; i < fileStem.length() - 1; ++i)
+        {
+            auto c = juce::CharacterFunctions::toUpperCase(fileStem[i]);
+            if (c < 'A' || c > 'G')
+                continue;
+
+            // Build candidate: letter + optional #/b + octave (at least 1 digit, maybe -1)
+            juce::String cand;
+            cand << c;
+
+            int j = i + 1;
+            if (j < fileStem.length())
+            {
+                auto acc = fileStem[j];
+                if (acc == '#' || acc == 'b' || acc == 'B')
+                {
+                    cand << acc;
+                    ++j;
+                }
+            }
+
+            if (j >= fileStem.length())
+                continue;
+
+            // Octave: optional '-' then digits
+            int k = j;
+            if (fileStem[k] == '-')
+                ++k;
+
+            int digitStart = k;
+            while (k < fileStem.length() && juce::CharacterFunctions::isDigit(fileStem[k]))
+                ++k;
+
+            if (k == digitStart)
+                continue;
+
+            cand << fileStem.substring(j, k);
+            if (auto midi = noteNameToMidi(cand); midi != -1)
+                return midi;
+        }
+
+        // 2) Look for a MIDI note number token 0..127
+        for (int i = 0; i < fileStem.length(); ++i)
+        {
+            if (!juce::CharacterFunctions::isDigit(fileStem[i]))
+                continue;
+
+            int j = i;
+            while (j < fileStem.length() && juce::CharacterFunctions::isDigit(fileStem[j]))
+                ++j;
+
+            auto token = fileStem.substring(i, j);
+            const int midi = token.getIntValue();
+            if (midi >= 0 && midi <= 127)
+                return midi;
+
+            i = j;
+        }
+
+        return -1;
+    }
+
+    // "v3", "vl3" -> velocity layer; "rr2" -> round robin. Returns false for any other token.
+    bool parseLayeringToken(const juce::String& token, SampleNaming::Layering& layering)
+    {
+        const auto lower = token.toLowerCase();
+        for (const char* prefix : { "vl", "v", "rr" })
+        {
+            const auto digits = lower.fromFirstOccurrenceOf(prefix, false, false);
+            if (!lower.startsWith(prefix) || digits.isEmpty() || !digits.containsOnly("0123456789"))
+                continue;
+            (juce::String(prefix) == "rr" ? layering.roundRobin : layering.velocityLayer) = digits.getIntValue();
+            return true;
+        }
+        return false;
+    }
+
+    // The stem split on '_' and spaces, without its layering tokens (so "Piano_v2_60" is note 60, not 2).
+    juce::String stemWithoutLayering(const juce::String& fileStem, SampleNaming::Layering& layering)
+    {
+        juce::StringArray tokens;
+        tokens.addTokens(fileStem, "_ ", {});
+        juce::StringArray kept;
+        for (const auto& token : tokens)
+            if (!parseLayeringToken(token, layering))
+                kept.add(token);
+        return kept.joinIntoString("_");
+    }
+}
+
+namespace SampleNaming
+{
+    Layering layeringForFile(const juce::File& file)
+    {
+        Layering layering;
+        stemWithoutLayering(file.getFileNameWithoutExtension(), layering);
+        return layering;
+    }
+
+    int midiNoteForFile(const juce::File& file, bool useKeySamplesNaming)
+    {
+        Layering ignored;
+        auto fileStem = stemWithoutLayering(file.getFileNameWithoutExtension(), ignored);
+        int midi = -1;
+        if (useKeySamplesNaming)
+            midi = keySamplesStemToMidi(fileStem);
+        if (midi == -1)
+            midi = parseMidiNoteFromName(fileStem);
+        return midi;
+    }
+}
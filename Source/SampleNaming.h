@@ -0,0 +1,23 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Maps sample file names to MIDI notes. Shared by SampleLoader (loose files)
+ *  and the bank builder, so both resolve a library the same way.
+ */
+namespace SampleNaming
+{
+    /** Velocity layer and round-robin position from `v<n>` / `vl<n>` and `rr<n>` name tokens
+        (e.g. Piano_C4_v2_rr3.wav); 0 = not given. Tokens are separated by '_' or spaces. */
+    struct Layering
+    {
+        int velocityLayer = 0; // 1 = softest; layers of a note split the velocity range evenly
+        int roundRobin = 0;    // alternatives of one layer, played in turn
+    };
+
+    Layering layeringForFile(const juce::File& file);
+
+    /** keySamples naming (c0 = C1 = MIDI 24, c#5, …) when useKeySamplesNaming, else/then a note
+        name (Piano_C4, Bb2) or a MIDI number token (Piano_60). Layering tokens are ignored. -1 when nothing parses. */
+    int midiNoteForFile(const juce::File& file, bool useKeySamplesNaming);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <JuceHeader.h>
+
+/** A view of interleaved integer/float PCM frames (e.g. the data chunk of a
+ *  memory-mapped WAV). Doesn't own the memory. Voices convert the span they
+ *  are about to play with readFrames() into a small float scratch, so the
+ *  samples never need a full float copy.
+ */
+struct SamplePcm
+{
+    enum class Encoding
+    {
+        int16,   // little-endian, 2 bytes
+        int24,   // little-endian, 3 bytes packed
+        float32  // IEEE float, 4 bytes
+    };
+
+    const char* data = nullptr;
+    int numChannels = 0;
+    int numFrames = 0;
+    Encoding encoding = Encoding::int16;
+
+    static constexpr int bytesPerSample(Encoding e) noexcept
+    {
+        return e == Encoding::int16 ? 2 : (e == Encoding::int24 ? 3 : 4);
+    }
+
+    int getBytesPerFrame() const noexcept { return bytesPerSample(encoding) * numChannels; }
+    bool isValid() const noexcept { return data != nullptr && numChannels > 0 && numFrames > 0; }
+
+    /** Frame as float (first two channels; mono is copied to both). Out-of-range frames read as silence. */
+    inline void readFrame(int index, float& left, float& right) const noexcept
+    {
+        if (index < 0 || index >= numFrames)
+        {
+            left = right = 0.0f;
+            return;
+        }
+
+        const char* frame = data + static_cast<size_t>(index) * static_cast<size_t>(getBytesPerFrame());
+        left = readSample(frame);
+        right = numChannels > 1 ? readSample(frame + bytesPerSample(encoding)) : left;
+    }
+
+    /** Frames [start, start + num) as float into left/right (mono is copied to both). Frames outside
+        the data read as silence. The encoding is switched on once per call, not per sample. */
+    void readFrames(int start, int num, float* left, float* right) const noexcept
+    {
+        const int first = juce::jlimit(0, num, -start);                 // leading frames before 0
+        const int last = juce::jlimit(first, num, numFrames - start);   // end of the frames inside the data
+        std::fill(left, left + first, 0.0f);
+        std::fill(right, right + first, 0.0f);
+        std::fill(left + last, left + num, 0.0f);
+        std::fill(right + last, right + num, 0.0f);
+        if (last <= first)
+            return;
+
+        const char* src = data + static_cast<size_t>(start + first) * static_cast<size_t>(getBytesPerFrame());
+        const int count = last - first;
+        switch (encoding)
+        {
+            case Encoding::int16: convertFrames<juce::int16>(src, count, left + first, right + first); break;
+            case Encoding::int24: convertInt24Frames(src, count, left + first, right + first); break;
+            case Encoding::float32:
+            default:              convertFrames<float>(src, count, left + first, right + first); break;
+        }
+    }
+
+    inline float readSample(const char* p) const noexcept
+    {
+        switch (encoding)
+        {
+            case Encoding::int16:
+                return static_cast<float>(static_cast<juce::int16>(juce::ByteOrder::littleEndianShort(p))) * (1.0f / 32768.0f);
+            case Encoding::int24:
+                return static_cast<float>(juce::ByteOrder::littleEndian24Bit(p)) * (1.0f / 8388608.0f);
+            case Encoding::float32:
+            default:
+            {
+                float v;
+                std::memcpy(&v, p, sizeof(v));
+                return v;
+            }
+        }
+    }
+
+private:
+    // Plain strided loads the compiler vectorises. memcpy keeps them legal for a mapped data chunk
+    // that isn't aligned to the sample size; little-endian hosts only, like readSample().
+    template <typename SampleType>
+    void convertFrames(const char* src, int count, float* left, float* right) const noexcept
+    {
+        const float scale = std::is_same<SampleType, float>::value ? 1.0f : 1.0f / 32768.0f;
+        const size_t stride = static_cast<size_t>(numChannels) * sizeof(SampleType);
+        for (int i = 0; i < count; ++i)
+        {
+            SampleType l, r;
+            std::memcpy(&l, src + static_cast<size_t>(i) * stride, sizeof(l));
+            std::memcpy(&r, src + static_cast<size_t>(i) * stride + (numChannels > 1 ? sizeof(SampleType) : 0), sizeof(r));
+            left[i] = static_cast<float>(l) * scale;
+            right[i] = static_cast<float>(r) * scale;
+        }
+    }
+
+    void convertInt24Frames(const char* src, int count, float* left, float* right) const noexcept
+    {
+        const int stride = getBytesPerFrame();
+        for (int i = 0; i < count; ++i, src += stride)
+        {
+            left[i] = static_cast<float>(juce::ByteOrder::littleEndian24Bit(src)) * (1.0f / 8388608.0f);
+            right[i] = numChannels > 1 ? static_cast<float>(juce::ByteOrder::littleEndian24Bit(src + 3)) * (1.0f / 8388608.0f)
+                                       : left[i];
+        }
+    }
+};
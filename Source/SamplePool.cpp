@@ -0,0 +1,66 @@
+#include "SamplePool.h"
+
+JUCE_IMPLEMENT_SINGLETON(SamplePool)
+
+SamplePool::~SamplePool()
+{
+    // Standalone pools (tests) must not clear the process-wide instance.
+    if (getInstanceWithoutCreating() == this)
+        clearSingletonInstance();
+}
+
+juce::String SamplePool::makeKey(const juce::File& file, const juce::String& variant)
+{
+    const auto canonical = file.getLinkedTarget();
+    return canonical.getFullPathName()
+         + "|" + juce::String(canonical.getLastModificationTime().toMilliseconds())
+         + "|" + variant;
+}
+
+SampleData::Ptr SamplePool::getOrCreate(const juce::File& file, const juce::String& variant,
+                                        const std::function<SampleData::Ptr()>& create)
+{
+    const auto key = makeKey(file, variant);
+    {
+        const juce::ScopedLock sl(lock);
+        auto it = entries.find(key);
+        if (it != entries.end())
+            return it->second;
+    }
+
+    // Decode without holding the lock so other instances (and other files) aren't serialised behind us.
+    auto data = create();
+    if (data == nullptr)
+        return nullptr;
+
+    const juce::ScopedLock sl(lock);
+    auto inserted = entries.emplace(key, data);
+    return inserted.first->second;
+}
+
+void SamplePool::purgeUnused()
+{
+    const juce::ScopedLock sl(lock);
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->second->getReferenceCount() <= 1)
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+int SamplePool::getNumEntries() const
+{
+    const juce::ScopedLock sl(lock);
+    return static_cast<int>(entries.size());
+}
+
+size_t SamplePool::getMemoryUsage() const
+{
+    const juce::ScopedLock sl(lock);
+    size_t total = 0;
+    for (const auto& entry : entries)
+        total += entry.second->getMemoryUsage();
+    return total;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <JuceHeader.h>
+#include "SampleData.h"
+
+/** Process-wide cache of SampleData, so every plugin instance in a session
+ *  plays from one copy of the bank instead of decoding its own.
+ *
+ *  Entries are keyed by canonical path + modification time + a variant string
+ *  describing how the data was built (e.g. full decode vs. streaming head), so
+ *  an edited file or a different load mode never returns stale audio. Entries
+ *  nobody else references are dropped by purgeUnused().
+ */
+class SamplePool : private juce::DeletedAtShutdown
+{
+public:
+    SamplePool() = default;
+    ~SamplePool() override;
+
+    /** Returns the pooled data for file/variant, calling create() (outside the lock) on a miss.
+        If two loaders race on the same key, the first one stored wins and the other's copy is dropped. */
+    SampleData::Ptr getOrCreate(const juce::File& file, const juce::String& variant,
+                                const std::function<SampleData::Ptr()>& create);
+
+    /** Releases entries that only the pool still references. */
+    void purgeUnused();
+
+    int getNumEntries() const;
+
+    /** Heap bytes held by all pooled data (mapped pages excluded). */
+    size_t getMemoryUsage() const;
+
+    JUCE_DECLARE_SINGLETON(SamplePool, false)
+
+private:
+    static juce::String makeKey(const juce::File& file, const juce::String& variant);
+
+    juce::CriticalSection lock;
+    std::map<juce::String, SampleData::Ptr> entries;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SamplePool)
+};
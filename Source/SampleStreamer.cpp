@@ -0,0 +1,200 @@
+#include "SampleStreamer.h"
+
+void SampleStreamer::Slot::start(int sourceId, int startFrame) noexcept
+{
+    requestedSource.store(sourceId, std::memory_order_relaxed);
+    requestedStart.store(startFrame, std::memory_order_relaxed);
+    requestedGeneration.store(requestedGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+int SampleStreamer::Slot::read(float* left, float* right, int numFrames) noexcept
+{
+    // Until the I/O thread has switched to our latest request, the ring holds stale (or no) audio.
+    if (activeGeneration.load(std::memory_order_acquire) != requestedGeneration.load(std::memory_order_relaxed))
+        return 0;
+
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    fifo.prepareToRead(numFrames, start1, size1, start2, size2);
+
+    const float* ringL = ring.getReadPointer(0);
+    const float* ringR = ring.getReadPointer(1);
+    if (size1 > 0)
+    {
+        juce::FloatVectorOperations::copy(left, ringL + start1, size1);
+        juce::FloatVectorOperations::copy(right, ringR + start1, size1);
+    }
+    if (size2 > 0)
+    {
+        juce::FloatVectorOperations::copy(left + size1, ringL + start2, size2);
+        juce::FloatVectorOperations::copy(right + size1, ringR + start2, size2);
+    }
+
+    fifo.finishedRead(size1 + size2);
+    return size1 + size2;
+}
+
+SampleStreamer::SampleStreamer(int maxStreams)
+    : juce::Thread("Matilda sample streamer")
+{
+    formatManager.registerBasicFormats();
+    for (int i = 0; i < maxStreams; ++i)
+        slots.add(new Slot());
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    stop();
+}
+
+void SampleStreamer::start(int numStreamsWanted)
+{
+    // Slots past numStreams can't be claimed, so nothing reads or fills their buffers until it is raised.
+    const int wanted = juce::jlimit(0, slots.size(), numStreamsWanted);
+    for (int i = numStreams.load(std::memory_order_relaxed); i < wanted; ++i)
+    {
+        slots.getUnchecked(i)->ring.setSize(2, ringCapacity);
+        slots.getUnchecked(i)->window.setSize(2, windowCapacity);
+    }
+    if (wanted > numStreams.load(std::memory_order_relaxed))
+        numStreams.store(wanted, std::memory_order_release);
+
+    if (!isThreadRunning())
+        startThread();
+}
+
+void SampleStreamer::stop()
+{
+    stopThread(2000);
+}
+
+int SampleStreamer::registerSource(const juce::File& file, int lengthInFrames)
+{
+    const juce::ScopedLock sl(sourcesLock);
+    for (int i = 0; i < sources.size(); ++i)
+    {
+        if (sources.getReference(i).file == file)
+        {
+            sources.getReference(i).length = lengthInFrames;
+            return i;
+        }
+    }
+    sources.add({ file, lengthInFrames });
+    return sources.size() - 1;
+}
+
+SampleStreamer::Slot* SampleStreamer::claimSlot() noexcept
+{
+    const int available = numStreams.load(std::memory_order_acquire);
+    for (int i = 0; i < available; ++i)
+    {
+        auto* slot = slots.getUnchecked(i);
+        if (!slot->claimed.load(std::memory_order_relaxed) && !slot->claimed.exchange(true, std::memory_order_acquire))
+            return slot;
+    }
+    missedStreams.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void SampleStreamer::releaseSlot(Slot& slot) noexcept
+{
+    // The next claimant's start() is a newer generation, so it never reads what was left in the ring.
+    slot.stop();
+    slot.claimed.store(false, std::memory_order_release);
+}
+
+int SampleStreamer::getNumUnderruns() const noexcept
+{
+    int total = missedStreams.load(std::memory_order_relaxed);
+    for (auto* slot : slots)
+        total += slot->getNumUnderruns();
+    return total;
+}
+
+void SampleStreamer::run()
+{
+    while (!threadShouldExit())
+    {
+        for (auto* slot : slots)
+        {
+            const auto generation = slot->requestedGeneration.load(std::memory_order_acquire);
+            if (generation != slot->servedGeneration)
+                beginRequest(*slot, generation);
+        }
+
+        // Top up one chunk at a time so new note-ons are picked up between reads; poll when idle.
+        if (!fillEmptiestSlot())
+            wait(2);
+    }
+}
+
+void SampleStreamer::beginRequest(Slot& slot, juce::uint32 generation)
+{
+    slot.servedGeneration = generation;
+    const int sourceId = slot.requestedSource.load(std::memory_order_relaxed);
+    const int startFrame = slot.requestedStart.load(std::memory_order_relaxed);
+
+    // The voice doesn't read while activeGeneration is stale, so resetting the ring here is safe.
+    slot.fifo.reset();
+    slot.nextReadFrame = 0;
+    slot.endFrame = 0;
+
+    if (sourceId >= 0)
+    {
+        Source source;
+        {
+            const juce::ScopedLock sl(sourcesLock);
+            source = sources[sourceId];
+        }
+
+        if (slot.openSourceId != sourceId || slot.reader == nullptr)
+        {
+            slot.reader.reset(formatManager.createReaderFor(source.file));
+            slot.openSourceId = slot.reader != nullptr ? sourceId : -1;
+        }
+
+        if (slot.reader != nullptr)
+        {
+            slot.nextReadFrame = startFrame;
+            slot.endFrame = juce::jmin(source.length, static_cast<int>(slot.reader->lengthInSamples));
+        }
+    }
+
+    slot.activeGeneration.store(generation, std::memory_order_release);
+}
+
+bool SampleStreamer::fillEmptiestSlot()
+{
+    Slot* emptiest = nullptr;
+    int lowestFill = ringCapacity;
+    for (auto* slot : slots)
+    {
+        if (slot->nextReadFrame >= slot->endFrame || slot->fifo.getFreeSpace() < chunkSize)
+            continue;
+        const int fill = slot->fifo.getNumReady();
+        if (fill < lowestFill)
+        {
+            lowestFill = fill;
+            emptiest = slot;
+        }
+    }
+
+    if (emptiest == nullptr)
+        return false;
+
+    auto& slot = *emptiest;
+    const int numFrames = juce::jmin(chunkSize, slot.endFrame - slot.nextReadFrame);
+    slot.reader->read(&ioBuffer, 0, numFrames, slot.nextReadFrame, true, true);
+    slot.nextReadFrame += numFrames;
+
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    slot.fifo.prepareToWrite(numFrames, start1, size1, start2, size2);
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        if (size1 > 0)
+            slot.ring.copyFrom(ch, start1, ioBuffer, ch, 0, size1);
+        if (size2 > 0)
+            slot.ring.copyFrom(ch, start2, ioBuffer, ch, size1, size2);
+    }
+    slot.fifo.finishedWrite(size1 + size2);
+    return true;
+}
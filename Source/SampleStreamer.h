@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <JuceHeader.h>
+
+/** Direct-from-disk streaming for sounds that only keep their first few hundred
+ *  milliseconds in RAM (see MatildaSamplerSound / SampleLoader::Options).
+ *
+ *  A Slot is a lock-free single-producer/single-consumer ring buffer. On
+ *  note-on a voice claims a free slot, plays the resident head and calls
+ *  Slot::start(); the I/O thread opens the file, seeks past the head and keeps
+ *  the ring topped up (emptiest ring first) while the voice consumes it with
+ *  Slot::read(). A voice that finds its ring empty reports an underrun instead
+ *  of blocking, and one that finds no free slot counts as one too.
+ *
+ *  Slots are shared by all voices rather than owned by each. Only the number
+ *  start() asks for (the polyphony, not the voice pool) get a ring and a
+ *  window, and only once streaming is used.
+ */
+class SampleStreamer : private juce::Thread
+{
+public:
+    /** Ring size per stream in frames (~0.75 s at 44.1 kHz). */
+    static constexpr int ringCapacity = 32768;
+
+    /** Frames of the voice's staging window (see getWindow()). */
+    static constexpr int windowCapacity = 8192;
+
+    /** Frames read from disk per I/O request. */
+    static constexpr int chunkSize = 4096;
+
+    class Slot
+    {
+    public:
+        Slot() = default;
+
+        /** Audio thread: begin streaming a source from startFrame (frames before it are resident). */
+        void start(int sourceId, int startFrame) noexcept;
+
+        /** Audio thread: release the stream (the I/O thread stops reading for this slot). */
+        void stop() noexcept { start(-1, 0); }
+
+        /** Audio thread: copies up to numFrames into left/right; returns frames copied. */
+        int read(float* left, float* right, int numFrames) noexcept;
+
+        void reportUnderrun() noexcept { underruns.fetch_add(1, std::memory_order_relaxed); }
+        int getNumUnderruns() const noexcept { return underruns.load(std::memory_order_relaxed); }
+
+        /** The claiming voice's own staging buffer for frames read from the ring (2 x windowCapacity). */
+        juce::AudioBuffer<float>& getWindow() noexcept { return window; }
+
+    private:
+        friend class SampleStreamer;
+
+        juce::AbstractFifo fifo { ringCapacity };
+        juce::AudioBuffer<float> ring;   // 2 x ringCapacity, and
+        juce::AudioBuffer<float> window; // 2 x windowCapacity, once start() has counted this slot in
+        std::atomic<bool> claimed { false };
+
+        // Written by the voice; requestedGeneration is stored last (release) so the I/O thread sees a whole request.
+        std::atomic<int> requestedSource { -1 };
+        std::atomic<int> requestedStart { 0 };
+        std::atomic<juce::uint32> requestedGeneration { 0 };
+        // Written by the I/O thread after it reset the ring for a request; the voice only reads when it matches.
+        std::atomic<juce::uint32> activeGeneration { 0 };
+        std::atomic<int> underruns { 0 };
+
+        // I/O thread only
+        juce::uint32 servedGeneration = 0;
+        int openSourceId = -1;
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        int nextReadFrame = 0;
+        int endFrame = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(Slot)
+    };
+
+    /** maxStreams slots, none with a ring yet. */
+    explicit SampleStreamer(int maxStreams);
+    ~SampleStreamer() override;
+
+    /** Message thread: gives numStreams slots their buffers (more if called again with more; never fewer) and starts
+        the I/O thread if it isn't running. Slots keep working (silently underrunning) while stopped. */
+    void start(int numStreams);
+    void stop();
+    bool isRunning() const { return isThreadRunning(); }
+
+    /** Any render thread, at note-on: a free slot for one stream, or nullptr if every counted-in slot is taken
+        (counted as an underrun). Give it back with releaseSlot(). */
+    Slot* claimSlot() noexcept;
+
+    /** Stops the slot's stream and frees it for the next claimSlot(). */
+    void releaseSlot(Slot& slot) noexcept;
+
+    /** Slots that have buffers (what start() was last asked for, at most maxStreams). */
+    int getNumStreams() const noexcept { return numStreams.load(std::memory_order_acquire); }
+
+    /** Registers a streamable file (call off the audio thread). The same file returns the same id. */
+    int registerSource(const juce::File& file, int lengthInFrames);
+
+    /** Total ring underruns reported by all voices since construction. */
+    int getNumUnderruns() const noexcept;
+
+private:
+    struct Source
+    {
+        juce::File file;
+        int length = 0;
+    };
+
+    void run() override;
+    void beginRequest(Slot& slot, juce::uint32 generation);
+    bool fillEmptiestSlot();
+
+    juce::OwnedArray<Slot> slots;
+    std::atomic<int> numStreams { 0 }; // slots [0, numStreams) have buffers and can be claimed
+    std::atomic<int> missedStreams { 0 };
+
+    juce::CriticalSection sourcesLock;
+    juce::Array<Source> sources;
+
+    juce::AudioFormatManager formatManager;
+    juce::AudioBuffer<float> ioBuffer { 2, chunkSize };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleStreamer)
+};
@@ -0,0 +1,88 @@
+#include "SoundSet.h"
+#include <algorithm>
+
+SoundSet::SoundSet(const SoundSet* previous, juce::SynthesiserSound::Ptr added)
+{
+    if (previous != nullptr)
+        sounds.addArray(previous->sounds);
+    sounds.add(std::move(added));
+}
+
+void SoundSet::buildKeyMap()
+{
+    using SoundList = std::vector<MatildaSamplerSound*>;
+    std::array<SoundList, 128> own;
+    SoundList fallback;
+
+    // 1. Keys a sound was mapped to. Sounds covering every key (unparsed file names) only fill what's
+    //    left at the end, so they no longer shadow the real samples.
+    for (auto* s : sounds)
+    {
+        auto* sound = dynamic_cast<MatildaSamplerSound*>(s);
+        if (sound == nullptr)
+            continue;
+        const auto& notes = sound->getMidiNotes();
+        if (notes.countNumberOfSetBits() >= 128)
+        {
+            fallback.push_back(sound);
+            continue;
+        }
+        for (int key = notes.findNextSetBit(0); key >= 0 && key < 128; key = notes.findNextSetBit(key + 1))
+            own[static_cast<size_t>(key)].push_back(sound);
+    }
+
+    for (int key = 0; key < 128; ++key)
+        ownSample[static_cast<size_t>(key)] = !own[static_cast<size_t>(key)].empty();
+
+    // 2. Empty keys take the nearest sampled key within reach (the lower one on a tie);
+    // 3. whatever is still silent plays the catch-all sounds, if there are any.
+    std::array<const SoundList*, 128> source {};
+    for (int key = 0; key < 128; ++key)
+    {
+        for (int distance = 0; distance <= maxTransposeSemitones && source[static_cast<size_t>(key)] == nullptr; ++distance)
+        {
+            if (key - distance >= 0 && !own[static_cast<size_t>(key - distance)].empty())
+                source[static_cast<size_t>(key)] = &own[static_cast<size_t>(key - distance)];
+            else if (key + distance < 128 && !own[static_cast<size_t>(key + distance)].empty())
+                source[static_cast<size_t>(key)] = &own[static_cast<size_t>(key + distance)];
+        }
+        if (source[static_cast<size_t>(key)] == nullptr && !fallback.empty())
+            source[static_cast<size_t>(key)] = &fallback;
+    }
+
+    // Each key's sounds, grouped into velocity layers (by layer number) of round-robin alternatives.
+    zones.clear();
+    for (int key = 0; key < 128; ++key)
+    {
+        auto& entry = keys[static_cast<size_t>(key)];
+        entry = {};
+        if (source[static_cast<size_t>(key)] == nullptr)
+            continue;
+
+        auto list = *source[static_cast<size_t>(key)];
+        std::stable_sort(list.begin(), list.end(), [](const MatildaSamplerSound* a, const MatildaSamplerSound* b)
+        {
+            return a->getVelocityLayer() != b->getVelocityLayer() ? a->getVelocityLayer() < b->getVelocityLayer()
+                                                                  : a->getRoundRobin() < b->getRoundRobin();
+        });
+
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            const bool newLayer = i == 0 || list[i]->getVelocityLayer() != list[i - 1]->getVelocityLayer();
+            if (newLayer && entry.numLayers == maxVelocityLayers)
+                break;
+            if (newLayer)
+                entry.layers[static_cast<size_t>(entry.numLayers++)].firstZone = static_cast<int>(zones.size());
+
+            entry.layers[static_cast<size_t>(entry.numLayers - 1)].numZones++;
+            zones.push_back({ list[i], std::pow(2.0, (key - list[i]->getMidiRootNote()) / 12.0) });
+        }
+
+        // Layers split 0..127 evenly, softest first.
+        const int numLayers = entry.numLayers;
+        for (int velocity = 0; velocity < 128; ++velocity)
+            entry.layerForVelocity[static_cast<size_t>(velocity)] = static_cast<juce::uint8>(velocity * numLayers / 128);
+        for (int layer = 0; layer < numLayers; ++layer)
+            entry.layers[static_cast<size_t>(layer)].centreVelocity = (static_cast<float>(layer) + 0.5f) * 128.0f / static_cast<float>(numLayers);
+    }
+}
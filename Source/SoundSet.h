@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <JuceHeader.h>
+#include "MatildaSamplerSound.h"
+
+/** One generation of the playable sounds. Built off the audio thread, then
+ *  published whole by SoundSetPublisher and never modified afterwards, so the
+ *  audio thread can walk it without a lock.
+ *
+ *  Publishing also builds the key map. For each MIDI key it holds the sounds
+ *  that play it: velocity layers, each with its round-robin alternatives, plus
+ *  a velocity-to-layer table. A note-on is then a couple of table lookups.
+ *  Keys without a sample of their own play the nearest sampled key (up to
+ *  maxTransposeSemitones away), transposed.
+ */
+class SoundSet : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<SoundSet>;
+
+    /** Furthest a sample is transposed to fill a key that has none of its own. */
+    static constexpr int maxTransposeSemitones = 12;
+
+    /** Layers beyond this many per key are ignored. */
+    static constexpr int maxVelocityLayers = 16;
+
+    struct Zone
+    {
+        MatildaSamplerSound* sound = nullptr;
+        double pitchRatio = 1.0; // 2^(semitones from the sound's root / 12)
+    };
+
+    struct Layer
+    {
+        int firstZone = 0;         // round-robin alternatives: getZone(firstZone) .. + numZones - 1
+        int numZones = 0;
+        float centreVelocity = 0;  // 0..127; velocity crossfades run between adjacent layers' centres
+    };
+
+    struct Key
+    {
+        std::array<juce::uint8, 128> layerForVelocity {};
+        std::array<Layer, maxVelocityLayers> layers {};
+        int numLayers = 0; // 0 = key is silent
+    };
+
+    SoundSet() = default;
+
+    /** A copy of previous (may be null) with one more sound. */
+    SoundSet(const SoundSet* previous, juce::SynthesiserSound::Ptr added);
+
+    void add(juce::SynthesiserSound::Ptr sound) { sounds.add(std::move(sound)); }
+
+    const juce::ReferenceCountedArray<juce::SynthesiserSound>& getSounds() const noexcept { return sounds; }
+    int size() const noexcept { return sounds.size(); }
+    bool isEmpty() const noexcept { return sounds.isEmpty(); }
+
+    /** What plays this key (valid once published; lock-free, O(1)). */
+    const Key& getKey(int midiNote) const noexcept { return keys[static_cast<size_t>(juce::jlimit(0, 127, midiNote))]; }
+    const Zone& getZone(int index) const noexcept { return zones[static_cast<size_t>(index)]; }
+
+    /** The layer a velocity (0..127) selects on this key. */
+    const Layer& getLayer(const Key& key, int velocity) const noexcept
+    {
+        return key.layers[key.layerForVelocity[static_cast<size_t>(juce::jlimit(0, 127, velocity))]];
+    }
+
+    bool coversNote(int midiNote) const noexcept { return getKey(midiNote).numLayers > 0; }
+
+    /** True if a sound was mapped to this key itself, rather than a neighbour or catch-all filling it. */
+    bool hasOwnSample(int midiNote) const noexcept { return juce::isPositiveAndBelow(midiNote, 128) && ownSample[static_cast<size_t>(midiNote)]; }
+
+private:
+    friend class SoundSetPublisher;
+
+    /** Fills keys and zones from sounds; called once, by SoundSetPublisher::publish(). */
+    void buildKeyMap();
+
+    juce::ReferenceCountedArray<juce::SynthesiserSound> sounds;
+    std::array<Key, 128> keys {};
+    std::array<bool, 128> ownSample {};
+    std::vector<Zone> zones;
+    juce::uint64 generation = 0; // assigned when published
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SoundSet)
+};
@@ -0,0 +1,90 @@
+#include "SoundSetPublisher.h"
+
+SoundSetPublisher::~SoundSetPublisher()
+{
+    clear();
+}
+
+void SoundSetPublisher::publish(SoundSet::Ptr next)
+{
+    if (next == nullptr)
+        next = new SoundSet(); // the audio thread must always be able to acknowledge a generation
+    next->buildKeyMap();        // before the audio thread can see it; the set is read-only from here on
+
+    {
+        const juce::ScopedLock sl(writeLock);
+        next->generation = nextGeneration++;
+
+        auto previous = std::move(published);
+        published = next;
+        current.store(next.get()); // seq_cst, against acquire(): see there
+
+        if (previous != nullptr)
+            retired.push_back({ std::move(previous), next->generation });
+    }
+    collectGarbage();
+}
+
+SoundSet::Ptr SoundSetPublisher::getPublished() const
+{
+    const juce::ScopedLock sl(writeLock);
+    return published;
+}
+
+const SoundSet* SoundSetPublisher::acquire() noexcept
+{
+    // Mark busy, load, then acknowledge. If a publish slips in before the acknowledgement, the set we loaded is
+    // retired with a newer generation than the one we acknowledge, so it is kept until we move on. All three are
+    // seq_cst: a collector that still sees us idle published before our load, so we can't load what it frees.
+    readerGeneration.store(0);
+    auto* set = current.load();
+    if (set != nullptr)
+        readerGeneration.store(set->generation);
+    return set;
+}
+
+void SoundSetPublisher::release() noexcept
+{
+    readerGeneration.store(idle);
+}
+
+void SoundSetPublisher::collectGarbage()
+{
+    const juce::ScopedLock sl(writeLock);
+    const auto acknowledged = readerGeneration.load();
+
+    for (auto it = retired.begin(); it != retired.end();)
+    {
+        if (acknowledged < it->replacedBy)
+        {
+            ++it;
+            continue;
+        }
+
+        // The audio thread can't reach this set any more, but voices may still be playing its sounds.
+        for (auto* sound : it->set->getSounds())
+            if (published == nullptr || !published->getSounds().contains(sound))
+                releasedSounds.addIfNotAlreadyThere(sound);
+        it = retired.erase(it);
+    }
+
+    // Only we hold these now: no set has them and no voice is playing them.
+    for (int i = releasedSounds.size(); --i >= 0;)
+        if (releasedSounds.getObjectPointerUnchecked(i)->getReferenceCount() == 1)
+            releasedSounds.remove(i);
+}
+
+void SoundSetPublisher::clear()
+{
+    const juce::ScopedLock sl(writeLock);
+    current.store(nullptr, std::memory_order_release);
+    published = nullptr;
+    retired.clear();
+    releasedSounds.clear();
+}
+
+int SoundSetPublisher::getNumRetired() const
+{
+    const juce::ScopedLock sl(writeLock);
+    return static_cast<int>(retired.size()) + releasedSounds.size();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <vector>
+#include <JuceHeader.h>
+#include "SoundSet.h"
+
+/** Hands SoundSets to the audio thread read-copy-update style: a new set is
+ *  built elsewhere and published with one atomic pointer exchange, so the
+ *  audio thread never waits on a loader and never sees a half-built set.
+ *
+ *  The audio thread calls acquire() and may use the returned set until it
+ *  calls release() or acquire() again. A replaced set is retired, not freed.
+ *  collectGarbage() frees a retired set once the audio thread has acquired a
+ *  newer one or released what it had, so an audio thread that isn't
+ *  processing never holds a set back. A sound
+ *  dropped from every set is freed once no voice holds it either. Nothing is
+ *  ever released on the audio thread.
+ */
+class SoundSetPublisher
+{
+public:
+    SoundSetPublisher() = default;
+    ~SoundSetPublisher();
+
+    /** Makes next the current set (null = an empty set) and retires the old one. Any thread but the audio thread. */
+    void publish(SoundSet::Ptr next);
+
+    /** The current set, for building the next one from (any thread but the audio thread). */
+    SoundSet::Ptr getPublished() const;
+
+    /** Audio thread: the current set, valid until release() or the next acquire(). Lock-free; null before the first publish(). */
+    const SoundSet* acquire() noexcept;
+
+    /** Audio thread: done with the set from acquire(). Until the next acquire(), every set counts as acknowledged. */
+    void release() noexcept;
+
+    /** Frees what the audio thread can no longer reach. Any thread but the audio thread. */
+    void collectGarbage();
+
+    /** Drops every set and sound at once. Only when the audio thread can't be running (e.g. a destructor). */
+    void clear();
+
+    /** Retired sets plus sounds still waiting for their voices to finish. */
+    int getNumRetired() const;
+
+private:
+    struct Retired
+    {
+        SoundSet::Ptr set;
+        juce::uint64 replacedBy = 0; // generation of the set that replaced it
+    };
+
+    std::atomic<SoundSet*> current { nullptr };
+    // Generation the audio thread last acquired; 0 while it is acquiring, idle once it has released.
+    static constexpr juce::uint64 idle = std::numeric_limits<juce::uint64>::max();
+    std::atomic<juce::uint64> readerGeneration { idle };
+
+    juce::CriticalSection writeLock;
+    SoundSet::Ptr published; // keeps current alive
+    juce::uint64 nextGeneration = 1;
+    std::vector<Retired> retired;
+    juce::ReferenceCountedArray<juce::SynthesiserSound> releasedSounds;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SoundSetPublisher)
+};
@@ -18,6 +18,8 @@ void TapeModule::prepare(const juce::dsp::ProcessSpec& spec)
     // Prepare tone filter
     toneFilter.prepare(spec);
     updateFilters();
+
+    saturation.prepare(sampleRate, static_cast<int>(spec.maximumBlockSize));
 }
 
 void TapeModule::process(juce::dsp::AudioBlock<float>& block)
@@ -31,6 +33,9 @@ void TapeModule::process(juce::dsp::AudioBlock<float>& block)
     wowOscillator.setFrequency(wowFreq);
     flutterOscillator.setFrequency(flutterFreq);
     
+    // Saturation moves per sample; the same values serve every channel.
+    const float* saturationValues = saturation.getNextValues(static_cast<int>(block.getNumSamples()));
+
     // Process each sample
     for (size_t channel = 0; channel < block.getNumChannels(); ++channel)
     {
@@ -44,7 +49,7 @@ void TapeModule::process(juce::dsp::AudioBlock<float>& block)
             float modulation = wow + flutter;
             float originalSample = channelData[sample];
             float modulatedSample = originalSample * (1.0f + modulation);
-            modulatedSample = applySaturation(modulatedSample);
+            modulatedSample = applySaturation(modulatedSample, saturationValues[sample]);
             channelData[sample] = modulatedSample;
         }
     }
@@ -67,7 +72,7 @@ void TapeModule::setWowFlutterRate(float rate)
 
 void TapeModule::setSaturation(float sat)
 {
-    saturation = juce::jlimit(0.0f, 1.0f, sat);
+    saturation.setTarget(juce::jlimit(0.0f, 1.0f, sat));
 }
 
 void TapeModule::setToneCutoff(float cutoff)
@@ -85,15 +90,15 @@ void TapeModule::updateFilters()
             sampleRate, cutoffHz, 0.707f);
 }
 
-float TapeModule::applySaturation(float sample)
+float TapeModule::applySaturation(float sample, float amount)
 {
-    if (saturation < 0.001f)
+    if (amount < 0.001f)
         return sample;
     // Stronger drive so XY pad (Y axis) is clearly audible
-    float drive = 1.0f + saturation * 4.0f;
+    float drive = 1.0f + amount * 4.0f;
     float driven = sample * drive;
     float saturated = std::tanh(driven);
     // More wet mix so saturation is obvious
-    float wet = saturation * 0.85f + 0.15f;
+    float wet = amount * 0.85f + 0.15f;
     return sample * (1.0f - wet) + saturated * wet;
 }
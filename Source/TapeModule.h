@@ -1,6 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ParameterRamp.h"
 
 class TapeModule
 {
@@ -13,7 +14,7 @@ public:
     void reset();
     
     void setWowFlutterRate(float rate);  // 0.0 to 1.0
-    void setSaturation(float saturation); // 0.0 to 1.0
+    void setSaturation(float saturation); // 0.0 to 1.0, ramped per sample
     void setToneCutoff(float cutoff);     // Normalized cutoff (0.0 to 1.0)
     
 private:
@@ -22,11 +23,11 @@ private:
     juce::dsp::IIR::Filter<float> toneFilter;
     
     float wowFlutterRate = 0.0f;
-    float saturation = 0.0f;
+    ParameterRamp saturation;
     float toneCutoff = 1.0f;
     
     double sampleRate = 44100.0;
     
     void updateFilters();
-    float applySaturation(float sample);
+    static float applySaturation(float sample, float amount);
 };
@@ -0,0 +1,78 @@
+#include "UiMidiQueue.h"
+
+bool UiMidiQueue::push(const juce::MidiMessage& message, double timeMs) noexcept
+{
+    const int size = message.getRawDataSize();
+    jassert(size <= 3); // channel messages only; sysex doesn't come from the UI
+    if (size > 3)
+        return false;
+
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 0)
+    {
+        if (!message.isNoteOff())
+            return false;
+        const int bit = (message.getChannel() - 1) * 128 + message.getNoteNumber();
+        overflowNoteOffs[static_cast<size_t>(bit / 32)].fetch_or(1u << (bit % 32), std::memory_order_release);
+        return true;
+    }
+
+    auto& event = queue[static_cast<size_t>(start1)];
+    std::memcpy(event.bytes, message.getRawData(), static_cast<size_t>(size));
+    event.size = size;
+    event.timeMs = timeMs;
+    fifo.finishedWrite(1);
+    return true;
+}
+
+void UiMidiQueue::popInto(juce::MidiBuffer& midi, int numSamples, double sampleRate, double nowMs) noexcept
+{
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+    // The block stands for the numSamples before nowMs: an event that long ago lands at 0, one at nowMs at the end.
+    const int lastOffset = juce::jmax(0, numSamples - 1);
+    const double samplesPerMs = sampleRate / 1000.0;
+    const double blockStartMs = nowMs - numSamples / samplesPerMs;
+    const double staleMs = blockStartMs - staleBlocks * numSamples / samplesPerMs;
+    auto add = [&](int start, int size)
+    {
+        for (int i = start; i < start + size; ++i)
+        {
+            const auto& event = queue[static_cast<size_t>(i)];
+            const bool isNoteOff = (event.bytes[0] & 0xf0) == 0x80 || ((event.bytes[0] & 0xf0) == 0x90 && event.bytes[2] == 0);
+            if (event.timeMs < staleMs && !isNoteOff)
+                continue;
+            const int offset = juce::jlimit(0, lastOffset, juce::roundToInt((event.timeMs - blockStartMs) * samplesPerMs));
+            midi.addEvent(event.bytes, event.size, offset);
+        }
+    };
+    add(start1, size1);
+    add(start2, size2);
+    fifo.finishedRead(size1 + size2);
+
+    // Note-offs that didn't fit came after everything that did.
+    for (size_t word = 0; word < overflowNoteOffs.size(); ++word)
+    {
+        if (overflowNoteOffs[word].load(std::memory_order_relaxed) == 0)
+            continue;
+        auto bits = overflowNoteOffs[word].exchange(0, std::memory_order_acquire);
+        for (int b = 0; bits != 0; ++b, bits >>= 1)
+            if ((bits & 1) != 0)
+            {
+                const int bit = static_cast<int>(word) * 32 + b;
+                midi.addEvent(juce::MidiMessage::noteOff(bit / 128 + 1, bit % 128), lastOffset);
+            }
+    }
+}
+
+void UiMidiQueue::handleNoteOn(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
+{
+    push(juce::MidiMessage::noteOn(midiChannel, midiNoteNumber, velocity));
+}
+
+void UiMidiQueue::handleNoteOff(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
+{
+    push(juce::MidiMessage::noteOff(midiChannel, midiNoteNumber, velocity));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <JuceHeader.h>
+
+/** Notes played on the editor (the on-screen keyboard, the computer keyboard)
+ *  on their way to the audio thread.
+ *
+ *  The UI side pushes each message with the time it happened through a
+ *  lock-free single-producer/single-consumer queue. Listening to a
+ *  MidiKeyboardState feeds it every key press with its velocity. Each block,
+ *  the audio thread moves everything queued into its MIDI buffer. An event is
+ *  placed as far before the end of the block as it happened before the block
+ *  started, so notes play one block late with the timing they were played at,
+ *  whatever the buffer size.
+ *
+ *  Events more than staleBlocks blocks old when they are popped (the host
+ *  wasn't processing) are dropped rather than played all at once, except
+ *  note-offs. When the queue is full a message is dropped, except a note-off:
+ *  that is kept as a bit per channel and note and sent at the end of the next
+ *  block, so a full queue never leaves a note stuck.
+ */
+class UiMidiQueue : public juce::MidiKeyboardState::Listener
+{
+public:
+    static constexpr int queueSize = 1024;
+
+    /** Messages older than this many blocks before the one being filled are dropped (note-offs are still sent). */
+    static constexpr int staleBlocks = 2;
+
+    UiMidiQueue() = default;
+
+    /** Producer (one UI thread, normally the message thread): queues a short message stamped at timeMs on the
+        Time::getMillisecondCounterHiRes() clock. False if the queue is full and it was dropped (never for a note-off). */
+    bool push(const juce::MidiMessage& message, double timeMs = juce::Time::getMillisecondCounterHiRes()) noexcept;
+
+    /** Audio thread: adds the queued messages to midi, at offsets in [0, numSamples), for the numSamples that end
+        at nowMs. Stale ones are dropped and note-offs that didn't fit in the queue go at the end. */
+    void popInto(juce::MidiBuffer& midi, int numSamples, double sampleRate,
+                 double nowMs = juce::Time::getMillisecondCounterHiRes()) noexcept;
+
+    // MidiKeyboardState::Listener (called on the thread that changes the state)
+    void handleNoteOn(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
+    void handleNoteOff(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
+
+private:
+    struct Event
+    {
+        juce::uint8 bytes[3] {};
+        int size = 0;
+        double timeMs = 0.0;
+    };
+
+    juce::AbstractFifo fifo { queueSize };
+    std::array<Event, queueSize> queue;
+
+    // Note-offs that found the queue full: bit (channel - 1) * 128 + note
+    std::array<std::atomic<juce::uint32>, 16 * 128 / 32> overflowNoteOffs {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UiMidiQueue)
+};
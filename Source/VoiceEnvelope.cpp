@@ -0,0 +1,193 @@
+#include "VoiceEnvelope.h"
+
+namespace
+{
+    // Per-sample factor that takes a distance down to VoiceEnvelope::silenceLevel of itself in numSamples.
+    float exponentialCoefficient(double numSamples) noexcept
+    {
+        return numSamples > 0.0 ? static_cast<float>(std::pow(static_cast<double>(VoiceEnvelope::silenceLevel), 1.0 / numSamples)) : 0.0f;
+    }
+}
+
+VoiceEnvelope::VoiceEnvelope()
+{
+    recalculate();
+}
+
+void VoiceEnvelope::setSampleRate(double newSampleRate)
+{
+    jassert(newSampleRate > 0.0);
+    sampleRate = newSampleRate;
+    recalculate();
+}
+
+void VoiceEnvelope::setParameters(const Parameters& newParameters)
+{
+    const float sustain = juce::jlimit(0.0f, 1.0f, newParameters.sustain);
+    if (newParameters.attack == parameters.attack && newParameters.decay == parameters.decay && sustain == parameters.sustain
+        && newParameters.release == parameters.release && newParameters.curve == parameters.curve)
+        return; // the per-block parameter push usually changes nothing
+
+    parameters = newParameters;
+    parameters.sustain = sustain;
+    recalculate();
+}
+
+void VoiceEnvelope::recalculate() noexcept
+{
+    const auto samples = [this](float seconds) { return static_cast<double>(seconds) * sampleRate; };
+    attackStep = parameters.attack > 0.0f ? static_cast<float>(1.0 / samples(parameters.attack)) : 0.0f;
+    decayStep = parameters.decay > 0.0f ? static_cast<float>((1.0 - parameters.sustain) / samples(parameters.decay)) : 0.0f;
+    decayCoefficient = exponentialCoefficient(samples(parameters.decay));
+    releaseCoefficient = exponentialCoefficient(samples(parameters.release));
+    if (state == State::release && parameters.release > 0.0f)
+        releaseStep = static_cast<float>(level / samples(parameters.release));
+}
+
+void VoiceEnvelope::noteOn() noexcept
+{
+    if (attackStep > 0.0f)
+        state = State::attack;
+    else
+    {
+        level = 1.0f;
+        enterDecayOrSustain();
+    }
+}
+
+void VoiceEnvelope::noteOff() noexcept
+{
+    if (state == State::idle || state == State::fadeOut)
+        return;
+
+    if (parameters.release > 0.0f)
+    {
+        releaseStep = static_cast<float>(level / (static_cast<double>(parameters.release) * sampleRate));
+        state = State::release;
+    }
+    else
+    {
+        reset();
+    }
+}
+
+void VoiceEnvelope::fadeOut(float seconds) noexcept
+{
+    if (state == State::idle)
+        return;
+
+    const double numSamples = static_cast<double>(seconds) * sampleRate;
+    if (numSamples < 1.0 || level <= 0.0f)
+    {
+        reset();
+        return;
+    }
+    fadeOutStep = static_cast<float>(level / numSamples);
+    state = State::fadeOut;
+}
+
+void VoiceEnvelope::reset() noexcept
+{
+    state = State::idle;
+    level = 0.0f;
+}
+
+void VoiceEnvelope::enterDecayOrSustain() noexcept
+{
+    state = parameters.decay > 0.0f && level > parameters.sustain ? State::decay : State::sustain;
+    if (state == State::sustain)
+        level = parameters.sustain;
+}
+
+void VoiceEnvelope::render(float* gains, int numSamples, float scale) noexcept
+{
+    const bool exponential = parameters.curve == Curve::exponential;
+    int done = 0;
+    while (done < numSamples)
+    {
+        float* out = gains + done;
+        const int remaining = numSamples - done;
+        switch (state)
+        {
+            case State::idle:
+                juce::FloatVectorOperations::clear(out, remaining);
+                return;
+
+            case State::sustain:
+                level = parameters.sustain;
+                juce::FloatVectorOperations::fill(out, level * scale, remaining);
+                return;
+
+            case State::attack:
+                done += renderRamp(out, remaining, scale, attackStep, 1.0f);
+                if (level >= 1.0f)
+                    enterDecayOrSustain();
+                break;
+
+            case State::decay:
+                done += exponential ? renderExponential(out, remaining, scale, decayCoefficient, parameters.sustain)
+                                    : renderRamp(out, remaining, scale, -decayStep, parameters.sustain);
+                if (level <= parameters.sustain)
+                    state = State::sustain;
+                break;
+
+            case State::release:
+                done += exponential ? renderExponential(out, remaining, scale, releaseCoefficient, 0.0f)
+                                    : renderRamp(out, remaining, scale, -releaseStep, 0.0f);
+                if (level <= 0.0f)
+                    reset();
+                break;
+
+            case State::fadeOut:
+                done += renderRamp(out, remaining, scale, -fadeOutStep, 0.0f);
+                if (level <= 0.0f)
+                    reset();
+                break;
+        }
+    }
+}
+
+int VoiceEnvelope::renderRamp(float* gains, int numSamples, float scale, float step, float target) noexcept
+{
+    // Samples until the ramp reaches its target (at least one, so a segment always makes progress). The
+    // small allowance keeps rounding in step from adding a stray sample, whatever the block size.
+    const float distance = target - level;
+    const int toTarget = step != 0.0f && distance * step > 0.0f ? static_cast<int>(std::ceil(distance / step - 1.0e-3f)) : 1;
+    const int run = juce::jmin(numSamples, juce::jmax(1, toTarget));
+
+    // Values from the index, not accumulated: no loop-carried dependency.
+    const float start = level;
+    for (int i = 0; i < run; ++i)
+        gains[i] = (start + static_cast<float>(i + 1) * step) * scale;
+
+    if (run == toTarget || toTarget <= 1)
+    {
+        level = target;
+        gains[run - 1] = target * scale;
+    }
+    else
+    {
+        level = start + static_cast<float>(run) * step;
+    }
+    return run;
+}
+
+int VoiceEnvelope::renderExponential(float* gains, int numSamples, float scale, float coefficient, float target) noexcept
+{
+    // The distance to the target shrinks by coefficient per sample; within silenceLevel of it, the segment ends.
+    float distance = level - target;
+    int i = 0;
+    while (i < numSamples)
+    {
+        distance *= coefficient;
+        if (distance <= silenceLevel)
+        {
+            gains[i++] = target * scale;
+            level = target;
+            return i;
+        }
+        gains[i++] = (target + distance) * scale;
+    }
+    level = target + distance;
+    return i;
+}
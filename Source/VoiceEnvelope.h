@@ -0,0 +1,89 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Attack/decay/sustain/release envelope for one voice, rendered a block at a
+ *  time: render() fills the gains for a whole sub-block, which the voice then
+ *  applies to both channels in one pass. Each segment is a tight loop of its
+ *  own instead of a per-sample state switch.
+ *
+ *  Attacks are linear ramps. Decays and releases are linear, or with
+ *  Curve::exponential they fall by a constant factor per sample (a recursive
+ *  multiply), reaching -80 dB of their distance to the target in the
+ *  segment's time, like a piano string's decay.
+ */
+class VoiceEnvelope
+{
+public:
+    enum class Curve
+    {
+        linear,
+        exponential
+    };
+
+    struct Parameters
+    {
+        float attack = 0.1f;   // seconds
+        float decay = 0.3f;    // seconds
+        float sustain = 0.7f;  // level, 0..1
+        float release = 0.5f;  // seconds
+        Curve curve = Curve::linear;
+    };
+
+    /** Level treated as silence by exponential segments (-80 dB). */
+    static constexpr float silenceLevel = 1.0e-4f;
+
+    VoiceEnvelope();
+
+    void setSampleRate(double newSampleRate);
+    void setParameters(const Parameters& newParameters);
+    const Parameters& getParameters() const noexcept { return parameters; }
+
+    void noteOn() noexcept;
+    void noteOff() noexcept;
+    void reset() noexcept;
+
+    /** Linear ramp from the current level to silence in seconds, whatever the curve; a later noteOff() is
+        ignored. Used to silence a stolen voice without a click. */
+    void fadeOut(float seconds) noexcept;
+
+    bool isActive() const noexcept { return state != State::idle; }
+    bool isAttacking() const noexcept { return state == State::attack; }
+    bool isReleasing() const noexcept { return state == State::release || state == State::fadeOut; }
+    bool isFadingOut() const noexcept { return state == State::fadeOut; }
+    float getLevel() const noexcept { return level; }
+
+    /** gains[i] = scale × the envelope's next numSamples values. */
+    void render(float* gains, int numSamples, float scale) noexcept;
+
+private:
+    enum class State
+    {
+        idle,
+        attack,
+        decay,
+        sustain,
+        release,
+        fadeOut
+    };
+
+    void recalculate() noexcept;
+    void enterDecayOrSustain() noexcept;
+
+    int renderRamp(float* gains, int numSamples, float scale, float step, float target) noexcept;
+    int renderExponential(float* gains, int numSamples, float scale, float coefficient, float target) noexcept;
+
+    Parameters parameters;
+    double sampleRate = 44100.0;
+    State state = State::idle;
+    float level = 0.0f;
+
+    float attackStep = 0.0f;        // per sample
+    float decayStep = 0.0f;
+    float releaseStep = 0.0f;       // set at noteOff, from the level then
+    float fadeOutStep = 0.0f;       // set at fadeOut
+    float decayCoefficient = 0.0f;  // exponential: distance to the target is multiplied by this per sample
+    float releaseCoefficient = 0.0f;
+
+    JUCE_LEAK_DETECTOR(VoiceEnvelope)
+};
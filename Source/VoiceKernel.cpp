@@ -0,0 +1,224 @@
+#include "VoiceKernel.h"
+#include <array>
+#include <vector>
+
+namespace
+{
+    using VoiceKernel::Interpolation;
+
+    constexpr int kNumPhases = 128;
+    constexpr int kNumCutoffs = 9;      // ratios 1 .. 4 in quarter octaves
+    constexpr double kKaiserBeta = 7.0;
+    constexpr double kPassband = 0.92;  // lowered cutoffs as a fraction of the new Nyquist, leaving room for the window's roll-off
+
+    double besselI0(double x) noexcept
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // One windowed-sinc filter per cutoff; row p holds the taps for fractional position p / kNumPhases, with
+    // one extra row (p = kNumPhases) so the phase interpolation never wraps. Rows are normalised to unity DC gain.
+    struct SincTables
+    {
+        explicit SincTables(int taps) : numTaps(taps), coefficients(static_cast<size_t>(kNumCutoffs * (kNumPhases + 1) * taps))
+        {
+            const int half = taps / 2;
+            for (int c = 0; c < kNumCutoffs; ++c)
+            {
+                // Untransposed and downward voices keep the full band, so the phase-0 row is an exact copy.
+                const double cutoff = c == 0 ? 1.0 : kPassband / std::pow(2.0, c / 4.0);
+                for (int p = 0; p <= kNumPhases; ++p)
+                {
+                    float* row = getRow(c, p);
+                    const double frac = static_cast<double>(p) / kNumPhases;
+                    double sum = 0.0;
+                    for (int k = 0; k < taps; ++k)
+                    {
+                        const double x = k - (half - 1) - frac; // tap k reads frame index - (half - 1) + k
+                        const double sinc = std::abs(x) < 1.0e-9 ? 1.0
+                                                                 : std::sin(juce::MathConstants<double>::pi * cutoff * x)
+                                                                       / (juce::MathConstants<double>::pi * cutoff * x);
+                        const double w = x / half;
+                        const double window = std::abs(w) >= 1.0 ? 0.0 : besselI0(kKaiserBeta * std::sqrt(1.0 - w * w)) / besselI0(kKaiserBeta);
+                        row[k] = static_cast<float>(sinc * window);
+                        sum += row[k];
+                    }
+                    for (int k = 0; k < taps; ++k)
+                        row[k] = static_cast<float>(row[k] / sum);
+                }
+            }
+        }
+
+        float* getRow(int cutoff, int phase) noexcept
+        {
+            return coefficients.data() + static_cast<size_t>((cutoff * (kNumPhases + 1) + phase) * numTaps);
+        }
+
+        const float* getRow(int cutoff, int phase) const noexcept
+        {
+            return coefficients.data() + static_cast<size_t>((cutoff * (kNumPhases + 1) + phase) * numTaps);
+        }
+
+        // The table whose cutoff is at or below what ratio needs (the highest one above 4x transposition).
+        static int cutoffFor(double ratio) noexcept
+        {
+            return ratio <= 1.0 ? 0 : juce::jmin(kNumCutoffs - 1, static_cast<int>(std::ceil(std::log2(ratio) * 4.0 - 1.0e-6)));
+        }
+
+        int numTaps;
+        std::vector<float> coefficients;
+    };
+
+    const SincTables& getSincTables(int taps)
+    {
+        static const SincTables sinc8(8), sinc16(16);
+        return taps == 8 ? sinc8 : sinc16;
+    }
+
+    // One channel at src[index + t], 0 <= t < 1. src[0] is the integer voice position.
+    struct Linear
+    {
+        static float read(const float* src, int index, float t) noexcept { return src[index] + t * (src[index + 1] - src[index]); }
+    };
+
+    struct Hermite
+    {
+        static float read(const float* src, int index, float t) noexcept
+        {
+            const float ym1 = src[index - 1], y0 = src[index], y1 = src[index + 1], y2 = src[index + 2];
+            const float c1 = 0.5f * (y1 - ym1);
+            const float c2 = ym1 - 2.5f * y0 + 2.0f * y1 - 0.5f * y2;
+            const float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+            return ((c3 * t + c2) * t + c1) * t + y0;
+        }
+    };
+
+    // Positions are computed from i rather than accumulated, so the loop carries no dependency and
+    // float precision holds over a sub-block; the voice advances its double position per sub-block.
+    template <typename Interpolator, bool Stereo>
+    void mixPolynomial(const float* srcL, const float* srcR, const float* gains, int numFrames,
+                       double phase, double ratio, float* outL, float* outR) noexcept
+    {
+        const auto start = static_cast<float>(phase);
+        const auto step = static_cast<float>(ratio);
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const float pos = start + static_cast<float>(i) * step;
+            const auto index = static_cast<int>(pos);
+            const float t = pos - static_cast<float>(index);
+            const float l = Interpolator::read(srcL, index, t);
+            const float r = Interpolator::read(srcR, index, t);
+            if (Stereo)
+            {
+                outL[i] += l * gains[i];
+                outR[i] += r * gains[i];
+            }
+            else
+            {
+                outL[i] += (l + r) * 0.5f * gains[i];
+            }
+        }
+    }
+
+    template <typename Interpolator>
+    void mixPolynomial(const float* srcL, const float* srcR, const float* gains, int numFrames,
+                       double phase, double ratio, float* outL, float* outR) noexcept
+    {
+        if (outR != nullptr)
+            mixPolynomial<Interpolator, true>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+        else
+            mixPolynomial<Interpolator, false>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+    }
+
+    template <int Taps, bool Stereo>
+    void mixSinc(const float* srcL, const float* srcR, const float* gains, int numFrames,
+                 double phase, double ratio, float* outL, float* outR) noexcept
+    {
+        const auto& tables = getSincTables(Taps);
+        const int cutoff = SincTables::cutoffFor(ratio);
+        const auto start = static_cast<float>(phase);
+        const auto step = static_cast<float>(ratio);
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const float pos = start + static_cast<float>(i) * step;
+            const auto index = static_cast<int>(pos);
+            const float p = (pos - static_cast<float>(index)) * kNumPhases;
+            const auto row = juce::jmin(kNumPhases - 1, static_cast<int>(p));
+            const float blend = p - static_cast<float>(row);
+            const float* c0 = tables.getRow(cutoff, row);
+            const float* c1 = c0 + Taps;
+            const float* l = srcL + index - (Taps / 2 - 1);
+            const float* r = srcR + index - (Taps / 2 - 1);
+
+            // Fixed-length dot products over contiguous taps: these are the loops the compiler vectorises.
+            float sumL = 0.0f, sumR = 0.0f;
+            for (int k = 0; k < Taps; ++k)
+            {
+                const float c = c0[k] + blend * (c1[k] - c0[k]);
+                sumL += c * l[k];
+                sumR += c * r[k];
+            }
+
+            if (Stereo)
+            {
+                outL[i] += sumL * gains[i];
+                outR[i] += sumR * gains[i];
+            }
+            else
+            {
+                outL[i] += (sumL + sumR) * 0.5f * gains[i];
+            }
+        }
+    }
+
+    template <int Taps>
+    void mixSinc(const float* srcL, const float* srcR, const float* gains, int numFrames,
+                 double phase, double ratio, float* outL, float* outR) noexcept
+    {
+        if (outR != nullptr)
+            mixSinc<Taps, true>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+        else
+            mixSinc<Taps, false>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+    }
+}
+
+void VoiceKernel::prepareTables()
+{
+    getSincTables(8);
+    getSincTables(16);
+}
+
+void VoiceKernel::mix(Interpolation q, const float* srcL, const float* srcR, const float* gains, int numFrames,
+                      double phase, double ratio, float* outL, float* outR) noexcept
+{
+    if (phase == 0.0 && ratio == 1.0)
+    {
+        if (outR != nullptr)
+        {
+            juce::FloatVectorOperations::addWithMultiply(outL, srcL, gains, numFrames);
+            juce::FloatVectorOperations::addWithMultiply(outR, srcR, gains, numFrames);
+        }
+        else
+        {
+            for (int i = 0; i < numFrames; ++i)
+                outL[i] += (srcL[i] + srcR[i]) * 0.5f * gains[i];
+        }
+        return;
+    }
+
+    switch (q)
+    {
+        case Interpolation::hermite: return mixPolynomial<Hermite>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+        case Interpolation::sinc8:   return mixSinc<8>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+        case Interpolation::sinc16:  return mixSinc<16>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+        case Interpolation::linear:
+        default:                     return mixPolynomial<Linear>(srcL, srcR, gains, numFrames, phase, ratio, outL, outR);
+    }
+}
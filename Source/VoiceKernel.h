@@ -0,0 +1,51 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/** The inner loop of MatildaSamplerVoice: interpolation, gain and mixing of one
+ *  span of float source frames in a single pass over the output, accumulated
+ *  straight into the output buffer.
+ *
+ *  The voice converts the source frames a sub-block needs into a float scratch
+ *  first (SamplePcm::readFrames), so the kernel never branches on encoding,
+ *  looping or streaming and never reads past its span.
+ */
+namespace VoiceKernel
+{
+    /** Resampling quality, from cheapest to best. The sinc modes are Kaiser-windowed and polyphase: 128
+        precomputed phases per table (interpolated between), with the cutoff lowered in quarter-octave
+        steps as the voice transposes up, so high keys don't alias. */
+    enum class Interpolation
+    {
+        linear,   // 2 taps
+        hermite,  // 4-point, 3rd-order Hermite
+        sinc8,
+        sinc16
+    };
+
+    constexpr int getNumTaps(Interpolation q) noexcept
+    {
+        return q == Interpolation::linear ? 2 : (q == Interpolation::hermite ? 4 : (q == Interpolation::sinc8 ? 8 : 16));
+    }
+
+    /** Frames the interpolator reads before the one at the integer position. */
+    constexpr int getHistoryFrames(Interpolation q) noexcept { return getNumTaps(q) / 2 - 1; }
+
+    /** Source frames one sub-block reads, starting getHistoryFrames() before the integer position: numFrames
+        outputs from fractional position phase (0 <= phase < 1) at ratio source frames per output frame, with
+        the taps around each, and a guard frame for the kernel's float positions rounding up. */
+    inline int sourceFramesNeeded(double phase, double ratio, int numFrames, Interpolation q = Interpolation::linear) noexcept
+    {
+        return static_cast<int>(phase + (numFrames - 1) * ratio) + getNumTaps(q) + 1;
+    }
+
+    /** Builds the sinc tables (about 110 KB). Called by the voice's constructor, so the audio thread never does it. */
+    void prepareTables();
+
+    /** outL/outR[i] += srcL/srcR interpolated at phase + i * ratio, times gains[i], for i < numFrames.
+        With outR == nullptr the two channels are mixed into outL at half level. src frame 0 is the integer part
+        of the voice position; the getHistoryFrames() before it must be readable too. A ratio of exactly 1 with
+        no phase is a straight multiply-add in every mode. */
+    void mix(Interpolation q, const float* srcL, const float* srcR, const float* gains, int numFrames,
+             double phase, double ratio, float* outL, float* outR) noexcept;
+}
@@ -0,0 +1,211 @@
+#include "VoiceRenderPool.h"
+
+namespace
+{
+    constexpr int kSpinIterations = 2000;   // a worker polls this long for the next block before sleeping
+    constexpr int kSleepTimeoutMs = 50;
+
+    constexpr juce::uint64 pack(juce::uint64 cycle, int numJobs, int nextJob) noexcept
+    {
+        return (cycle << 32) | (static_cast<juce::uint64>(numJobs) << 16) | static_cast<juce::uint64>(nextJob);
+    }
+}
+
+class VoiceRenderPool::Worker : private juce::Thread
+{
+public:
+    Worker(VoiceRenderPool& poolToUse, int index, int maxBlockSize, int numChannels)
+        : juce::Thread("Matilda voice renderer " + juce::String(index + 1)),
+          pool(poolToUse), bus(numChannels, maxBlockSize)
+    {
+    }
+
+    ~Worker() override
+    {
+        signalThreadShouldExit();
+        wake.signal();
+        stopThread(2000);
+    }
+
+    /** Starts the thread at real-time priority; false (and not started) where the platform won't allow it. */
+    bool start() { return startRealtimeThread(juce::Thread::RealtimeOptions {}.withPriority(10)); }
+
+    /** Audio thread: a new cycle is published; wake this worker if it went to sleep. */
+    void notifyWork() noexcept
+    {
+        if (sleeping.load(std::memory_order_acquire))
+            wake.signal();
+    }
+
+    /** Audio thread, after the cycle's jobs are done: this worker's bus holds voices from cycle. */
+    bool renderedCycle(juce::uint64 cycle) const noexcept { return busCycle.load(std::memory_order_acquire) == cycle; }
+
+    const juce::AudioBuffer<float>& getBus() const noexcept { return bus; }
+
+private:
+    void run() override
+    {
+        juce::WorkgroupToken token;
+        int joinedVersion = -1;
+        int idle = 0;
+        while (!threadShouldExit())
+        {
+            // Join the host's workgroup, so the OS schedules us with the audio thread that waits for us.
+            if (const int version = pool.workgroupVersion.load(std::memory_order_acquire); version != joinedVersion)
+            {
+                token.reset();
+                const juce::ScopedLock sl(pool.workgroupLock);
+                if (pool.workgroup)
+                    pool.workgroup.join(token);
+                joinedVersion = version;
+            }
+
+            const auto state = pool.dispatch.load(std::memory_order_acquire);
+            if ((state & 0xffff) < ((state >> 16) & 0xffff))
+            {
+                idle = 0;
+                renderClaimedJobs();
+                continue;
+            }
+
+            if (++idle < kSpinIterations)
+                continue;
+
+            sleeping.store(true, std::memory_order_release);
+            // Re-check after announcing we sleep, so a cycle published in between isn't missed.
+            const auto again = pool.dispatch.load(std::memory_order_acquire);
+            if ((again & 0xffff) >= ((again >> 16) & 0xffff))
+                wake.wait(kSleepTimeoutMs);
+            sleeping.store(false, std::memory_order_release);
+            idle = 0;
+        }
+    }
+
+    void renderClaimedJobs() noexcept
+    {
+        juce::uint64 cycle = 0;
+        for (int job; (job = pool.claimJob(cycle)) >= 0;)
+        {
+            // A claim pins its cycle: the audio thread can't sum this bus or start another cycle until the job is done.
+            if (busCycle.load(std::memory_order_relaxed) != cycle)
+            {
+                bus.clear(0, pool.jobNumSamples);
+                busCycle.store(cycle, std::memory_order_relaxed);
+            }
+            pool.jobs[static_cast<size_t>(job)]->renderNextBlock(bus, 0, pool.jobNumSamples);
+            pool.pendingJobs.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    VoiceRenderPool& pool;
+    juce::AudioBuffer<float> bus;
+    juce::WaitableEvent wake;
+    std::atomic<bool> sleeping { false };
+    std::atomic<juce::uint64> busCycle { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(Worker)
+};
+
+int VoiceRenderPool::getSuggestedNumWorkers()
+{
+    return juce::jlimit(0, 3, juce::SystemStats::getNumCpus() / 2 - 1);
+}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+    release();
+}
+
+void VoiceRenderPool::prepare(int numWorkers, int maxBlockSize, int numChannels, int maxVoices)
+{
+    numWorkers = juce::jlimit(0, maxWorkers, numWorkers);
+    if (numWorkers == getNumWorkers() && maxBlockSize <= busSize && numChannels == busChannels
+        && static_cast<size_t>(maxVoices) <= jobs.capacity())
+        return;
+
+    release();
+    busSize = maxBlockSize;
+    busChannels = numChannels;
+    jobs.reserve(static_cast<size_t>(juce::jlimit(0, 0xffff, maxVoices)));
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        // The audio thread waits on claimed voices, so a worker that could be preempted by ordinary threads isn't run.
+        auto worker = std::make_unique<Worker>(*this, i, maxBlockSize, numChannels);
+        if (!worker->start())
+            break;
+        workers.push_back(std::move(worker));
+    }
+}
+
+void VoiceRenderPool::setWorkgroup(const juce::AudioWorkgroup& newWorkgroup)
+{
+    {
+        const juce::ScopedLock sl(workgroupLock);
+        workgroup = newWorkgroup;
+    }
+    workgroupVersion.fetch_add(1, std::memory_order_release);
+}
+
+void VoiceRenderPool::release()
+{
+    workers.clear();
+}
+
+int VoiceRenderPool::claimJob(juce::uint64& cycle) noexcept
+{
+    auto state = dispatch.load(std::memory_order_acquire);
+    for (;;)
+    {
+        const auto next = static_cast<int>(state & 0xffff);
+        if (next >= static_cast<int>((state >> 16) & 0xffff))
+            return -1;
+        if (dispatch.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            cycle = state >> 32;
+            return next;
+        }
+    }
+}
+
+bool VoiceRenderPool::render(const std::vector<juce::SynthesiserVoice*>& activeVoices, juce::AudioBuffer<float>& output,
+                             int startSample, int numSamples) noexcept
+{
+    const auto numJobs = activeVoices.size();
+    if (workers.empty() || numJobs < static_cast<size_t>(minVoicesForWorkers) || numSamples > busSize
+        || output.getNumChannels() > busChannels || numJobs > jobs.capacity())
+        return false;
+
+    // Publish: the job list first, then the cycle (release), so a claim sees the whole description.
+    jobs.assign(activeVoices.begin(), activeVoices.end()); // within capacity: no allocation
+    jobNumSamples = numSamples;
+    pendingJobs.store(static_cast<int>(numJobs), std::memory_order_relaxed);
+    const auto cycle = (dispatch.load(std::memory_order_relaxed) >> 32) + 1;
+    dispatch.store(pack(cycle, static_cast<int>(numJobs), 0), std::memory_order_release);
+    for (auto& worker : workers)
+        worker->notifyWork();
+
+    // Work alongside them, straight into the output.
+    juce::uint64 claimedCycle = 0;
+    for (int job; (job = claimJob(claimedCycle)) >= 0;)
+    {
+        jobs[static_cast<size_t>(job)]->renderNextBlock(output, startSample, numSamples);
+        pendingJobs.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Only voices a worker already claimed are left; wait for those, then sum the buses that were used.
+    while (pendingJobs.load(std::memory_order_acquire) > 0)
+    {
+        // Spin: the jobs left are already running on real-time workers scheduled with us, and blocking here could
+        // only make the block later.
+    }
+
+    for (auto& worker : workers)
+    {
+        if (!worker->renderedCycle(cycle))
+            continue;
+        const auto& bus = worker->getBus();
+        for (int ch = 0; ch < output.getNumChannels(); ++ch)
+            juce::FloatVectorOperations::add(output.getWritePointer(ch, startSample), bus.getReadPointer(ch), numSamples);
+    }
+    return true;
+}
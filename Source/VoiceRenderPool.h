@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <JuceHeader.h>
+
+/** Renders a block's active voices on a few real-time worker threads plus the
+ *  audio thread itself, for dense, sustained playing where one core can't keep
+ *  up.
+ *
+ *  Dispatch is lock-free. The audio thread publishes the job list and one
+ *  packed atomic (cycle, job count, next job). Every thread, the audio thread
+ *  included, claims voices from it with a compare-and-swap until none are
+ *  left. So a block always completes even if no worker wakes up in time. A
+ *  worker renders into its own bus; the audio thread renders straight into
+ *  the output, waits for the voices the workers claimed, then adds the used
+ *  buses in.
+ *
+ *  The audio thread spins for voices a worker has claimed, so workers only
+ *  run at real-time priority: one that can't get it isn't started. They join
+ *  the host's audio workgroup when it provides one, and the scheduler places
+ *  them (no core pinning, which several instances would pile onto the same
+ *  cores). The pool is off until opted into.
+ *
+ *  Workers spin briefly for the next block before sleeping. The audio thread
+ *  only signals one that is asleep.
+ */
+class VoiceRenderPool
+{
+public:
+    static constexpr int maxWorkers = 7;
+
+    /** Fewer active voices than this are rendered on the audio thread alone: waking workers costs more. */
+    static constexpr int minVoicesForWorkers = 8;
+
+    /** A sensible count to opt into: half the cores, less the audio thread, at most 3. */
+    static int getSuggestedNumWorkers();
+
+    VoiceRenderPool() = default;
+    ~VoiceRenderPool();
+
+    /** Off the audio thread (or with rendering locked out): starts up to numWorkers threads (0 = none) with buses
+        for blocks of up to maxBlockSize samples, and room for maxVoices jobs. Stops at the first thread that can't
+        get real-time priority. */
+    void prepare(int numWorkers, int maxBlockSize, int numChannels, int maxVoices);
+    void release();
+
+    /** Any thread but the audio thread: the host's audio workgroup, which the workers join (a default one = none). */
+    void setWorkgroup(const juce::AudioWorkgroup& newWorkgroup);
+
+    int getNumWorkers() const noexcept { return static_cast<int>(workers.size()); }
+
+    /** Audio thread: adds every voice's output to output[startSample, startSample + numSamples). Returns false, having
+        rendered nothing, if the pool can't take this block (no workers, too few voices, block too long or too many
+        voices); the caller then renders serially. */
+    bool render(const std::vector<juce::SynthesiserVoice*>& activeVoices, juce::AudioBuffer<float>& output,
+                int startSample, int numSamples) noexcept;
+
+private:
+    class Worker;
+
+    /** Next unclaimed job of the current cycle (and that cycle), or -1 when all are taken. Any thread. */
+    int claimJob(juce::uint64& cycle) noexcept;
+
+    // Current cycle: bits 32..63 cycle number, 16..31 job count, 0..15 next unclaimed job.
+    std::atomic<juce::uint64> dispatch { 0 };
+    std::atomic<int> pendingJobs { 0 };
+
+    // Job description: written by the audio thread before dispatch is stored (release), read after a claim (acquire).
+    std::vector<juce::SynthesiserVoice*> jobs;
+    int jobNumSamples = 0;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    juce::CriticalSection workgroupLock;
+    juce::AudioWorkgroup workgroup;
+    std::atomic<int> workgroupVersion { 0 }; // workers rejoin when it moves
+    int busSize = 0;
+    int busChannels = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceRenderPool)
+};
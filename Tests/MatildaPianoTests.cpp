@@ -4,10 +4,23 @@
  * Or add as a run target in your IDE.
  */
 #include <JuceHeader.h>
+#include "../Source/OutputStage.h"
+#include "../Source/PageWarmer.h"
 #include "../Source/Parameters.h"
+#include "../Source/ParameterRamp.h"
+#include "../Source/ParameterSnapshot.h"
 #include "../Source/PluginProcessor.h"
+#include "../Source/SampleLoops.h"
+#include "../Source/SampleNaming.h"
+#include "../Source/UiMidiQueue.h"
+#include "../Source/VoiceEnvelope.h"
+#include "../Source/VoiceKernel.h"
 #include <cstdlib>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 static int runParameterLayoutTests()
 {
@@ -76,6 +89,2029 @@ static int runParameterLayoutTests()
     return failed;
 }
 
+static int runParameterSnapshotTests()
+{
+    int failed = 0;
+
+    MatildaPianoAudioProcessor processor;
+    auto& state = processor.getValueTreeState();
+    ParameterSnapshot snapshot(state);
+
+    auto set = [&state](const char* id, float value)
+    {
+        auto* parameter = state.getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    };
+
+    struct Case { const char* what; juce::uint32 expected; };
+    auto check = [&](const Case& c)
+    {
+        const auto dirty = snapshot.update();
+        if (dirty != c.expected)
+        {
+            std::cerr << "FAIL: parameter snapshot after " << c.what << " reported groups " << dirty
+                      << ", expected " << c.expected << "\n";
+            ++failed;
+        }
+    };
+
+    check({ "construction", ParameterSnapshot::allGroups });
+    check({ "an idle block", 0 });
+
+    set(Parameters::SUSTAIN, 0.25f);
+    check({ "a sustain change", ParameterSnapshot::envelope });
+    if (std::abs(snapshot.get().sustain - 0.25f) > 1.0e-4f)
+    {
+        std::cerr << "FAIL: parameter snapshot holds sustain " << snapshot.get().sustain << ", expected 0.25\n";
+        ++failed;
+    }
+
+    set(Parameters::XY_Y, 0.9f);
+    check({ "an XY pad move", ParameterSnapshot::tape | ParameterSnapshot::reverb });
+
+    set(Parameters::MASTER_VOL, 0.5f);
+    set(Parameters::DELAY_TIME, 0.2f);
+    check({ "master and delay changes", ParameterSnapshot::master | ParameterSnapshot::delay });
+    check({ "another idle block", 0 });
+
+    snapshot.markAllDirty();
+    check({ "markAllDirty()", ParameterSnapshot::allGroups });
+
+    return failed;
+}
+
+static int runSessionStateTests()
+{
+    int failed = 0;
+
+    juce::MemoryBlock saved;
+    {
+        MatildaPianoAudioProcessor processor;
+        processor.setSampleStreaming(true, 400.0);
+        processor.setSampleTrimming(false, -70.0f);
+        processor.setSamplePreResampling(true);
+        auto* sustain = processor.getValueTreeState().getParameter(Parameters::SUSTAIN);
+        sustain->setValueNotifyingHost(sustain->convertTo0to1(0.25f));
+        processor.getStateInformation(saved);
+    }
+
+    MatildaPianoAudioProcessor processor;
+    processor.setStateInformation(saved.getData(), static_cast<int>(saved.getSize()));
+
+    if (!processor.isSampleStreamingEnabled() || processor.isSampleTrimmingEnabled()
+        || !processor.isSamplePreResamplingEnabled() || processor.isSampleMemoryMappingEnabled())
+    {
+        std::cerr << "FAIL: restored session has streaming " << processor.isSampleStreamingEnabled()
+                  << ", trimming " << processor.isSampleTrimmingEnabled()
+                  << ", pre-resampling " << processor.isSamplePreResamplingEnabled()
+                  << ", memory mapping " << processor.isSampleMemoryMappingEnabled()
+                  << ", expected 1, 0, 1, 0\n";
+        ++failed;
+    }
+
+    auto& state = processor.getValueTreeState();
+    auto* sustainParameter = state.getParameter(Parameters::SUSTAIN);
+    const float sustain = sustainParameter->convertFrom0to1(sustainParameter->getValue());
+    if (std::abs(sustain - 0.25f) > 1.0e-3f)
+    {
+        std::cerr << "FAIL: restored session has sustain " << sustain << ", expected 0.25\n";
+        ++failed;
+    }
+
+    // The sample settings are not part of the parameter state afterwards
+    if (state.state.getChildWithName("SAMPLE_OPTIONS").isValid())
+    {
+        std::cerr << "FAIL: sample settings left in the parameter state after a restore\n";
+        ++failed;
+    }
+
+    // A session saved before the sample settings were stored leaves them alone
+    {
+        auto xml = state.copyState().createXml();
+        juce::MemoryBlock old;
+        juce::AudioProcessor::copyXmlToBinary(*xml, old);
+        MatildaPianoAudioProcessor fresh;
+        fresh.setStateInformation(old.getData(), static_cast<int>(old.getSize()));
+        if (fresh.isSampleStreamingEnabled() || !fresh.isSampleTrimmingEnabled())
+        {
+            std::cerr << "FAIL: a session without sample settings changed them\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runParameterRampTests()
+{
+    int failed = 0;
+    constexpr double sampleRate = 48000.0;
+    constexpr int rampSamples = 960; // defaultRampSeconds at 48 kHz
+
+    // Linear: rises monotonically, lands on the target exactly on time, then holds.
+    {
+        ParameterRamp ramp(0.0f);
+        ramp.prepare(sampleRate, 64);
+        ramp.setTarget(1.0f);
+
+        float previous = 0.0f;
+        bool monotonic = true;
+        int reachedAt = -1;
+        for (int done = 0; done < 1024; done += 64)
+        {
+            const float* values = ramp.getNextValues(64);
+            for (int i = 0; i < 64; ++i)
+            {
+                monotonic = monotonic && values[i] >= previous;
+                previous = values[i];
+                if (reachedAt < 0 && values[i] == 1.0f)
+                    reachedAt = done + i + 1;
+            }
+        }
+        if (!monotonic || reachedAt != rampSamples || ramp.isSmoothing() || ramp.getCurrentValue() != 1.0f)
+        {
+            std::cerr << "FAIL: linear ramp reached its target after " << reachedAt << " samples (expected "
+                      << rampSamples << ", monotonic " << monotonic << ")\n";
+            ++failed;
+        }
+    }
+
+    // Multiplicative: equal steps in dB, so halfway in time is halfway in dB.
+    {
+        ParameterRamp ramp(0.01f, ParameterRamp::Shape::multiplicative);
+        ramp.prepare(sampleRate, 480);
+        ramp.setTarget(1.0f);
+
+        const float* values = ramp.getNextValues(480);
+        const float midDb = juce::Decibels::gainToDecibels(values[479]);
+        const float firstRatio = values[1] / values[0];
+        const float lastRatio = values[479] / values[478];
+        if (std::abs(midDb + 20.0f) > 0.05f || std::abs(firstRatio - lastRatio) > 1.0e-5f)
+        {
+            std::cerr << "FAIL: multiplicative ramp at mid-ramp is " << midDb << " dB (expected -20), step ratios "
+                      << firstRatio << " / " << lastRatio << "\n";
+            ++failed;
+        }
+
+        values = ramp.getNextValues(480);
+        if (values[479] != 1.0f || ramp.isSmoothing())
+        {
+            std::cerr << "FAIL: multiplicative ramp ended at " << values[479] << ", expected 1\n";
+            ++failed;
+        }
+    }
+
+    // skip() lands where rendering the same samples does, mid-ramp and across its end.
+    for (const auto shape : { ParameterRamp::Shape::linear, ParameterRamp::Shape::multiplicative })
+    {
+        ParameterRamp rendered(0.2f, shape), skipped(0.2f, shape);
+        rendered.prepare(sampleRate, 64);
+        skipped.prepare(sampleRate, 64);
+        rendered.setTarget(0.8f);
+        skipped.setTarget(0.8f);
+
+        for (const int n : { 37, 64, 500 })
+        {
+            for (int done = 0; done < n; done += 64)
+                rendered.getNextValues(juce::jmin(64, n - done));
+            skipped.skip(n);
+            if (std::abs(rendered.getCurrentValue() - skipped.getCurrentValue()) > 1.0e-5f)
+            {
+                std::cerr << "FAIL: ramp skip(" << n << ") is at " << skipped.getCurrentValue() << ", rendering is at "
+                          << rendered.getCurrentValue() << "\n";
+                ++failed;
+            }
+        }
+    }
+
+    // applyGain() scales every channel by the same values.
+    {
+        ParameterRamp ramp(1.0f, ParameterRamp::Shape::multiplicative);
+        ramp.prepare(sampleRate, 64);
+        ramp.setTarget(0.5f);
+
+        juce::AudioBuffer<float> buffer(2, 64);
+        for (int ch = 0; ch < 2; ++ch)
+            juce::FloatVectorOperations::fill(buffer.getWritePointer(ch), 1.0f, 64);
+        juce::dsp::AudioBlock<float> block(buffer);
+        ramp.applyGain(block);
+
+        ParameterRamp reference(1.0f, ParameterRamp::Shape::multiplicative);
+        reference.prepare(sampleRate, 64);
+        reference.setTarget(0.5f);
+        const float* expected = reference.getNextValues(64);
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            for (int i = 0; i < 64; ++i)
+            {
+                if (buffer.getSample(ch, i) != expected[i])
+                {
+                    std::cerr << "FAIL: ramp applyGain() channel " << ch << " sample " << i << " is "
+                              << buffer.getSample(ch, i) << ", expected " << expected[i] << "\n";
+                    ++failed;
+                    break;
+                }
+            }
+        }
+    }
+
+    return failed;
+}
+
+static int runUiMidiQueueTests()
+{
+    int failed = 0;
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 480; // 10 ms
+
+    // Events land as far before the end of the block as they happened before it started, clamped to the block.
+    {
+        UiMidiQueue queue;
+        const double nowMs = 1000.0;
+        struct Case { double timeMs; int note; int expectedOffset; };
+        const Case cases[] = { { 975.0, 60, 0 }, { 990.0, 61, 0 }, { 995.0, 62, 240 }, { 999.5, 63, 456 }, { 1001.0, 64, 479 } };
+        for (const auto& c : cases)
+            queue.push(juce::MidiMessage::noteOn(1, c.note, static_cast<juce::uint8>(c.note)), c.timeMs);
+
+        juce::MidiBuffer midi;
+        queue.popInto(midi, blockSize, sampleRate, nowMs);
+
+        int i = 0;
+        for (const auto metadata : midi)
+        {
+            const auto message = metadata.getMessage();
+            const auto& c = cases[juce::jmin(i, 4)];
+            if (i >= 5 || message.getNoteNumber() != c.note || message.getVelocity() != c.note
+                || metadata.samplePosition != c.expectedOffset)
+            {
+                std::cerr << "FAIL: UI MIDI event " << i << " is note " << message.getNoteNumber() << " velocity "
+                          << static_cast<int>(message.getVelocity()) << " at " << metadata.samplePosition
+                          << ", expected note " << c.note << " at " << c.expectedOffset << "\n";
+                ++failed;
+            }
+            ++i;
+        }
+        if (i != 5)
+        {
+            std::cerr << "FAIL: UI MIDI queue delivered " << i << " events, expected 5\n";
+            ++failed;
+        }
+
+        juce::MidiBuffer next;
+        queue.popInto(next, blockSize, sampleRate, nowMs + 10.0);
+        if (!next.isEmpty())
+        {
+            std::cerr << "FAIL: UI MIDI queue delivered events twice\n";
+            ++failed;
+        }
+    }
+
+    // A keyboard state feeds it note-ons with their velocity and note-offs.
+    {
+        UiMidiQueue queue;
+        juce::MidiKeyboardState keyboard;
+        keyboard.addListener(&queue);
+        keyboard.noteOn(1, 60, 0.5f);
+        keyboard.noteOff(1, 60, 0.0f);
+        keyboard.removeListener(&queue);
+
+        juce::MidiBuffer midi;
+        queue.popInto(midi, blockSize, sampleRate);
+        std::vector<juce::MidiMessage> messages;
+        for (const auto metadata : midi)
+            messages.push_back(metadata.getMessage());
+        if (messages.size() != 2 || !messages[0].isNoteOn() || messages[0].getNoteNumber() != 60
+            || std::abs(messages[0].getFloatVelocity() - 0.5f) > 1.0f / 127.0f || !messages[1].isNoteOff())
+        {
+            std::cerr << "FAIL: keyboard state should queue a note-on at velocity 0.5 and a note-off\n";
+            ++failed;
+        }
+    }
+
+    // A full queue refuses more events rather than overwriting queued ones.
+    {
+        UiMidiQueue queue;
+        int accepted = 0;
+        for (int i = 0; i < UiMidiQueue::queueSize + 8; ++i)
+            accepted += queue.push(juce::MidiMessage::noteOn(1, i % 128, 0.5f), 0.0) ? 1 : 0;
+        juce::MidiBuffer midi;
+        queue.popInto(midi, blockSize, sampleRate, 0.0);
+        if (accepted >= UiMidiQueue::queueSize + 8 || midi.getNumEvents() != accepted)
+        {
+            std::cerr << "FAIL: UI MIDI queue accepted " << accepted << " events and delivered " << midi.getNumEvents()
+                      << "\n";
+            ++failed;
+        }
+    }
+
+    // A note-off that finds the queue full is still sent, after everything queued.
+    {
+        UiMidiQueue queue;
+        for (int i = 0; i < UiMidiQueue::queueSize; ++i)
+            queue.push(juce::MidiMessage::noteOn(1, 60, 0.5f), 1000.0);
+        const bool keptNoteOff = queue.push(juce::MidiMessage::noteOff(2, 60), 1000.0);
+        juce::MidiBuffer midi;
+        queue.popInto(midi, blockSize, sampleRate, 1000.0);
+        juce::MidiMessage last;
+        for (const auto metadata : midi)
+            last = metadata.getMessage();
+        if (!keptNoteOff || !last.isNoteOff() || last.getChannel() != 2 || last.getNoteNumber() != 60)
+        {
+            std::cerr << "FAIL: a note-off pushed into a full UI MIDI queue was lost\n";
+            ++failed;
+        }
+    }
+
+    // Events from before the host stopped processing: note-ons are dropped, note-offs still sent.
+    {
+        UiMidiQueue queue;
+        queue.push(juce::MidiMessage::noteOn(1, 60, 0.5f), 500.0);
+        queue.push(juce::MidiMessage::noteOff(1, 60), 600.0);
+        queue.push(juce::MidiMessage::noteOn(1, 62, 0.5f), 975.0); // within staleBlocks
+        juce::MidiBuffer midi;
+        queue.popInto(midi, blockSize, sampleRate, 1000.0);
+        std::vector<juce::MidiMessage> messages;
+        for (const auto metadata : midi)
+            messages.push_back(metadata.getMessage());
+        if (messages.size() != 2 || !messages[0].isNoteOff() || messages[0].getNoteNumber() != 60
+            || !messages[1].isNoteOn() || messages[1].getNoteNumber() != 62)
+        {
+            std::cerr << "FAIL: stale UI MIDI should drop the old note-on and keep the note-off (" << messages.size()
+                      << " events)\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runOutputStageTests()
+{
+    int failed = 0;
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+
+    // Renders numBlocks of a 220 Hz sine at amplitude in, through stage, into out (mono).
+    auto run = [&](OutputStage& stage, float amplitude, int numBlocks, std::vector<float>& in, std::vector<float>& out)
+    {
+        in.resize(static_cast<size_t>(numBlocks * blockSize));
+        out.resize(in.size());
+        for (size_t i = 0; i < in.size(); ++i)
+            in[i] = amplitude * std::sin(juce::MathConstants<float>::twoPi * 220.0f * static_cast<float>(i) / static_cast<float>(sampleRate));
+        out = in;
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            float* channels[] = { out.data() + b * blockSize };
+            juce::dsp::AudioBlock<float> block(channels, 1, static_cast<size_t>(blockSize));
+            stage.process(block);
+        }
+    };
+
+    std::vector<float> in, out;
+
+    // Below the ceiling the stage is just the gain.
+    {
+        OutputStage stage(0.5f);
+        stage.prepare(sampleRate, blockSize);
+        run(stage, 0.8f, 20, in, out);
+        float worst = 0.0f;
+        for (size_t i = 0; i < in.size(); ++i)
+            worst = juce::jmax(worst, std::abs(out[i] - 0.5f * in[i]));
+        if (worst > 1.0e-6f || stage.getLimiterGain() != 1.0f)
+        {
+            std::cerr << "FAIL: output stage below the ceiling is off the plain gain by " << worst << "\n";
+            ++failed;
+        }
+    }
+
+    // Four times too loud: never past full scale, and once the limiter has caught up the waveform is the input
+    // turned down (peaks at the ceiling), not clipped.
+    {
+        OutputStage stage(1.0f);
+        stage.prepare(sampleRate, blockSize);
+        run(stage, 4.0f, 200, in, out);
+
+        float outPeak = 0.0f, settledPeak = 0.0f, worstShape = 0.0f;
+        const float settledGain = stage.getLimiterGain();
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            outPeak = juce::jmax(outPeak, std::abs(out[i]));
+            if (i >= in.size() / 2)
+            {
+                settledPeak = juce::jmax(settledPeak, std::abs(out[i]));
+                worstShape = juce::jmax(worstShape, std::abs(out[i] - in[i] * settledGain));
+            }
+        }
+        if (outPeak > 1.0f || std::abs(settledPeak - OutputStage::ceiling) > 0.01f || worstShape > 1.0e-3f)
+        {
+            std::cerr << "FAIL: limited sine peaks at " << outPeak << " (settled " << settledPeak << ", expected "
+                      << OutputStage::ceiling << "), differs from a scaled input by " << worstShape << "\n";
+            ++failed;
+        }
+
+        // Quiet again: the reduction releases (0.1 s time constant), so after half a second it is nearly gone.
+        run(stage, 0.1f, 375, in, out);
+        if (stage.getLimiterGain() < 0.95f)
+        {
+            std::cerr << "FAIL: limiter gain released only to " << stage.getLimiterGain() << " after 0.5 s\n";
+            ++failed;
+        }
+    }
+
+    // The soft clipper: identity up to the ceiling, monotonic and below full scale beyond it.
+    if (OutputStage::softClip(0.5f) != 0.5f || OutputStage::softClip(-OutputStage::ceiling) != -OutputStage::ceiling
+        || !(OutputStage::softClip(1.5f) < 1.0f) || !(OutputStage::softClip(1.5f) > OutputStage::softClip(1.2f))
+        || !(OutputStage::softClip(100.0f) < 1.0f) || OutputStage::softClip(-2.0f) != -OutputStage::softClip(2.0f))
+    {
+        std::cerr << "FAIL: soft clip curve is wrong (1.5 -> " << OutputStage::softClip(1.5f) << ")\n";
+        ++failed;
+    }
+
+    return failed;
+}
+
+static int runSampleNamingTests()
+{
+    int failed = 0;
+
+    struct Case { const char* fileName; bool keySamplesNaming; int expected; };
+    const Case cases[] = {
+        { "c0.wav", true, 24 },            // keySamples: octave 0 = C1 = MIDI 24
+        { "c#5.wav", true, 85 },
+        { "c7.wav", true, 108 },
+        { "Piano_C4.wav", false, 60 },     // note-name token
+        { "Piano_F#3.wav", false, 54 },
+        { "Piano_Bb2.wav", false, 46 },
+        { "Piano_60.wav", false, 60 },     // MIDI number token
+        { "Piano_v2_60.wav", false, 60 },  // layering tokens are not note numbers
+        { "Piano_C4_vl3_rr2.wav", false, 60 },
+        { "ambience.wav", false, -1 }      // unparsed -> caller maps to all notes
+    };
+
+    for (const auto& c : cases)
+    {
+        const int midi = SampleLoader::midiNoteForFile(juce::File::getCurrentWorkingDirectory().getChildFile(c.fileName),
+                                                       c.keySamplesNaming);
+        if (midi != c.expected)
+        {
+            std::cerr << "FAIL: " << c.fileName << " expected MIDI " << c.expected << ", got " << midi << "\n";
+            ++failed;
+        }
+    }
+
+    struct LayerCase { const char* fileName; int layer; int roundRobin; };
+    const LayerCase layerCases[] = {
+        { "Piano_C4.wav", 0, 0 },
+        { "Piano_v2_60.wav", 2, 0 },
+        { "Piano C4 vl3 rr2.wav", 3, 2 },
+        { "Piano_rr1_C4_v10.wav", 10, 1 },
+        { "Piano_vintage_C4.wav", 0, 0 }   // not a layer token
+    };
+    for (const auto& c : layerCases)
+    {
+        const auto layering = SampleNaming::layeringForFile(juce::File::getCurrentWorkingDirectory().getChildFile(c.fileName));
+        if (layering.velocityLayer != c.layer || layering.roundRobin != c.roundRobin)
+        {
+            std::cerr << "FAIL: " << c.fileName << " expected layer " << c.layer << " rr " << c.roundRobin << ", got "
+                      << layering.velocityLayer << " rr " << layering.roundRobin << "\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+/** Writes buffer to file as a 44.1 kHz WAV; false if no writer could be created. */
+static bool writeTestWav(const juce::File& file, const juce::AudioBuffer<float>& buffer, int bitsPerSample = 16,
+                         const juce::StringPairArray& metadata = {})
+{
+    file.deleteFile(); // FileOutputStream appends to an existing file
+    juce::WavAudioFormat wav;
+    auto stream = std::make_unique<juce::FileOutputStream>(file);
+    std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), 44100.0,
+                                                                        static_cast<unsigned int>(buffer.getNumChannels()),
+                                                                        bitsPerSample, metadata, 0));
+    if (writer == nullptr)
+        return false;
+    stream.release();
+    return writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+}
+
+static int runMappedSampleFileTests()
+{
+    int failed = 0;
+
+    // Write a short 16-bit stereo WAV, map it and check the PCM matches what was written.
+    juce::TemporaryFile temp(".wav");
+    const int numFrames = 1000;
+    juce::AudioBuffer<float> written(2, numFrames);
+    for (int i = 0; i < numFrames; ++i)
+    {
+        written.setSample(0, i, std::sin(static_cast<float>(i) * 0.05f) * 0.5f);
+        written.setSample(1, i, -0.25f);
+    }
+    if (!writeTestWav(temp.getFile(), written))
+    {
+        std::cerr << "FAIL: could not create WAV writer for mapped-file test\n";
+        return 1;
+    }
+
+    auto mapped = MappedSampleFile::open(temp.getFile());
+    if (mapped == nullptr)
+    {
+        std::cerr << "FAIL: MappedSampleFile::open returned null for a 16-bit WAV\n";
+        return 1;
+    }
+
+    const auto& pcm = mapped->getPcm();
+    if (pcm.numFrames != numFrames || pcm.numChannels != 2 || pcm.encoding != SamplePcm::Encoding::int16
+        || mapped->getSampleRate() != 44100.0)
+    {
+        std::cerr << "FAIL: mapped layout " << pcm.numFrames << " frames, " << pcm.numChannels << " channels\n";
+        ++failed;
+    }
+
+    mapped->warm(0, numFrames);
+    for (int i = 0; i < juce::jmin(numFrames, pcm.numFrames); ++i)
+    {
+        float l = 0.0f, r = 0.0f;
+        pcm.readFrame(i, l, r);
+        if (std::abs(l - written.getSample(0, i)) > 1.0e-3f || std::abs(r - written.getSample(1, i)) > 1.0e-3f)
+        {
+            std::cerr << "FAIL: mapped frame " << i << " reads (" << l << ", " << r << ")\n";
+            ++failed;
+            break;
+        }
+    }
+
+    float l = 1.0f, r = 1.0f;
+    pcm.readFrame(numFrames, l, r);
+    if (l != 0.0f || r != 0.0f)
+    {
+        std::cerr << "FAIL: frame past the end of a mapped file should read as silence\n";
+        ++failed;
+    }
+
+    return failed;
+}
+
+static int runPageWarmerTests()
+{
+    int failed = 0;
+
+    // Requests queued while the thread isn't running hold their sample until stop() drops them.
+    auto data = SampleData::fromMappedFile(nullptr, 30.0);
+    PageWarmer warmer;
+    for (int i = 0; i < 3; ++i)
+        warmer.requestWarm(data.get(), 0, 1024);
+    const int queued = data->getReferenceCount();
+    warmer.stop();
+    if (queued != 4 || data->getReferenceCount() != 1)
+    {
+        std::cerr << "FAIL: page warmer holds " << data->getReferenceCount() << " references after stop(), "
+                  << queued << " while queued; expected 1 and 4\n";
+        ++failed;
+    }
+
+    return failed;
+}
+
+static int runSampleStreamerTests()
+{
+    int failed = 0;
+
+    // Two stereo files: a ramp with different channels, and a constant that no part of the ramp matches.
+    constexpr int length = 20000;
+    juce::AudioBuffer<float> ramp(2, length), constant(2, length);
+    for (int i = 0; i < length; ++i)
+    {
+        ramp.setSample(0, i, 0.4f * static_cast<float>(i % 1000) / 1000.0f);
+        ramp.setSample(1, i, -0.4f * static_cast<float>(i % 777) / 777.0f);
+        constant.setSample(0, i, 0.75f);
+        constant.setSample(1, i, 0.75f);
+    }
+    juce::TemporaryFile rampFile(".wav"), constantFile(".wav");
+    if (!writeTestWav(rampFile.getFile(), ramp) || !writeTestWav(constantFile.getFile(), constant))
+    {
+        std::cerr << "FAIL: could not write the streamer test WAVs\n";
+        return 1;
+    }
+
+    // What the resident path decodes, for comparison.
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    juce::AudioBuffer<float> resident(2, length);
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(rampFile.getFile()));
+        if (reader == nullptr || !reader->read(&resident, 0, length, 0, true, true))
+        {
+            std::cerr << "FAIL: could not decode the streamer test WAV\n";
+            return 1;
+        }
+    }
+
+    // Reads numFrames from slot, polling while the ring is empty; fewer if the I/O thread doesn't keep up in 5 s.
+    auto readAll = [](SampleStreamer::Slot& slot, int numFrames, juce::AudioBuffer<float>& out)
+    {
+        out.setSize(2, numFrames);
+        int got = 0;
+        const auto deadline = juce::Time::getMillisecondCounter() + 5000;
+        while (got < numFrames && juce::Time::getMillisecondCounter() < deadline)
+        {
+            const int n = slot.read(out.getWritePointer(0, got), out.getWritePointer(1, got), juce::jmin(512, numFrames - got));
+            if (n == 0)
+                juce::Thread::sleep(1);
+            got += n;
+        }
+        return got;
+    };
+
+    SampleStreamer streamer(4);
+    streamer.start(2);
+    const int rampId = streamer.registerSource(rampFile.getFile(), length);
+    const int constantId = streamer.registerSource(constantFile.getFile(), length);
+
+    // Streaming past a resident head gives exactly the frames a resident decode has there.
+    constexpr int head = 1000;
+    auto* slot = streamer.claimSlot();
+    if (slot == nullptr)
+    {
+        std::cerr << "FAIL: no stream slot after start(2)\n";
+        return failed + 1;
+    }
+    slot->start(rampId, head);
+    juce::AudioBuffer<float> streamed;
+    const int got = readAll(*slot, length - head, streamed);
+    float worst = 0.0f;
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < got; ++i)
+            worst = juce::jmax(worst, std::abs(streamed.getSample(ch, i) - resident.getSample(ch, head + i)));
+    if (got != length - head || worst != 0.0f)
+    {
+        std::cerr << "FAIL: streamed " << got << " of " << length - head << " frames, off the resident decode by "
+                  << worst << "\n";
+        ++failed;
+    }
+
+    // Restarted on another file with the ring still full of the first: nothing from the first comes out.
+    slot->start(rampId, 0);
+    juce::Thread::sleep(50); // let the ring fill
+    slot->stop();
+    slot->start(constantId, 0);
+    juce::AudioBuffer<float> restarted;
+    const int gotRestarted = readAll(*slot, 8192, restarted);
+    bool stale = false;
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < gotRestarted; ++i)
+            stale = stale || restarted.getSample(ch, i) != constant.getSample(ch, i);
+    if (gotRestarted != 8192 || stale)
+    {
+        std::cerr << "FAIL: stream restarted on a new file read " << gotRestarted << " frames"
+                  << (stale ? ", some from the old file" : "") << "\n";
+        ++failed;
+    }
+    streamer.releaseSlot(*slot);
+
+    // Slots are shared: only the streams start() asked for can be claimed, a missed one counts as an underrun, and a
+    // released slot can be claimed again.
+    auto* second = streamer.claimSlot();
+    auto* third = streamer.claimSlot();
+    auto* fourth = streamer.claimSlot();
+    if (second == nullptr || third == nullptr || second == third || fourth != nullptr || streamer.getNumUnderruns() != 1)
+    {
+        std::cerr << "FAIL: stream slots past start(2) were handed out, or a missed claim wasn't counted\n";
+        ++failed;
+    }
+    if (third != nullptr)
+    {
+        streamer.releaseSlot(*third);
+        if (streamer.claimSlot() != third)
+        {
+            std::cerr << "FAIL: a released stream slot wasn't claimable again\n";
+            ++failed;
+        }
+    }
+
+    // With the I/O thread stopped nothing feeds the ring: a read returns nothing at once instead of blocking.
+    streamer.stop();
+    if (second != nullptr)
+    {
+        second->start(rampId, 0);
+        float l[256], r[256];
+        const auto before = juce::Time::getMillisecondCounterHiRes();
+        const int n = second->read(l, r, 256);
+        second->reportUnderrun();
+        if (n != 0 || juce::Time::getMillisecondCounterHiRes() - before > 100.0 || streamer.getNumUnderruns() != 2)
+        {
+            std::cerr << "FAIL: an unfed stream read " << n << " frames or didn't count its underrun\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runSampleDataTests()
+{
+    int failed = 0;
+    const int numFrames = 800;
+
+    // Decodes a WAV written at the given width and checks the stored layout and the frames read back.
+    auto check = [&](const char* label, int bitsPerSample, bool identicalChannels,
+                     SamplePcm::Encoding expectedEncoding, int expectedChannels)
+    {
+        juce::AudioBuffer<float> written(2, numFrames);
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const float v = std::sin(static_cast<float>(i) * 0.03f) * 0.6f;
+            written.setSample(0, i, v);
+            written.setSample(1, i, identicalChannels ? v : -v);
+        }
+
+        juce::TemporaryFile temp(".wav");
+        if (!writeTestWav(temp.getFile(), written, bitsPerSample))
+        {
+            std::cerr << "FAIL: could not create " << label << " WAV\n";
+            ++failed;
+            return;
+        }
+
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader(wav.createReaderFor(temp.getFile().createInputStream().release(), true));
+        auto data = reader != nullptr ? SampleData::decode(*reader, 30.0) : nullptr;
+        if (data == nullptr)
+        {
+            std::cerr << "FAIL: " << label << " could not be decoded\n";
+            ++failed;
+            return;
+        }
+
+        const auto& pcm = data->getPcm();
+        if (pcm.encoding != expectedEncoding || pcm.numChannels != expectedChannels || pcm.numFrames != numFrames
+            || data->getMemoryUsage() != static_cast<size_t>(numFrames * pcm.getBytesPerFrame()))
+        {
+            std::cerr << "FAIL: " << label << " stored as " << pcm.numChannels << " channels, "
+                      << SamplePcm::bytesPerSample(pcm.encoding) << " bytes/sample\n";
+            ++failed;
+            return;
+        }
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            float l = 0.0f, r = 0.0f;
+            pcm.readFrame(i, l, r);
+            if (std::abs(l - written.getSample(0, i)) > 1.0e-4f || std::abs(r - written.getSample(1, i)) > 1.0e-4f)
+            {
+                std::cerr << "FAIL: " << label << " frame " << i << " reads (" << l << ", " << r << ")\n";
+                ++failed;
+                return;
+            }
+        }
+
+        // Bulk reads match frame reads, including the silence on either side of the data.
+        std::vector<float> bulkL(numFrames + 6), bulkR(numFrames + 6);
+        pcm.readFrames(-3, numFrames + 6, bulkL.data(), bulkR.data());
+        for (int i = -3; i < numFrames + 3; ++i)
+        {
+            float l = 0.0f, r = 0.0f;
+            pcm.readFrame(i, l, r);
+            if (bulkL[static_cast<size_t>(i + 3)] != l || bulkR[static_cast<size_t>(i + 3)] != r)
+            {
+                std::cerr << "FAIL: " << label << " bulk read differs at frame " << i << "\n";
+                ++failed;
+                return;
+            }
+        }
+    };
+
+    check("16-bit dual-mono", 16, true, SamplePcm::Encoding::int16, 1);
+    check("16-bit stereo", 16, false, SamplePcm::Encoding::int16, 2);
+    check("24-bit stereo", 24, false, SamplePcm::Encoding::int24, 2);
+
+    // Silence trimming: 0.1 s of silence, 0.2 s of tone, 0.3 s of silence at 44.1 kHz.
+    {
+        const double rate = 44100.0;
+        const int lead = 4410, tone = 8820, tail = 13230;
+        juce::AudioBuffer<float> written(1, lead + tone + tail);
+        written.clear();
+        for (int i = 0; i < tone; ++i)
+            written.setSample(0, lead + i, std::sin(static_cast<float>(i) * 0.05f) * 0.5f + 0.25f);
+
+        juce::TemporaryFile temp(".wav");
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        if (writeTestWav(temp.getFile(), written))
+            reader.reset(wav.createReaderFor(temp.getFile().createInputStream().release(), true));
+        auto data = reader != nullptr ? SampleData::decode(*reader, 30.0, 0.0, juce::Decibels::decibelsToGain(-60.0f)) : nullptr;
+
+        const int preRoll = static_cast<int>(SampleData::trimPreRollSeconds * rate);
+        const int fade = static_cast<int>(SampleData::tailFadeSeconds * rate);
+        if (data == nullptr || data->getStartOffset() != lead - preRoll || data->getOnsetFrame() != preRoll
+            || data->getLength() != preRoll + tone + fade || data->getFadeOutFrames() != fade
+            || data->getMemoryUsage() != static_cast<size_t>(data->getLength()) * sizeof(juce::int16))
+        {
+            std::cerr << "FAIL: trimmed sample starts at " << (data != nullptr ? data->getStartOffset() : -1)
+                      << ", " << (data != nullptr ? data->getLength() : -1) << " frames\n";
+            ++failed;
+        }
+        else
+        {
+            float l = 0.0f, r = 0.0f;
+            data->getPcm().readFrame(preRoll, l, r);
+            if (std::abs(l - written.getSample(0, lead)) > 1.0e-4f)
+            {
+                std::cerr << "FAIL: trimmed onset reads " << l << "\n";
+                ++failed;
+            }
+        }
+    }
+
+    // Pre-resampling: a looped 1 kHz tone at 44.1 kHz converted to 48 kHz keeps its pitch, encoding and loop.
+    {
+        const int frames = 4410;
+        juce::AudioBuffer<float> written(1, frames);
+        for (int i = 0; i < frames; ++i)
+            written.setSample(0, i, 0.5f * std::sin(juce::MathConstants<float>::twoPi * 1000.0f * static_cast<float>(i) / 44100.0f));
+
+        juce::TemporaryFile temp(".wav");
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        if (writeTestWav(temp.getFile(), written, 24))
+            reader.reset(wav.createReaderFor(temp.getFile().createInputStream().release(), true));
+        auto source = reader != nullptr ? SampleData::decode(*reader, 30.0, 0.0, 0.0f, { 441, frames }) : nullptr;
+        auto data = source != nullptr ? SampleData::resample(*source, 48000.0) : nullptr;
+
+        const double ratio = 44100.0 / 48000.0;
+        const int expectedLength = static_cast<int>((frames - 1) / ratio) + 1;
+        if (data == nullptr || data->getSourceSampleRate() != 48000.0 || data->getLength() != expectedLength
+            || data->getPcm().encoding != SamplePcm::Encoding::int24 || data->getPcm().numChannels != 1
+            || data->getLoop().start != juce::roundToInt(441 / ratio) || data->getLoop().end != expectedLength)
+        {
+            std::cerr << "FAIL: resampled tone has " << (data != nullptr ? data->getLength() : -1) << " frames at "
+                      << (data != nullptr ? data->getSourceSampleRate() : 0.0) << " Hz, expected " << expectedLength << "\n";
+            ++failed;
+        }
+        else
+        {
+            // Away from the edges (where the filter sees silence) it is the same tone at the new rate.
+            float worst = 0.0f;
+            for (int i = 16; i < expectedLength - 16; ++i)
+            {
+                float l = 0.0f, r = 0.0f;
+                data->getPcm().readFrame(i, l, r);
+                const float expected = 0.5f * std::sin(juce::MathConstants<float>::twoPi * 1000.0f * static_cast<float>(i) / 48000.0f);
+                worst = juce::jmax(worst, std::abs(l - expected));
+            }
+            if (worst > 1.0e-3f)
+            {
+                std::cerr << "FAIL: resampled tone is off by up to " << worst << "\n";
+                ++failed;
+            }
+        }
+
+        if (source != nullptr && SampleData::resample(*source, 44100.0) != nullptr)
+        {
+            std::cerr << "FAIL: resampling to the source's own rate should return nothing\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runVoiceKernelTests()
+{
+    int failed = 0;
+
+    const int numSource = 600;
+    std::vector<float> srcL(numSource), srcR(numSource), gains(256);
+    for (int i = 0; i < numSource; ++i)
+    {
+        srcL[static_cast<size_t>(i)] = std::sin(static_cast<float>(i) * 0.07f);
+        srcR[static_cast<size_t>(i)] = std::cos(static_cast<float>(i) * 0.05f) * 0.5f;
+    }
+    for (size_t i = 0; i < gains.size(); ++i)
+        gains[i] = 0.25f + static_cast<float>(i) / 512.0f;
+
+    // Against a scalar double-precision reference, stereo and mono, unity and transposed, with a phase.
+    struct Case { double phase; double ratio; bool stereo; };
+    for (const auto& c : { Case { 0.0, 1.0, true }, Case { 0.0, 1.0, false }, Case { 0.3, 1.0, true },
+                           Case { 0.75, 1.7818, true }, Case { 0.1, 0.5946, false } })
+    {
+        const int numFrames = 200;
+        if (VoiceKernel::sourceFramesNeeded(c.phase, c.ratio, numFrames) > numSource)
+            continue;
+
+        std::vector<float> outL(numFrames, 0.5f), outR(numFrames, -0.5f);
+        VoiceKernel::mix(VoiceKernel::Interpolation::linear, srcL.data(), srcR.data(), gains.data(), numFrames,
+                         c.phase, c.ratio, outL.data(), c.stereo ? outR.data() : nullptr);
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const double pos = c.phase + i * c.ratio;
+            const auto index = static_cast<size_t>(pos);
+            const double alpha = pos - static_cast<double>(index);
+            const double l = srcL[index] + alpha * (srcL[index + 1] - srcL[index]);
+            const double r = srcR[index] + alpha * (srcR[index + 1] - srcR[index]);
+            const double g = gains[static_cast<size_t>(i)];
+            const double expectedL = c.stereo ? 0.5 + l * g : 0.5 + (l + r) * 0.5 * g;
+            const double expectedR = c.stereo ? -0.5 + r * g : -0.5;
+            if (std::abs(outL[static_cast<size_t>(i)] - expectedL) > 1.0e-4 || std::abs(outR[static_cast<size_t>(i)] - expectedR) > 1.0e-4)
+            {
+                std::cerr << "FAIL: voice kernel (phase " << c.phase << ", ratio " << c.ratio << (c.stereo ? ", stereo" : ", mono")
+                          << ") differs at frame " << i << "\n";
+                ++failed;
+                break;
+            }
+        }
+    }
+
+    // Quality modes on sine tones (gain 1, history frames in front of the span, as the voice fetches them).
+    auto render = [](VoiceKernel::Interpolation q, double frequency, double ratio, double phase, int numFrames,
+                     std::vector<float>& out)
+    {
+        const int history = VoiceKernel::getHistoryFrames(q);
+        std::vector<float> tone(static_cast<size_t>(VoiceKernel::sourceFramesNeeded(phase, ratio, numFrames, q)));
+        for (size_t i = 0; i < tone.size(); ++i)
+            tone[i] = static_cast<float>(std::sin(juce::MathConstants<double>::twoPi * frequency * (static_cast<double>(i) - history)));
+        std::vector<float> ones(static_cast<size_t>(numFrames), 1.0f), right(static_cast<size_t>(numFrames), 0.0f);
+        out.assign(static_cast<size_t>(numFrames), 0.0f);
+        VoiceKernel::mix(q, tone.data() + history, tone.data() + history, ones.data(), numFrames, phase, ratio,
+                         out.data(), right.data());
+    };
+
+    using Q = VoiceKernel::Interpolation;
+    VoiceKernel::prepareTables();
+    struct QualityCase { Q quality; const char* name; double maxLowToneError; double maxAliasRms; };
+    for (const auto& c : { QualityCase { Q::linear, "linear", 2.0e-2, 1.0 }, QualityCase { Q::hermite, "hermite", 1.0e-3, 1.0 },
+                           QualityCase { Q::sinc8, "sinc8", 1.0e-3, 0.05 }, QualityCase { Q::sinc16, "sinc16", 1.0e-3, 0.01 } })
+    {
+        std::vector<float> out;
+
+        // Four semitones down, a low tone: the better modes track the true waveform closely.
+        render(c.quality, 0.05, 0.7937, 0.37, 200, out);
+        double maxError = 0.0;
+        for (int i = 0; i < 200; ++i)
+            maxError = juce::jmax(maxError, std::abs(out[static_cast<size_t>(i)] - std::sin(juce::MathConstants<double>::twoPi * 0.05 * (0.37 + i * 0.7937))));
+
+        // An octave up, a tone at 0.8 of Nyquist can't be represented: the sinc modes filter it out instead of aliasing.
+        render(c.quality, 0.4, 2.0, 0.37, 200, out);
+        double sumSquares = 0.0;
+        for (auto v : out)
+            sumSquares += static_cast<double>(v) * v;
+        const double aliasRms = std::sqrt(sumSquares / 200.0);
+
+        // Untransposed, every mode is an exact copy.
+        render(c.quality, 0.05, 1.0, 0.0, 64, out);
+        bool exact = true;
+        for (int i = 0; i < 64; ++i)
+            exact = exact && out[static_cast<size_t>(i)] == static_cast<float>(std::sin(juce::MathConstants<double>::twoPi * 0.05 * i));
+
+        if (maxError > c.maxLowToneError || aliasRms > c.maxAliasRms || !exact)
+        {
+            std::cerr << "FAIL: " << c.name << " resampling: error " << maxError << ", alias RMS " << aliasRms
+                      << (exact ? "" : ", unity not exact") << "\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runVoiceEnvelopeTests()
+{
+    int failed = 0;
+
+    // 1 kHz keeps the segment lengths readable: attack 100, decay 200, release 300 samples.
+    auto makeEnvelope = [](VoiceEnvelope::Curve curve)
+    {
+        VoiceEnvelope envelope;
+        envelope.setSampleRate(1000.0);
+        envelope.setParameters({ 0.1f, 0.2f, 0.5f, 0.3f, curve });
+        return envelope;
+    };
+
+    // Renders numSamples in blocks of blockSize (the values must not depend on it).
+    auto render = [](VoiceEnvelope& envelope, int numSamples, int blockSize)
+    {
+        std::vector<float> gains(static_cast<size_t>(numSamples));
+        for (int done = 0; done < numSamples; done += blockSize)
+            envelope.render(gains.data() + done, juce::jmin(blockSize, numSamples - done), 1.0f);
+        return gains;
+    };
+
+    for (auto curve : { VoiceEnvelope::Curve::linear, VoiceEnvelope::Curve::exponential })
+    {
+        const bool exponential = curve == VoiceEnvelope::Curve::exponential;
+        const char* name = exponential ? "exponential" : "linear";
+
+        auto byBlock = makeEnvelope(curve);
+        auto bySample = makeEnvelope(curve);
+        byBlock.noteOn();
+        bySample.noteOn();
+        const auto held = render(byBlock, 400, 64);
+        const auto heldReference = render(bySample, 400, 1);
+
+        bool sameValues = true;
+        for (size_t i = 0; i < held.size(); ++i)
+            sameValues = sameValues && std::abs(held[i] - heldReference[i]) < 1.0e-5f;
+
+        // Attack peaks at 100 samples; decay reaches the sustain level by 300 (halfway in dB at 200 if exponential).
+        const float midDecay = held[199] - 0.5f;
+        const bool decayShape = exponential ? std::abs(midDecay - 0.5f * 0.01f) < 0.002f : std::abs(midDecay - 0.25f) < 0.01f;
+        if (!sameValues || std::abs(held[49] - 0.5f) > 0.01f || std::abs(held[99] - 1.0f) > 1.0e-6f || !decayShape
+            || std::abs(held[299] - 0.5f) > 1.0e-4f || held[399] != 0.5f)
+        {
+            std::cerr << "FAIL: " << name << " envelope attack/decay (" << held[99] << ", " << held[199] << ", " << held[299] << ")\n";
+            ++failed;
+        }
+
+        // Release from the sustain level: silent and idle after 300 samples, never rising.
+        byBlock.noteOff();
+        const auto released = render(byBlock, 310, 32);
+        bool falling = true;
+        for (size_t i = 1; i < released.size(); ++i)
+            falling = falling && released[i] <= released[i - 1];
+        const float midRelease = released[149];
+        const bool releaseShape = exponential ? std::abs(midRelease - 0.5f * 0.01f) < 0.002f : std::abs(midRelease - 0.25f) < 0.01f;
+        if (!falling || !releaseShape || byBlock.isActive() || released[305] != 0.0f)
+        {
+            std::cerr << "FAIL: " << name << " envelope release (mid " << midRelease << ", active " << byBlock.isActive() << ")\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runSampleBankTests()
+{
+    int failed = 0;
+
+    // Two zones straight from memory: a stereo int16 one and a mono int24 one with loop points and gain.
+    std::vector<juce::int16> stereo(2 * 300);
+    for (size_t i = 0; i < stereo.size(); ++i)
+        stereo[i] = static_cast<juce::int16>(i * 37);
+    std::vector<char> mono(3 * 5000, 0x11);
+
+    juce::Array<SampleBank::Zone> zones;
+    SampleBank::Zone a;
+    a.name = "c4";
+    a.rootNote = 60;
+    a.lowNote = 59;
+    a.highNote = 61;
+    a.pcm = { reinterpret_cast<const char*>(stereo.data()), 2, 300, SamplePcm::Encoding::int16 };
+    zones.add(a);
+
+    SampleBank::Zone b;
+    b.name = "a_rather_long_zone_name_that_gets_truncated";
+    b.rootNote = b.lowNote = b.highNote = 72;
+    b.sampleRate = 48000.0;
+    b.loopStart = 1000;
+    b.loopEnd = 4000;
+    b.gain = 0.5f;
+    b.pcm = { mono.data(), 1, 5000, SamplePcm::Encoding::int24 };
+    zones.add(b);
+
+    juce::TemporaryFile temp(".mbank");
+    const auto error = SampleBank::write(temp.getFile(), zones);
+    auto bank = error.isEmpty() ? SampleBank::open(temp.getFile()) : nullptr;
+    if (bank == nullptr || bank->getNumZones() != 2)
+    {
+        std::cerr << "FAIL: bank round trip (" << error << ")\n";
+        return 1;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        const auto& in = zones.getReference(i);
+        const auto& out = bank->getZone(i);
+        const auto bytes = static_cast<size_t>(in.pcm.numFrames * in.pcm.getBytesPerFrame());
+        if (out.rootNote != in.rootNote || out.lowNote != in.lowNote || out.highNote != in.highNote
+            || out.sampleRate != in.sampleRate || out.loopStart != in.loopStart || out.loopEnd != in.loopEnd
+            || out.gain != in.gain || out.pcm.encoding != in.pcm.encoding || out.pcm.numChannels != in.pcm.numChannels
+            || out.pcm.numFrames != in.pcm.numFrames || std::memcmp(out.pcm.data, in.pcm.data, bytes) != 0)
+        {
+            std::cerr << "FAIL: bank zone " << i << " doesn't match what was written\n";
+            ++failed;
+        }
+        if (reinterpret_cast<juce::pointer_sized_uint>(out.pcm.data) % SampleBank::pcmAlignment != 0)
+        {
+            std::cerr << "FAIL: bank zone " << i << " PCM is not page-aligned\n";
+            ++failed;
+        }
+    }
+
+    if (bank->getZone(0).name != "c4" || bank->getZone(1).name != b.name.substring(0, 23))
+    {
+        std::cerr << "FAIL: bank zone names read back as " << bank->getZone(0).name << ", " << bank->getZone(1).name << "\n";
+        ++failed;
+    }
+
+    auto data = SampleData::fromBank(bank, 1, 30.0);
+    if (!data->isMapped() || data->getGain() != 0.5f || data->getLength() != 5000 || data->getSourceSampleRate() != 48000.0)
+    {
+        std::cerr << "FAIL: SampleData::fromBank doesn't reflect the zone\n";
+        ++failed;
+    }
+
+    // FLAC bank: same zones, stored compressed, decoded back to exactly the same bytes.
+    juce::TemporaryFile flacTemp(".mbank");
+    const auto flacError = SampleBank::write(flacTemp.getFile(), zones, SampleBank::Compression::flac);
+    auto flacBank = flacError.isEmpty() ? SampleBank::open(flacTemp.getFile()) : nullptr;
+    if (flacBank == nullptr || flacBank->getNumZones() != 2)
+    {
+        std::cerr << "FAIL: FLAC bank round trip (" << flacError << ")\n";
+        ++failed;
+    }
+    else
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            const auto& in = zones.getReference(i).pcm;
+            auto decoded = SampleData::fromBank(flacBank, i, 30.0);
+            const auto& out = decoded->getPcm();
+            if (!flacBank->getZone(i).isCompressed() || decoded->isMapped()
+                || out.encoding != in.encoding || out.numChannels != in.numChannels || out.numFrames != in.numFrames
+                || std::memcmp(out.data, in.data, static_cast<size_t>(in.numFrames * in.getBytesPerFrame())) != 0)
+            {
+                std::cerr << "FAIL: FLAC bank zone " << i << " doesn't decode bit-identical\n";
+                ++failed;
+            }
+        }
+    }
+
+    juce::TemporaryFile notABank(".mbank");
+    notABank.getFile().replaceWithText("RIFF this is not a bank");
+    if (SampleBank::open(notABank.getFile()) != nullptr)
+    {
+        std::cerr << "FAIL: SampleBank::open accepted a file without the bank header\n";
+        ++failed;
+    }
+
+    // Corrupt index entries are rejected: frame counts that are zero or past INT_MAX, data running past the
+    // end of the file, loop points outside the zone. Entry i starts at 32 + 64 i.
+    struct Corruption { const char* what; int offset; juce::uint32 value; };
+    const Corruption corruptions[] = {
+        { "no frames", 32 + 12, 0 },
+        { "a frame count past INT_MAX", 32 + 12, 0x80000010u },
+        { "a frame count past the file", 32 + 12, 0x7fffffffu },
+        { "a data offset past the file", 32 + 32, 0xfffffff0u },
+        { "a loop end past the zone", 96 + 20, 5001 },
+        { "a loop start before its end", 96 + 16, 4500 },
+    };
+    juce::MemoryBlock good;
+    temp.getFile().loadFileAsData(good);
+    for (const auto& c : corruptions)
+    {
+        auto bytes = good;
+        const juce::uint32 value = juce::ByteOrder::swapIfBigEndian(c.value); // fields are little-endian
+        bytes.copyFrom(&value, c.offset, sizeof(value));
+        juce::TemporaryFile corrupt(".mbank");
+        corrupt.getFile().replaceWithData(bytes.getData(), bytes.getSize());
+        if (SampleBank::open(corrupt.getFile()) != nullptr)
+        {
+            std::cerr << "FAIL: SampleBank::open accepted an entry with " << c.what << "\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runSampleLoaderTests()
+{
+    int failed = 0;
+
+    // A small library: single-layer notes a minor third apart, and two velocity layers on C4.
+    juce::TemporaryFile tempDir;
+    const auto dir = tempDir.getFile();
+    dir.createDirectory();
+    juce::StringArray names;
+    for (int note = 48; note <= 72; note += 3)
+        names.add("Piano_" + juce::String(note) + (note == 60 ? "_v1" : ""));
+    names.add("Piano_60_v2");
+    for (int i = 0; i < names.size(); ++i)
+    {
+        juce::AudioBuffer<float> tone(1, 2000);
+        for (int f = 0; f < tone.getNumSamples(); ++f)
+            tone.setSample(0, f, (0.1f + 0.05f * static_cast<float>(i)) * std::sin(0.05f * static_cast<float>(f)));
+        if (!writeTestWav(dir.getChildFile(names[i] + ".wav"), tone))
+        {
+            std::cerr << "FAIL: could not write the loader test library\n";
+            return 1;
+        }
+    }
+
+    // The published sounds in order, then every key's layers and zones with their ratios.
+    auto describe = [](const SoundSet& set)
+    {
+        juce::StringArray lines;
+        for (auto* sound : set.getSounds())
+            lines.add(static_cast<MatildaSamplerSound*>(sound)->getName());
+        for (int key = 0; key < 128; ++key)
+        {
+            const auto& k = set.getKey(key);
+            juce::String line(key);
+            for (int l = 0; l < k.numLayers; ++l)
+                for (int z = 0; z < k.layers[static_cast<size_t>(l)].numZones; ++z)
+                {
+                    const auto& zone = set.getZone(k.layers[static_cast<size_t>(l)].firstZone + z);
+                    line << " " << l << ":" << (zone.sound != nullptr ? zone.sound->getName() : juce::String("-")) << "@"
+                         << juce::String(zone.pitchRatio, 9);
+                }
+            lines.add(line);
+        }
+        return lines.joinIntoString("\n");
+    };
+
+    // Loads the library with decodeThreads files at once; the published set's description, empty if it didn't finish.
+    auto load = [&](int decodeThreads, const juce::String& what)
+    {
+        SoundSetPublisher publisher;
+        juce::String description;
+        {
+            SampleStreamer streamer(1);
+            SampleLoader loader(publisher, streamer);
+            SampleLoader::Options options;
+            options.samplesDirectory = dir;
+            options.decodeThreads = decodeThreads;
+            loader.startLoading(options);
+
+            const auto deadline = juce::Time::getMillisecondCounter() + 20000;
+            while (loader.isLoading() && juce::Time::getMillisecondCounter() < deadline)
+                juce::Thread::sleep(5);
+            if (loader.isLoading() || loader.getProgress() != 1.0f)
+            {
+                std::cerr << "FAIL: " << what << " load still busy (progress " << loader.getProgress() << ")\n";
+                ++failed;
+            }
+            else if (auto set = publisher.getPublished(); set != nullptr && set->size() == names.size())
+            {
+                description = describe(*set);
+            }
+            else
+            {
+                std::cerr << "FAIL: " << what << " load published " << (set != nullptr ? set->size() : 0) << " of "
+                          << names.size() << " sounds\n";
+                ++failed;
+            }
+        }
+        // Let the pool drop this load's data, so the next one decodes again rather than sharing it.
+        publisher.clear();
+        SamplePool::getInstance()->purgeUnused();
+        return description;
+    };
+
+    const auto pooled = load(0, "pooled");
+    const auto serial = load(1, "single-thread");
+    if (pooled.isNotEmpty() && serial.isNotEmpty() && pooled != serial)
+    {
+        std::cerr << "FAIL: pooled decode published a different sound order or key map than a single-thread load\n";
+        ++failed;
+    }
+
+    SampleIndex::getDefaultCacheFile(dir).deleteFile();
+    dir.deleteRecursively();
+    return failed;
+}
+
+static int runSampleIndexTests()
+{
+    int failed = 0;
+
+    juce::TemporaryFile tempDir;
+    const auto dir = tempDir.getFile();
+    dir.createDirectory();
+    const auto cacheFile = dir.getSiblingFile(dir.getFileName() + "_index.xml");
+
+    juce::AudioBuffer<float> quiet(1, 400);
+    quiet.clear();
+    for (int i = 100; i < 300; ++i)
+        quiet.setSample(0, i, 0.5f);
+    if (!writeTestWav(dir.getChildFile("Piano_C4.wav"), quiet) || !writeTestWav(dir.getChildFile("Piano_D4.wav"), quiet))
+    {
+        std::cerr << "FAIL: could not write scan index test files\n";
+        return 1;
+    }
+    dir.getChildFile("notes.txt").replaceWithText("not a sample");
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    {
+        SampleIndex index(cacheFile);
+        index.scan(dir, false, formats);
+        const auto& entries = index.getEntries();
+        if (entries.size() != 2 || index.getNumProbed() != 2 || index.usedCachedListing()
+            || entries[0].midiNote != 60 || entries[1].midiNote != 62 || !entries[0].valid || entries[0].lengthInSamples != 400)
+        {
+            std::cerr << "FAIL: first scan found " << entries.size() << " files, probed " << index.getNumProbed() << "\n";
+            ++failed;
+        }
+
+        index.setAnalysis(dir.getChildFile("Piano_C4.wav"), { 0.001f, { 100, 299 } });
+        if (!index.save())
+        {
+            std::cerr << "FAIL: scan index could not be saved\n";
+            ++failed;
+        }
+    }
+
+    {
+        SampleIndex index(cacheFile);
+        index.scan(dir, false, formats);
+        const auto& entries = index.getEntries();
+        if (entries.size() != 2 || index.getNumProbed() != 0 || !index.usedCachedListing()
+            || !entries[0].analysed || entries[1].analysed || entries[1].midiNote != 62)
+        {
+            std::cerr << "FAIL: unchanged library should come from the cache (probed " << index.getNumProbed() << ")\n";
+            ++failed;
+        }
+
+        // The cached range only answers for the threshold it was found at.
+        const auto cached = index.getAudibleRange(dir.getChildFile("Piano_C4.wav"), 0.001f);
+        const auto otherThreshold = index.getAudibleRange(dir.getChildFile("Piano_C4.wav"), 0.01f);
+        if (cached.first != 100 || cached.last != 299 || otherThreshold.first != -1 || otherThreshold.last != -1)
+        {
+            std::cerr << "FAIL: cached audible range is " << cached.first << ".." << cached.last << ", expected 100..299\n";
+            ++failed;
+        }
+    }
+
+    // Change one file: only it is probed again, and it loses its stale analysis.
+    const auto changed = dir.getChildFile("Piano_C4.wav");
+    juce::AudioBuffer<float> longer(1, 800);
+    longer.clear();
+    writeTestWav(changed, longer);
+    changed.setLastModificationTime(juce::Time::getCurrentTime() + juce::RelativeTime::seconds(10.0));
+    {
+        SampleIndex index(cacheFile);
+        index.scan(dir, false, formats);
+        const auto& entries = index.getEntries();
+        if (entries.size() != 2 || index.getNumProbed() != 1 || entries[0].lengthInSamples != 800 || entries[0].analysed)
+        {
+            std::cerr << "FAIL: changed file should be re-probed alone (probed " << index.getNumProbed() << ")\n";
+            ++failed;
+        }
+    }
+
+    // A trimmed decode reports the range it found (what the index stores), and a known range is used as given.
+    juce::WavAudioFormat wav;
+    auto decodeD4 = [&](SampleData::AudibleRange known)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(wav.createReaderFor(dir.getChildFile("Piano_D4.wav").createInputStream().release(), true));
+        return reader != nullptr ? SampleData::decode(*reader, 30.0, 0.0, 0.001f, {}, known) : nullptr;
+    };
+    const int preRoll = static_cast<int>(SampleData::trimPreRollSeconds * 44100.0);
+    auto scanned = decodeD4({});
+    auto fromCache = decodeD4({ 150, 249 });
+    if (scanned == nullptr || scanned->getAudibleRange().first != 100 || scanned->getAudibleRange().last != 299
+        || scanned->getStartOffset() != 100 - preRoll || fromCache == nullptr || fromCache->getStartOffset() != 150 - preRoll
+        || fromCache->getAudibleRange().last != 249)
+    {
+        std::cerr << "FAIL: decode should find audio at 100..299 and trim to a known range without scanning\n";
+        ++failed;
+    }
+
+    cacheFile.deleteFile();
+    dir.deleteRecursively();
+    return failed;
+}
+
+static int runSampleLoopTests()
+{
+    int failed = 0;
+
+    // A WAV with a smpl loop: read back through the reader's metadata (smpl end is inclusive).
+    juce::StringPairArray smpl;
+    smpl.set("NumSampleLoops", "1");
+    smpl.set("Loop0Type", "0");
+    smpl.set("Loop0Start", "2000");
+    smpl.set("Loop0End", "5999");
+
+    const int numFrames = 10000;
+    juce::AudioBuffer<float> written(1, numFrames);
+    for (int i = 0; i < numFrames; ++i)
+        written.setSample(0, i, std::sin(static_cast<float>(i) * 0.02f) * 0.5f);
+
+    juce::TemporaryFile temp(".wav");
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    if (writeTestWav(temp.getFile(), written, 16, smpl))
+        reader.reset(wav.createReaderFor(temp.getFile().createInputStream().release(), true));
+
+    const auto embedded = reader != nullptr ? SampleLoops::fromMetadata(reader->metadataValues) : SampleData::Loop();
+    if (embedded.start != 2000 || embedded.end != 6000)
+    {
+        std::cerr << "FAIL: smpl loop read as " << embedded.start << ".." << embedded.end << "\n";
+        ++failed;
+    }
+
+    // AIFF INST sustain loop, via MARK identifiers.
+    juce::StringPairArray inst;
+    inst.set("NumSampleLoops", "2");
+    inst.set("Loop0Type", "1");
+    inst.set("Loop0StartIdentifier", "7");
+    inst.set("Loop0EndIdentifier", "8");
+    inst.set("NumCuePoints", "2");
+    inst.set("Cue0Identifier", "8");
+    inst.set("Cue0Offset", "4000");
+    inst.set("Cue1Identifier", "7");
+    inst.set("Cue1Offset", "1000");
+    const auto aiffLoop = SampleLoops::fromMetadata(inst);
+    inst.set("Loop0Type", "0");
+    if (aiffLoop.start != 1000 || aiffLoop.end != 4000 || SampleLoops::fromMetadata(inst).isValid())
+    {
+        std::cerr << "FAIL: INST loop read as " << aiffLoop.start << ".." << aiffLoop.end << "\n";
+        ++failed;
+    }
+
+    // A sidecar overrides the embedded loop.
+    const auto sidecar = SampleLoops::getSidecarFile(temp.getFile());
+    sidecar.replaceWithText("3000 7000\n");
+    const auto found = SampleLoops::find(temp.getFile(), embedded);
+    sidecar.deleteFile();
+    if (found.start != 3000 || found.end != 7000)
+    {
+        std::cerr << "FAIL: sidecar loop read as " << found.start << ".." << found.end << "\n";
+        ++failed;
+    }
+
+    // Decoding with the loop keeps nothing past its end and crossfades at most the audio before its start.
+    if (reader != nullptr)
+    {
+        auto data = SampleData::decode(*reader, 30.0, 0.0, 0.0f, embedded);
+        if (!data->hasLoop() || data->getLoop().start != 2000 || data->getLength() != 6000
+            || data->getResidentLength() != 6000
+            || data->getLoopCrossfadeFrames() != static_cast<int>(SampleData::loopCrossfadeSeconds * 44100.0))
+        {
+            std::cerr << "FAIL: looped sample has " << data->getLength() << " frames, crossfade "
+                      << data->getLoopCrossfadeFrames() << "\n";
+            ++failed;
+        }
+
+        // Streaming heads and loops past the decoded audio are played straight through.
+        auto head = SampleData::decode(*reader, 30.0, 0.05, 0.0f, embedded);
+        auto tooLong = SampleData::decode(*reader, 30.0, 0.0, 0.0f, { 2000, numFrames + 1 });
+        if (head->hasLoop() || tooLong->hasLoop() || tooLong->getLength() != numFrames)
+        {
+            std::cerr << "FAIL: invalid loop was kept\n";
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+static int runSoundSetPublisherTests()
+{
+    int failed = 0;
+
+    struct TestSound : juce::SynthesiserSound
+    {
+        explicit TestSound(int& destroyedCount) : destroyed(destroyedCount) {}
+        ~TestSound() override { ++destroyed; }
+        bool appliesToNote(int) override { return true; }
+        bool appliesToChannel(int) override { return true; }
+        int& destroyed;
+    };
+
+    int destroyed = 0;
+    SoundSetPublisher publisher;
+    publisher.publish(new SoundSet(nullptr, new TestSound(destroyed)));
+    const auto* first = publisher.acquire(); // audio thread is using the first set
+
+    // Swap in an unrelated set while a "voice" still plays the old sound.
+    juce::SynthesiserSound::Ptr playing = first->getSounds()[0];
+    publisher.publish(new SoundSet(nullptr, new TestSound(destroyed)));
+    if (destroyed != 0 || publisher.getNumRetired() != 1)
+    {
+        std::cerr << "FAIL: a set the audio thread may still be reading was reclaimed\n";
+        ++failed;
+    }
+
+    // Once the audio thread has moved on, the set goes, but the sound waits for its voice.
+    const auto* second = publisher.acquire();
+    publisher.collectGarbage();
+    if (second == first || second->size() != 1 || destroyed != 0 || publisher.getNumRetired() != 1)
+    {
+        std::cerr << "FAIL: retired sound was freed while a voice held it\n";
+        ++failed;
+    }
+
+    // The voice finishes off the audio thread's hands; the collector frees the sound.
+    playing = nullptr;
+    publisher.collectGarbage();
+    if (destroyed != 1 || publisher.getNumRetired() != 0)
+    {
+        std::cerr << "FAIL: replaced sound not reclaimed (" << destroyed << " destroyed)\n";
+        ++failed;
+    }
+
+    // Incremental sets share sounds: replacing one keeps the shared sound alive.
+    publisher.publish(new SoundSet(publisher.getPublished().get(), new TestSound(destroyed)));
+    publisher.acquire();
+    publisher.collectGarbage();
+    if (destroyed != 1 || publisher.getPublished()->size() != 2 || publisher.getNumRetired() != 0)
+    {
+        std::cerr << "FAIL: incremental publish lost a shared sound\n";
+        ++failed;
+    }
+
+    // An audio thread that released its set (not processing) holds nothing back.
+    publisher.acquire();
+    publisher.release();
+    publisher.publish(new SoundSet(nullptr, new TestSound(destroyed)));
+    publisher.collectGarbage();
+    if (destroyed != 3 || publisher.getNumRetired() != 0)
+    {
+        std::cerr << "FAIL: a released audio thread kept a replaced set alive (" << destroyed << " destroyed)\n";
+        ++failed;
+    }
+
+    publisher.clear();
+    if (destroyed != 4)
+    {
+        std::cerr << "FAIL: clear() left sounds alive\n";
+        ++failed;
+    }
+
+    return failed;
+}
+
+// A one-second 440 Hz sine decoded from a 24-bit WAV at file; nullptr if that fails. It plays on every key (root A4),
+// or, given roots, as one sound per root that covers only that key.
+static SoundSet::Ptr makeSineSoundSet(const juce::File& file, std::initializer_list<int> roots = {})
+{
+    const int numFrames = 44100;
+    juce::AudioBuffer<float> written(2, numFrames);
+    for (int i = 0; i < numFrames; ++i)
+        for (int ch = 0; ch < 2; ++ch)
+            written.setSample(ch, i, 0.5f * std::sin(juce::MathConstants<float>::twoPi * 440.0f * static_cast<float>(i) / 44100.0f));
+    if (!writeTestWav(file, written, 24))
+        return nullptr;
+
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatReader> reader(wav.createReaderFor(file.createInputStream().release(), true));
+    auto data = reader != nullptr ? SampleData::decode(*reader, 30.0) : nullptr;
+    if (data == nullptr)
+        return nullptr;
+
+    SoundSet::Ptr set = new SoundSet();
+    for (int root : roots)
+    {
+        juce::BigInteger notes;
+        notes.setBit(root);
+        set->add(new MatildaSamplerSound("sine" + juce::String(root), data, notes, root));
+    }
+    if (roots.size() == 0)
+    {
+        juce::BigInteger notes;
+        notes.setRange(0, 128, true);
+        set->add(new MatildaSamplerSound("sine", data, notes, 69));
+    }
+    return set;
+}
+
+static int runKeyMapTests()
+{
+    int failed = 0;
+
+    auto makeSound = [](int root, bool allKeys) -> juce::SynthesiserSound::Ptr
+    {
+        juce::BigInteger notes;
+        if (allKeys)
+            notes.setRange(0, 128, true);
+        else
+            notes.setBit(root);
+        return new MatildaSamplerSound("key" + juce::String(root), SampleData::fromMappedFile(nullptr, 30.0), notes, root);
+    };
+
+    // Unparsed (all-keys) sound first, as an unlucky load order would have it: it must not shadow C4/E4.
+    SoundSet::Ptr set = new SoundSet();
+    set->add(makeSound(60, true));
+    set->add(makeSound(60, false));
+    set->add(makeSound(64, false));
+    SoundSetPublisher publisher;
+    publisher.publish(set);
+
+    struct Case { int key; int expectedRoot; bool expectFallback; };
+    const Case cases[] = {
+        { 60, 60, false }, { 64, 64, false },
+        { 62, 60, false },          // tie: the lower neighbour
+        { 63, 64, false },
+        { 48, 60, false },          // an octave down
+        { 47, 60, true },           // further than maxTransposeSemitones: the catch-all sound
+        { 90, 60, true }
+    };
+    for (const auto& c : cases)
+    {
+        const auto& zone = set->getZone(set->getLayer(set->getKey(c.key), 100).firstZone);
+        const bool isFallback = zone.sound != nullptr && zone.sound->getMidiNotes().countNumberOfSetBits() == 128;
+        const double expectedRatio = std::pow(2.0, (c.key - c.expectedRoot) / 12.0);
+        if (zone.sound == nullptr || zone.sound->getMidiRootNote() != c.expectedRoot || isFallback != c.expectFallback
+            || std::abs(zone.pitchRatio - expectedRatio) > 1.0e-9)
+        {
+            std::cerr << "FAIL: key " << c.key << " maps to root "
+                      << (zone.sound != nullptr ? zone.sound->getMidiRootNote() : -1) << "\n";
+            ++failed;
+        }
+    }
+
+    // Without a catch-all, keys out of reach stay silent.
+    SoundSet::Ptr sparse = new SoundSet(nullptr, makeSound(60, false));
+    publisher.publish(sparse);
+    if (sparse->coversNote(40) || !sparse->coversNote(72) || sparse->coversNote(73))
+    {
+        std::cerr << "FAIL: key map reaches past " << SoundSet::maxTransposeSemitones << " semitones\n";
+        ++failed;
+    }
+
+    // A key filled by a neighbour or the catch-all is covered but doesn't have its own sample.
+    if (!set->hasOwnSample(60) || !set->hasOwnSample(64) || set->hasOwnSample(62) || set->hasOwnSample(90)
+        || !sparse->coversNote(61) || sparse->hasOwnSample(61))
+    {
+        std::cerr << "FAIL: hasOwnSample() counts transposed or catch-all keys\n";
+        ++failed;
+    }
+
+    // A key played by a transposed neighbour releases on its note-off, and isn't held afterwards.
+    juce::TemporaryFile temp(".wav");
+    auto sine = makeSineSoundSet(temp.getFile(), { 60, 64 });
+    if (sine == nullptr)
+    {
+        std::cerr << "FAIL: could not write and decode the key map test WAV\n";
+        return failed + 1;
+    }
+    MatildaSynthesiser synth;
+    auto* voice = synth.addVoice(new MatildaSamplerVoice());
+    voice->setSampleRate(44100.0);
+    synth.setCurrentPlaybackSampleRate(44100.0);
+    synth.getSoundSets().publish(sine);
+
+    juce::AudioBuffer<float> out(2, 256);
+    synth.noteOn(1, 62, 0.8f);
+    synth.renderNextBlock(out, juce::MidiBuffer(), 0, out.getNumSamples());
+    synth.noteOff(1, 62, 0.0f, true);
+    synth.renderNextBlock(out, juce::MidiBuffer(), 0, out.getNumSamples());
+    if (!voice->isVoiceActive() || voice->getCurrentlyPlayingNote() != 62 || !voice->isReleasing() || voice->isKeyDown())
+    {
+        std::cerr << "FAIL: note-off on a transposed key should release its voice\n";
+        ++failed;
+    }
+
+    synth.getSoundSets().clear();
+    return failed;
+}
+
+static int runVelocityLayerTests()
+{
+    int failed = 0;
+
+    auto makeSound = [](int root, int layer, int roundRobin) -> juce::SynthesiserSound::Ptr
+    {
+        juce::BigInteger notes;
+        notes.setBit(root);
+        return new MatildaSamplerSound("C4_v" + juce::String(layer) + "_rr" + juce::String(roundRobin),
+                                       SampleData::fromMappedFile(nullptr, 30.0), notes, root, -1, layer, roundRobin);
+    };
+
+    // C4: three layers, the middle one with two round robins (added out of order); D4 borrows them.
+    MatildaSynthesiser synth;
+    synth.addVoice(new MatildaSamplerVoice());
+    synth.setCurrentPlaybackSampleRate(44100.0);
+    SoundSet::Ptr set = new SoundSet();
+    set->add(makeSound(60, 3, 0));
+    set->add(makeSound(60, 2, 2));
+    set->add(makeSound(60, 1, 0));
+    set->add(makeSound(60, 2, 1));
+    synth.getSoundSets().publish(set);
+
+    for (int key : { 60, 62 })
+    {
+        const auto& entry = set->getKey(key);
+        struct Case { int velocity; int layer; };
+        for (const auto& c : { Case { 0, 1 }, Case { 42, 1 }, Case { 43, 2 }, Case { 85, 2 }, Case { 86, 3 }, Case { 127, 3 } })
+        {
+            const auto* sound = set->getZone(set->getLayer(entry, c.velocity).firstZone).sound;
+            if (entry.numLayers != 3 || sound == nullptr || sound->getVelocityLayer() != c.layer)
+            {
+                std::cerr << "FAIL: key " << key << " velocity " << c.velocity << " should play layer " << c.layer << "\n";
+                ++failed;
+            }
+        }
+    }
+
+    // Note-ons on the middle layer alternate its round robins in order, the others always play their one sample.
+    const int expected[] = { 1, 2, 1 };
+    for (int i = 0; i < 3; ++i)
+    {
+        synth.noteOn(1, 60, 64.0f / 127.0f);
+        const auto* sound = dynamic_cast<MatildaSamplerSound*>(synth.getVoice(0)->getCurrentlyPlayingSound().get());
+        if (sound == nullptr || sound->getVelocityLayer() != 2 || sound->getRoundRobin() != expected[i])
+        {
+            std::cerr << "FAIL: round robin " << i << " played " << (sound != nullptr ? sound->getName() : juce::String("nothing")) << "\n";
+            ++failed;
+        }
+        synth.allNotesOff(0, false);
+    }
+
+    synth.getSoundSets().clear();
+    return failed;
+}
+
+static int runVoiceRenderPoolTests()
+{
+    int failed = 0;
+
+    // One resident sine, played on a dozen keys: rendering on workers must add up to the serial mix.
+    juce::TemporaryFile temp(".wav");
+    auto set = makeSineSoundSet(temp.getFile());
+    if (set == nullptr)
+    {
+        std::cerr << "FAIL: could not write and decode the render pool test WAV\n";
+        return 1;
+    }
+
+    auto render = [&](int numThreads, juce::AudioBuffer<float>& out)
+    {
+        MatildaSynthesiser synth;
+        for (int i = 0; i < 16; ++i)
+        {
+            auto* voice = new MatildaSamplerVoice();
+            voice->setSampleRate(44100.0);
+            synth.addVoice(voice);
+        }
+        synth.setCurrentPlaybackSampleRate(44100.0);
+        synth.setNumRenderThreads(numThreads);
+        synth.prepareVoiceRendering(512, 2);
+        synth.getSoundSets().publish(set);
+
+        juce::MidiBuffer midi;
+        for (int key = 60; key < 72; ++key)
+            midi.addEvent(juce::MidiMessage::noteOn(1, key, 0.8f), (key - 60) * 7);
+        out.setSize(2, 4 * 512);
+        out.clear();
+        for (int block = 0; block < 4; ++block)
+        {
+            juce::AudioBuffer<float> view(out.getArrayOfWritePointers(), 2, block * 512, 512);
+            synth.renderNextBlock(view, block == 0 ? midi : juce::MidiBuffer(), 0, 512);
+        }
+        synth.getSoundSets().clear();
+        return synth.getNumRenderThreads();
+    };
+
+    juce::AudioBuffer<float> serial, parallel;
+    render(0, serial);
+    const int workers = render(3, parallel);
+    if (workers != 3 && workers != 0) // none where real-time priority isn't allowed
+    {
+        std::cerr << "FAIL: render pool started " << workers << " workers, expected 3 (or 0 without real-time priority)\n";
+        ++failed;
+    }
+
+    // Off until opted into.
+    {
+        MatildaSynthesiser synth;
+        synth.addVoice(new MatildaSamplerVoice());
+        synth.prepareVoiceRendering(512, 2);
+        if (synth.getNumRenderThreads() != 0)
+        {
+            std::cerr << "FAIL: render pool starts " << synth.getNumRenderThreads() << " workers by default\n";
+            ++failed;
+        }
+    }
+
+    float maxError = 0.0f, peak = 0.0f;
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < serial.getNumSamples(); ++i)
+        {
+            maxError = juce::jmax(maxError, std::abs(serial.getSample(ch, i) - parallel.getSample(ch, i)));
+            peak = juce::jmax(peak, std::abs(serial.getSample(ch, i)));
+        }
+    if (peak < 0.1f || maxError > 1.0e-5f)
+    {
+        std::cerr << "FAIL: parallel voice rendering differs from serial by " << maxError << " (peak " << peak << ")\n";
+        ++failed;
+    }
+
+    return failed;
+}
+
+static int runVoiceStealingTests()
+{
+    int failed = 0;
+
+    juce::TemporaryFile temp(".wav");
+    auto set = makeSineSoundSet(temp.getFile());
+    if (set == nullptr)
+    {
+        std::cerr << "FAIL: could not write and decode the voice stealing test WAV\n";
+        return 1;
+    }
+
+    MatildaSynthesiser synth;
+    for (int i = 0; i < 6; ++i)
+    {
+        auto* voice = new MatildaSamplerVoice();
+        voice->setSampleRate(44100.0);
+        synth.addVoice(voice);
+    }
+    synth.setCurrentPlaybackSampleRate(44100.0);
+    synth.getSoundSets().publish(set);
+
+    juce::AudioBuffer<float> out(2, 512);
+    auto render = [&](int numSamples) { out.clear(); synth.renderNextBlock(out, juce::MidiBuffer(), 0, numSamples); };
+    auto voiceOn = [&](int note, bool fading) -> MatildaSamplerVoice*
+    {
+        for (int i = 0; i < synth.getNumVoices(); ++i)
+        {
+            auto* voice = dynamic_cast<MatildaSamplerVoice*>(synth.getVoice(i));
+            if (voice != nullptr && voice->isVoiceActive() && voice->getCurrentlyPlayingNote() == note && voice->isFadingOut() == fading)
+                return voice;
+        }
+        return nullptr;
+    };
+
+    // Polyphony 3: with a bass note and two others held, a fourth note takes the released one, with a fade.
+    synth.setPolyphony(3);
+    synth.noteOn(1, 36, 0.8f);
+    render(256);
+    synth.noteOn(1, 60, 0.8f);
+    render(256);
+    synth.noteOn(1, 64, 0.8f);
+    render(256);
+    synth.noteOff(1, 64, 0.0f, true);
+    synth.noteOn(1, 67, 0.3f);
+    if (voiceOn(64, true) == nullptr || voiceOn(67, false) == nullptr || voiceOn(36, false) == nullptr)
+    {
+        std::cerr << "FAIL: a note past the polyphony should fade out the released note\n";
+        ++failed;
+    }
+    render(512); // the fade is 3 ms
+    if (voiceOn(64, true) != nullptr || voiceOn(64, false) != nullptr)
+    {
+        std::cerr << "FAIL: a stolen voice should be free once its fade is over\n";
+        ++failed;
+    }
+
+    // All held: the quietest goes (67, played softest), never the bass note.
+    synth.noteOn(1, 72, 0.8f);
+    if (voiceOn(67, true) == nullptr || voiceOn(60, false) == nullptr || voiceOn(36, false) == nullptr)
+    {
+        std::cerr << "FAIL: a held steal should take the quietest note and keep the bass\n";
+        ++failed;
+    }
+    synth.allNotesOff(0, false);
+
+    // Per-key cap of 2: a third strike of one key fades its oldest tail.
+    synth.setPolyphony(6);
+    synth.setMaxVoicesPerKey(2);
+    for (int strike = 0; strike < 3; ++strike)
+    {
+        synth.noteOn(1, 60, 0.8f);
+        render(128);
+    }
+    int sounding = 0, fading = 0;
+    for (int i = 0; i < synth.getNumVoices(); ++i)
+        if (auto* voice = dynamic_cast<MatildaSamplerVoice*>(synth.getVoice(i)); voice != nullptr && voice->isVoiceActive())
+            ++(voice->isFadingOut() ? fading : sounding);
+    if (sounding != 2 || fading != 1)
+    {
+        std::cerr << "FAIL: three strikes with a cap of 2 left " << sounding << " sounding and " << fading << " fading voices\n";
+        ++failed;
+    }
+
+    synth.allNotesOff(0, false);
+    synth.getSoundSets().clear();
+    return failed;
+}
+
+static int runVoiceCullingTests()
+{
+    int failed = 0;
+
+    juce::TemporaryFile temp(".wav");
+    auto set = makeSineSoundSet(temp.getFile());
+    if (set == nullptr)
+    {
+        std::cerr << "FAIL: could not write and decode the voice culling test WAV\n";
+        return 1;
+    }
+
+    // A note decaying to a sustain of -46 dB (about -54 dB out, with the sine's amplitude and the velocity).
+    auto activeAfterDecay = [&](float cullLevel, float sustain)
+    {
+        MatildaSynthesiser synth;
+        auto* voice = new MatildaSamplerVoice();
+        voice->setSampleRate(44100.0);
+        voice->setAttack(0.001f);
+        voice->setDecay(0.05f);
+        voice->setSustain(sustain);
+        voice->setCullLevel(cullLevel);
+        synth.addVoice(voice);
+        synth.setCurrentPlaybackSampleRate(44100.0);
+        synth.getSoundSets().publish(set);
+
+        synth.noteOn(1, 69, 0.8f);
+        juce::AudioBuffer<float> out(2, 512);
+        for (int block = 0; block < 20; ++block) // about 0.23 s
+        {
+            out.clear();
+            synth.renderNextBlock(out, juce::MidiBuffer(), 0, out.getNumSamples());
+        }
+        const bool active = voice->isVoiceActive();
+        const float level = voice->getCurrentLevel();
+        synth.getSoundSets().clear();
+        return std::make_pair(active, level);
+    };
+
+    const float floor = juce::Decibels::decibelsToGain(-40.0f);
+    const float sustain = juce::Decibels::decibelsToGain(-46.0f);
+    if (activeAfterDecay(floor, sustain).first)
+    {
+        std::cerr << "FAIL: a held note below the culling floor should have been ended\n";
+        ++failed;
+    }
+
+    const auto uncull = activeAfterDecay(0.0f, sustain);
+    const float expectedLevel = 0.5f * 0.8f * sustain;
+    if (!uncull.first || std::abs(uncull.second - expectedLevel) > 0.05f * expectedLevel)
+    {
+        std::cerr << "FAIL: without culling the note should keep playing at level " << expectedLevel
+                  << " (got " << uncull.second << ")\n";
+        ++failed;
+    }
+
+    if (!activeAfterDecay(floor, 0.7f).first)
+    {
+        std::cerr << "FAIL: a note above the culling floor was ended\n";
+        ++failed;
+    }
+
+    return failed;
+}
+
+static int runSamplePoolTests()
+{
+    int failed = 0;
+
+    juce::TemporaryFile temp(".wav");
+    const int numFrames = 500;
+    juce::AudioBuffer<float> written(2, numFrames);
+    written.clear();
+    if (!writeTestWav(temp.getFile(), written))
+    {
+        std::cerr << "FAIL: could not create WAV writer for sample pool test\n";
+        return 1;
+    }
+
+    int numDecodes = 0;
+    auto decode = [&]() -> SampleData::Ptr
+    {
+        ++numDecodes;
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader(wav.createReaderFor(temp.getFile().createInputStream().release(), true));
+        return reader != nullptr ? SampleData::decode(*reader, 30.0) : nullptr;
+    };
+
+    SamplePool pool;
+    auto first = pool.getOrCreate(temp.getFile(), "full", decode);
+    auto second = pool.getOrCreate(temp.getFile(), "full", decode);
+    if (first == nullptr || first != second || numDecodes != 1 || first->getLength() != numFrames)
+    {
+        std::cerr << "FAIL: pool should decode once and share the data (decodes: " << numDecodes << ")\n";
+        ++failed;
+    }
+
+    auto head = pool.getOrCreate(temp.getFile(), "head:0.005", decode);
+    if (head == first || pool.getNumEntries() != 2)
+    {
+        std::cerr << "FAIL: a different variant should be a separate pool entry\n";
+        ++failed;
+    }
+
+    head = nullptr;
+    pool.purgeUnused();
+    if (pool.getNumEntries() != 1)
+    {
+        std::cerr << "FAIL: purgeUnused() left " << pool.getNumEntries() << " entries, expected 1\n";
+        ++failed;
+    }
+
+    first = nullptr;
+    second = nullptr;
+    pool.purgeUnused();
+    if (pool.getNumEntries() != 0)
+    {
+        std::cerr << "FAIL: purgeUnused() should empty a pool nobody references\n";
+        ++failed;
+    }
+
+    return failed;
+}
+
 int main(int argc, char* argv[])
 {
     juce::ignoreUnused(argc, argv);
@@ -83,6 +2119,29 @@ int main(int argc, char* argv[])
 
     int failed = 0;
     failed += runParameterLayoutTests();
+    failed += runParameterSnapshotTests();
+    failed += runSessionStateTests();
+    failed += runParameterRampTests();
+    failed += runOutputStageTests();
+    failed += runSampleNamingTests();
+    failed += runMappedSampleFileTests();
+    failed += runPageWarmerTests();
+    failed += runSampleStreamerTests();
+    failed += runSampleDataTests();
+    failed += runVoiceKernelTests();
+    failed += runVoiceEnvelopeTests();
+    failed += runSampleBankTests();
+    failed += runSampleLoopTests();
+    failed += runSoundSetPublisherTests();
+    failed += runKeyMapTests();
+    failed += runVelocityLayerTests();
+    failed += runVoiceRenderPoolTests();
+    failed += runVoiceStealingTests();
+    failed += runVoiceCullingTests();
+    failed += runUiMidiQueueTests();
+    failed += runSamplePoolTests();
+    failed += runSampleIndexTests();
+    failed += runSampleLoaderTests();
 
     if (failed > 0)
     {
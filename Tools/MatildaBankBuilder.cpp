@@ -0,0 +1,114 @@
+/**
+ * Matilda Piano — bank builder.
+ * Packs a sample folder into a single prebuilt bank (see Source/SampleBank.h).
+ * Usage: MatildaBankBuilder <samplesFolder> <output.mbank> [--keysamples] [--flac] [--no-trim]
+ *   --keysamples  parse keySamples names (c0 = C1 = MIDI 24) before note names / MIDI numbers
+ *   --flac        store integer zones losslessly compressed (about half the size; decoded at load)
+ *   --no-trim     keep leading silence and inaudible tails (trimmed at the default threshold otherwise)
+ * Normally run through the MatildaPianoBank CMake target.
+ */
+#include <JuceHeader.h>
+#include "../Source/SampleBank.h"
+#include "../Source/SampleData.h"
+#include "../Source/SampleLoops.h"
+#include "../Source/SampleNaming.h"
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI init;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add(juce::String::fromUTF8(argv[i]));
+
+    const bool useKeySamplesNaming = args.removeString("--keysamples") > 0;
+    const auto compression = args.removeString("--flac") > 0 ? SampleBank::Compression::flac
+                                                            : SampleBank::Compression::none;
+    const float trimThreshold = args.removeString("--no-trim") > 0
+                                    ? 0.0f : juce::Decibels::decibelsToGain(SampleData::defaultTrimThresholdDb);
+    if (args.size() != 2)
+    {
+        std::cerr << "Usage: MatildaBankBuilder <samplesFolder> <output.mbank> [--keysamples] [--flac] [--no-trim]\n";
+        return EXIT_FAILURE;
+    }
+
+    const auto samplesDir = juce::File::getCurrentWorkingDirectory().getChildFile(args[0]);
+    const auto output = juce::File::getCurrentWorkingDirectory().getChildFile(args[1]);
+
+    juce::Array<juce::File> files;
+    samplesDir.findChildFiles(files, juce::File::findFiles, true, "*.wav;*.wave;*.aif;*.aiff;*.flac");
+    files.sort();
+    if (files.isEmpty())
+    {
+        std::cerr << "No WAV/AIFF/FLAC files in " << samplesDir.getFullPathName() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    // Each zone's pcm points into its SampleData, so keep those alive until the bank is written.
+    juce::ReferenceCountedArray<SampleData> decoded;
+    juce::Array<SampleBank::Zone> zones;
+    juce::StringArray usedSlots; // note/layer/round robin
+    for (const auto& file : files)
+    {
+        const int midiNote = SampleNaming::midiNoteForFile(file, useKeySamplesNaming);
+        if (midiNote == -1)
+        {
+            std::cerr << "Skipping " << file.getFileName() << ": no note in the name\n";
+            continue;
+        }
+        const auto layering = SampleNaming::layeringForFile(file);
+        const auto slot = juce::String(midiNote) + "/" + juce::String(layering.velocityLayer) + "/" + juce::String(layering.roundRobin);
+        if (usedSlots.contains(slot))
+        {
+            std::cerr << "Skipping " << file.getFileName() << ": note " << midiNote << " (layer " << layering.velocityLayer
+                      << ", round robin " << layering.roundRobin << ") already has a sample\n";
+            continue;
+        }
+
+        // Loop points (sidecar, else smpl/INST) are carried into the zone, relative to the trimmed audio.
+        std::unique_ptr<juce::AudioFormatReader> reader { formatManager.createReaderFor(file) };
+        auto data = reader != nullptr ? SampleData::decode(*reader, SampleData::maxSampleLengthSeconds, 0.0, trimThreshold,
+                                                           SampleLoops::find(file, SampleLoops::fromMetadata(reader->metadataValues)))
+                                     : nullptr;
+        if (data == nullptr || data->getLength() == 0)
+        {
+            std::cerr << "Skipping " << file.getFileName() << ": can't decode\n";
+            continue;
+        }
+
+        SampleBank::Zone zone;
+        zone.name = file.getFileNameWithoutExtension();
+        zone.rootNote = zone.lowNote = zone.highNote = midiNote;
+        zone.velocityLayer = layering.velocityLayer;
+        zone.roundRobin = layering.roundRobin;
+        zone.sampleRate = data->getSourceSampleRate();
+        zone.pcm = data->getPcm();
+        zone.loopStart = data->getLoop().start;
+        zone.loopEnd = data->getLoop().end;
+        zones.add(zone);
+        decoded.add(data);
+        usedSlots.add(slot);
+    }
+
+    if (zones.isEmpty())
+    {
+        std::cerr << "No usable samples in " << samplesDir.getFullPathName() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    const auto error = SampleBank::write(output, zones, compression);
+    if (error.isNotEmpty())
+    {
+        std::cerr << error << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Wrote " << zones.size() << " zones to " << output.getFullPathName()
+              << " (" << juce::File::descriptionOfSizeInBytes(output.getSize()) << ")\n";
+    return EXIT_SUCCESS;
+}